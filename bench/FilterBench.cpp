@@ -0,0 +1,170 @@
+// Filter scaling: how the parallel filter of EfficientLogFilterProxyModel speeds up with
+// worker threads, for a literal matching 1%, 50% and 99% of the lines.
+//
+//     FilterBench [megabytes=256] [repetitions=3]
+//
+// Writes a log of ~100 byte lines to a temporary file, indexes it and filters it with each
+// pattern at 1, 2, 4, ... up to one thread per TaskScheduler thread. Reports the best of the
+// repetitions: time to the first match shown, time to completion, GB/s and the speedup over
+// one thread. The file is read once before timing, so the page cache is warm.
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include "EfficientLogFilterProxyModel.hpp"
+#include "GrepNode.hpp"
+#include "Logfile.hpp"
+#include "LogfileModel.hpp"
+#include "TaskScheduler.hpp"
+
+namespace
+{
+
+struct Pattern
+{
+    const char* word;
+    int percent; // Of the lines containing it
+};
+
+const Pattern kPatterns[] = {{"needle01", 1}, {"needle50", 50}, {"needle99", 99}};
+
+bool writeLog(const QString& filename, qint64 size)
+{
+    QFile out(filename);
+    if (!out.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    std::mt19937_64 random(42);
+    std::uniform_int_distribution<int> percent(0, 99);
+    QByteArray block;
+    for (qint64 written = 0, line = 0; written < size; ++line) {
+        block += "2026-10-17T12:00:00.";
+        block += QByteArray::number(line % 1000).rightJustified(3, '0');
+        block += " INFO [worker-";
+        block += QByteArray::number(line % 16);
+        block += "] request served";
+        for (const Pattern& pattern : kPatterns) {
+            if (percent(random) < pattern.percent) {
+                block += ' ';
+                block += pattern.word;
+            }
+        }
+        block += " latency=12ms status=200 path=/api/v1/items\n";
+        if (block.size() >= 1024 * 1024) {
+            if (out.write(block) != block.size()) {
+                return false;
+            }
+            written += block.size();
+            block.clear();
+        }
+    }
+    return out.write(block) == block.size();
+}
+
+struct Run
+{
+    qint64 firstResultsMs = -1;
+    qint64 totalMs = -1;
+    int matches = -1;
+};
+
+// Filters with a fresh proxy state, nothing from an earlier run is reused
+Run runFilter(EfficientLogFilterProxyModel& proxy, Logfile& logfile, GrepNode& node, int threadCount)
+{
+    proxy.setSourceLogfile(&logfile); // Drops the cached match sets and the applied chain
+    proxy.setFilterThreadCount(threadCount);
+    Run run;
+    QEventLoop loop;
+    const QMetaObject::Connection connection = QObject::connect(
+        &proxy, &EfficientLogFilterProxyModel::filteringFinished, &loop, [&run, &loop](int matches) {
+            run.matches = matches;
+            loop.quit();
+        });
+    proxy.applyFilterChain({&node});
+    if (run.matches < 0) {
+        loop.exec();
+    }
+    QObject::disconnect(connection);
+    const EfficientLogFilterProxyModel::FilterLatency latency = proxy.lastFilterLatency();
+    run.firstResultsMs = latency.firstResultsMs;
+    run.totalMs = latency.totalMs;
+    return run;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+    const qint64 megabytes = argc > 1 ? std::atoll(argv[1]) : 256;
+    const int repetitions = argc > 2 ? std::atoi(argv[2]) : 3;
+    if (megabytes <= 0 || repetitions <= 0) {
+        std::fprintf(stderr, "usage: %s [megabytes] [repetitions]\n", argv[0]);
+        return 1;
+    }
+
+    QTemporaryDir directory;
+    const QString filename = directory.filePath(QStringLiteral("filter.log"));
+    const qint64 size = megabytes * 1024 * 1024;
+    if (!directory.isValid() || !writeLog(filename, size)) {
+        std::fprintf(stderr, "unable to write %s\n", qPrintable(filename));
+        return 1;
+    }
+
+    Logfile logfile;
+    LogfileModel model(&logfile);
+    {
+        QEventLoop loop;
+        bool indexed = false;
+        QObject::connect(&logfile, &Logfile::indexingFinished, &loop, [&indexed, &loop](bool success) {
+            indexed = success;
+            loop.quit();
+        });
+        logfile.initialize(filename);
+        loop.exec();
+        if (!indexed) {
+            std::fprintf(stderr, "indexing %s failed\n", qPrintable(filename));
+            return 1;
+        }
+    }
+
+    EfficientLogFilterProxyModel proxy;
+    proxy.setSourceModel(&model);
+    proxy.setSourceLogfile(&logfile);
+    proxy.setForeground(true);
+
+    const int maxThreads = TaskScheduler::instance().threadCount();
+    std::printf("%lld MiB, %d lines, best of %d, up to %d threads\n", static_cast<long long>(megabytes),
+                model.rowCount(), repetitions, maxThreads);
+    for (const Pattern& pattern : kPatterns) {
+        GrepNode node(pattern.word);
+        runFilter(proxy, logfile, node, maxThreads); // Warms the page cache
+        std::printf("\n'%s' (%d%% of the lines)\n", pattern.word, pattern.percent);
+        std::printf("threads   first ms   total ms      GB/s   speedup   matches\n");
+        qint64 singleThreadMs = -1;
+        for (int threads = 1; threads <= maxThreads; threads = threads < maxThreads ? qMin(threads * 2, maxThreads)
+                                                                                     : maxThreads + 1) {
+            Run best;
+            for (int i = 0; i < repetitions; ++i) {
+                const Run run = runFilter(proxy, logfile, node, threads);
+                if (best.totalMs < 0 || run.totalMs < best.totalMs) {
+                    best = run;
+                }
+            }
+            if (singleThreadMs < 0) {
+                singleThreadMs = best.totalMs;
+            }
+            const double seconds = qMax<qint64>(best.totalMs, 1) / 1e3;
+            std::printf("%7d %10lld %10lld %9.2f %8.2fx %9d\n", threads, static_cast<long long>(best.firstResultsMs),
+                        static_cast<long long>(best.totalMs), size / seconds / 1e9,
+                        double(singleThreadMs) / qMax<qint64>(best.totalMs, 1), best.matches);
+        }
+    }
+    return 0;
+}
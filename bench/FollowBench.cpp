@@ -0,0 +1,195 @@
+// Follow mode under a fast writer: a second process appends lines to a log that a Logfile
+// follows, the way a busy service writes its log while we tail it.
+//
+//     FollowBench [lines per second=200000, 0 for as fast as possible] [seconds=10] [line length=120]
+//
+// Reports the rate lines were written at, the rate they reached the model at, how far
+// behind the model was when the writer stopped and how long it took to catch up, and the
+// longest the event loop was blocked (what a view would have felt as a stall).
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QProcess>
+#include <QTemporaryDir>
+#include <QTimer>
+
+#include "Logfile.hpp"
+#include "LogfileModel.hpp"
+
+namespace
+{
+
+const qint64 kMaxWriteLines = 10000; // Lines per write() call, bounds a catch-up burst
+const int kDrainTimeoutMs = 30000;
+
+QByteArray makeLine(qint64 number, int length)
+{
+    QByteArray line = QByteArray::number(number).rightJustified(10, '0');
+    line += " INFO [worker-3] request served in 12 ms ";
+    if (line.size() < length - 1) {
+        line += QByteArray(length - 1 - line.size(), 'x');
+    }
+    line += '\n';
+    return line;
+}
+
+// The child process: appends lines at the given rate for the given time, then prints how
+// many it wrote
+int runWriter(const QString& filename, qint64 linesPerSecond, double seconds, int lineLength)
+{
+    QFile out(filename);
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered)) {
+        std::fprintf(stderr, "writer: unable to open %s\n", qPrintable(filename));
+        return 1;
+    }
+
+    QElapsedTimer clock;
+    clock.start();
+    qint64 written = 0;
+    QByteArray batch;
+    for (;;) {
+        const double elapsed = clock.nsecsElapsed() / 1e9;
+        if (elapsed >= seconds) {
+            break;
+        }
+        const qint64 due = linesPerSecond > 0 ? static_cast<qint64>(elapsed * linesPerSecond) : written + 1000;
+        if (due <= written) {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            continue;
+        }
+        batch.clear();
+        for (const qint64 last = qMin(due, written + kMaxWriteLines); written < last; ++written) {
+            batch += makeLine(written, lineLength);
+        }
+        if (out.write(batch) != batch.size()) {
+            std::fprintf(stderr, "writer: write failed: %s\n", qPrintable(out.errorString()));
+            return 1;
+        }
+    }
+    std::printf("%lld\n", static_cast<long long>(written));
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    if (args.size() == 6 && args.at(1) == QLatin1String("--writer")) {
+        return runWriter(args.at(2), args.at(3).toLongLong(), args.at(4).toDouble(), args.at(5).toInt());
+    }
+
+    const qint64 linesPerSecond = argc > 1 ? std::atoll(argv[1]) : 200000;
+    const double seconds = argc > 2 ? std::atof(argv[2]) : 10;
+    const int lineLength = argc > 3 ? std::atoi(argv[3]) : 120;
+    if (linesPerSecond < 0 || seconds <= 0 || lineLength <= 0) {
+        std::fprintf(stderr, "usage: %s [lines per second] [seconds] [line length]\n", argv[0]);
+        return 1;
+    }
+
+    QTemporaryDir directory;
+    const QString filename = directory.filePath(QStringLiteral("follow.log"));
+    {
+        QFile seed(filename);
+        if (!directory.isValid() || !seed.open(QIODevice::WriteOnly) || seed.write("start\n") != 6) {
+            std::fprintf(stderr, "unable to create %s\n", qPrintable(filename));
+            return 1;
+        }
+    }
+
+    Logfile logfile;
+    LogfileModel model(&logfile);
+    qint64 batches = 0;
+    QObject::connect(&model, &QAbstractItemModel::rowsInserted, &app, [&batches]() { ++batches; });
+
+    // Ticks every millisecond; a long gap between two is the event loop being blocked
+    QTimer ticker;
+    ticker.setTimerType(Qt::PreciseTimer);
+    ticker.setInterval(1);
+    QElapsedTimer tickClock;
+    qint64 lastTick = 0;
+    qint64 longestStallNs = 0;
+    QObject::connect(&ticker, &QTimer::timeout, &app, [&]() {
+        const qint64 now = tickClock.nsecsElapsed();
+        longestStallNs = qMax(longestStallNs, now - lastTick);
+        lastTick = now;
+    });
+
+    QProcess writer;
+    QElapsedTimer clock;
+    qint64 written = -1;
+    qint64 behindAtWriterEnd = 0;
+    qint64 writerNs = 0;
+    qint64 drainNs = 0;
+
+    // Once the seed line is indexed: follow, start the writer and the stall watch
+    QObject::connect(&logfile, &Logfile::indexingFinished, &app, [&](bool success) {
+        if (!success) {
+            std::fprintf(stderr, "indexing %s failed\n", qPrintable(filename));
+            app.exit(1);
+            return;
+        }
+        logfile.setFollowing(true);
+        tickClock.start();
+        ticker.start();
+        clock.start();
+        writer.start(QCoreApplication::applicationFilePath(),
+                     {QStringLiteral("--writer"), filename, QString::number(linesPerSecond),
+                      QString::number(seconds), QString::number(lineLength)});
+    });
+
+    // Then wait until the model has every line the writer reported
+    QTimer drainCheck;
+    drainCheck.setInterval(1);
+    QObject::connect(&drainCheck, &QTimer::timeout, &app, [&]() {
+        if (model.rowCount() >= written + 1) {
+            drainNs = clock.nsecsElapsed() - writerNs;
+            app.exit(0);
+        } else if (clock.nsecsElapsed() - writerNs > qint64(kDrainTimeoutMs) * 1000000) {
+            drainNs = -1;
+            app.exit(0);
+        }
+    });
+    QObject::connect(&writer, static_cast<void (QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished),
+                     &app, [&](int exitCode, QProcess::ExitStatus status) {
+                         writerNs = clock.nsecsElapsed();
+                         bool ok = false;
+                         written = writer.readAllStandardOutput().trimmed().toLongLong(&ok);
+                         if (status != QProcess::NormalExit || exitCode != 0 || !ok) {
+                             std::fprintf(stderr, "writer failed: %s\n", writer.readAllStandardError().constData());
+                             app.exit(1);
+                             return;
+                         }
+                         behindAtWriterEnd = written + 1 - model.rowCount();
+                         drainCheck.start();
+                     });
+
+    logfile.initialize(filename);
+    const int result = app.exec();
+    ticker.stop();
+    if (result != 0) {
+        return result;
+    }
+
+    const double writerSeconds = writerNs / 1e9;
+    std::printf("%lld lines of %d bytes in %.2f s: written at %.0f lines/s (%.1f MB/s)\n",
+                static_cast<long long>(written), lineLength, writerSeconds, written / writerSeconds,
+                written * double(lineLength) / writerSeconds / 1e6);
+    if (drainNs < 0) {
+        std::printf("model fell behind: %lld lines missing %d s after the writer stopped\n",
+                    static_cast<long long>(written + 1 - model.rowCount()), kDrainTimeoutMs / 1000);
+        return 2;
+    }
+    std::printf("model received %.0f lines/s in %lld batches, %lld lines behind at the end, caught up in %.1f ms\n",
+                written / ((writerNs + drainNs) / 1e9), static_cast<long long>(batches),
+                static_cast<long long>(behindAtWriterEnd), drainNs / 1e6);
+    std::printf("longest event loop stall: %.1f ms\n", longestStallNs / 1e6);
+    return 0;
+}
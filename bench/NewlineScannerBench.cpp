@@ -0,0 +1,126 @@
+// Throughput of the newline scanner kernels against the byte loop indexing used before them.
+//
+//     NewlineScannerBench [megabytes=256] [average line length=100] [repetitions=5]
+//
+// Scans a generated buffer of printable lines with every kernel the CPU supports and
+// reports the best of the repetitions in GB/s, together with the speedup over the loop.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "simd/NewlineScanner.hpp"
+
+namespace
+{
+
+const qint64 kBatchSize = 64 * 1024; // Offsets per scan() call, as indexing uses it
+
+std::vector<char> generateLines(qint64 size, int averageLineLength)
+{
+    std::vector<char> data(static_cast<size_t>(size));
+    std::mt19937_64 random(42);
+    std::uniform_int_distribution<int> lineLength(1, 2 * averageLineLength - 1);
+    std::uniform_int_distribution<int> character(' ', '~');
+    qint64 pos = 0;
+    while (pos < size) {
+        const qint64 end = qMin<qint64>(pos + lineLength(random), size - 1);
+        for (; pos < end; ++pos) {
+            data[pos] = static_cast<char>(character(random));
+        }
+        data[pos++] = '\n';
+    }
+    return data;
+}
+
+// The loop buildIndexInternal() ran before the SIMD scanner: a compare per byte and an
+// append per newline
+qint64 byteLoop(const char* data, qint64 length, std::vector<qint64>& offsets)
+{
+    offsets.clear();
+    for (qint64 i = 0; i < length; ++i) {
+        if (data[i] == '\n') {
+            offsets.push_back(i + 1);
+        }
+    }
+    return static_cast<qint64>(offsets.size());
+}
+
+qint64 kernelScan(simd::NewlineScanner::Kernel kernel, const char* data, qint64 length, std::vector<qint64>& batch)
+{
+    qint64 lines = 0;
+    qint64 scanned = 0;
+    while (scanned < length) {
+        qint64 found = 0;
+        scanned += simd::NewlineScanner::scanWith(kernel, data + scanned, length - scanned, scanned, batch.data(),
+                                                  kBatchSize, &found);
+        lines += found;
+    }
+    return lines;
+}
+
+// Best time of repetitions runs of scan, in seconds; lines receives its result
+template <typename Scan>
+double bestOf(int repetitions, Scan scan, qint64* lines)
+{
+    double best = 1e30;
+    for (int i = 0; i < repetitions; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        *lines = scan();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = qMin(best, elapsed.count());
+    }
+    return best;
+}
+
+void report(const char* name, qint64 bytes, double seconds, double baselineSeconds, qint64 lines, qint64 expected)
+{
+    std::printf("%-14s %8.2f GB/s %7.2fx%s\n", name, bytes / seconds / 1e9, baselineSeconds / seconds,
+                lines == expected ? "" : "  WRONG LINE COUNT");
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    const qint64 megabytes = argc > 1 ? std::atoll(argv[1]) : 256;
+    const int averageLineLength = argc > 2 ? std::atoi(argv[2]) : 100;
+    const int repetitions = argc > 3 ? std::atoi(argv[3]) : 5;
+    if (megabytes <= 0 || averageLineLength <= 0 || repetitions <= 0) {
+        std::fprintf(stderr, "usage: %s [megabytes] [average line length] [repetitions]\n", argv[0]);
+        return 1;
+    }
+
+    const qint64 size = megabytes * 1024 * 1024;
+    const std::vector<char> data = generateLines(size, averageLineLength);
+    std::vector<qint64> offsets;
+    offsets.reserve(static_cast<size_t>(size / averageLineLength * 2));
+    std::vector<qint64> batch(static_cast<size_t>(kBatchSize));
+
+    std::printf("%lld MiB, ~%d bytes per line, best of %d, active kernel: %s\n", static_cast<long long>(megabytes),
+                averageLineLength, repetitions,
+                simd::NewlineScanner::kernelName(simd::NewlineScanner::activeKernel()));
+
+    qint64 expected = 0;
+    const double baseline = bestOf(repetitions, [&]() { return byteLoop(data.data(), size, offsets); }, &expected);
+    report("byte loop", size, baseline, baseline, expected, expected);
+
+    using Kernel = simd::NewlineScanner::Kernel;
+    for (Kernel kernel : {Kernel::Scalar, Kernel::Sse2, Kernel::Avx2, Kernel::Avx512}) {
+        if (kernel > simd::NewlineScanner::activeKernel()) {
+            continue; // scanWith() would fall back to the scalar kernel
+        }
+        qint64 lines = 0;
+        const double seconds = bestOf(repetitions, [&]() { return kernelScan(kernel, data.data(), size, batch); },
+                                      &lines);
+        report(simd::NewlineScanner::kernelName(kernel), size, seconds, baseline, lines, expected);
+    }
+
+    qint64 counted = 0;
+    const double countSeconds = bestOf(repetitions, [&]() { return simd::NewlineScanner::count(data.data(), size); },
+                                       &counted);
+    report("count()", size, countSeconds, baseline, counted, expected);
+    return 0;
+}
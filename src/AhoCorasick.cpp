@@ -0,0 +1,151 @@
+#include "AhoCorasick.hpp"
+
+#include <cstring>
+
+namespace
+{
+
+bool isAsciiLetter(uchar c)
+{
+    const uchar lower = c | 0x20;
+    return lower >= 'a' && lower <= 'z';
+}
+
+uchar foldAscii(uchar c)
+{
+    return isAsciiLetter(c) ? (c | 0x20) : c;
+}
+
+}  // namespace
+
+int AhoCorasick::addPattern(const QByteArray& pattern, bool caseInsensitive)
+{
+    Q_ASSERT(!pattern.isEmpty() && transitions_.empty());
+    Pattern added;
+    added.bytes = pattern;
+    added.caseInsensitive = caseInsensitive;
+    patterns_.push_back(added);
+    return static_cast<int>(patterns_.size()) - 1;
+}
+
+void AhoCorasick::build()
+{
+    // Columns: one per distinct pattern byte, column 0 for everything else. With any
+    // case-insensitive pattern, letters are folded for all patterns and the case-sensitive
+    // ones with letters have to be confirmed.
+    bool fold = false;
+    for (const Pattern& pattern : patterns_) {
+        fold = fold || pattern.caseInsensitive;
+    }
+    auto column = [fold](uchar c) { return fold ? foldAscii(c) : c; };
+
+    classOf_.fill(0);
+    classCount_ = 1;
+    for (Pattern& pattern : patterns_) {
+        for (const char c : pattern.bytes) {
+            const uchar byte = column(static_cast<uchar>(c));
+            if (classOf_[byte] == 0) {
+                classOf_[byte] = static_cast<quint16>(classCount_++);
+            }
+            pattern.verify = pattern.verify || (fold && !pattern.caseInsensitive && isAsciiLetter(byte));
+        }
+    }
+    if (fold) {
+        for (int c = 'A'; c <= 'Z'; ++c) {
+            classOf_[c] = classOf_[c | 0x20];
+        }
+    }
+
+    // Trie, -1 where it has no edge
+    transitions_.assign(classCount_, -1);
+    std::vector<std::vector<qint32>> ending(1);
+    for (size_t id = 0; id < patterns_.size(); ++id) {
+        qint32 state = 0;
+        for (const char c : patterns_[id].bytes) {
+            const int symbol = classOf_[static_cast<uchar>(c)];
+            qint32& next = transitions_[state * classCount_ + symbol];
+            if (next < 0) {
+                next = static_cast<qint32>(ending.size());
+                ending.emplace_back();
+                transitions_.resize(transitions_.size() + classCount_, -1);
+            }
+            state = transitions_[state * classCount_ + symbol]; // resize() may have moved next
+        }
+        ending[state].push_back(static_cast<qint32>(id));
+    }
+
+    // Breadth first, so a state's failure target is complete before the state itself: missing
+    // edges are taken from the failure target, and so are the patterns ending there
+    const qint32 stateCount = static_cast<qint32>(ending.size());
+    std::vector<qint32> failure(stateCount, 0);
+    std::vector<qint32> queue;
+    queue.reserve(stateCount);
+    for (int symbol = 0; symbol < classCount_; ++symbol) {
+        qint32& next = transitions_[symbol];
+        if (next < 0) {
+            next = 0;
+        } else {
+            queue.push_back(next);
+        }
+    }
+    for (size_t head = 0; head < queue.size(); ++head) {
+        const qint32 state = queue[head];
+        const qint32 fail = failure[state];
+        ending[state].insert(ending[state].end(), ending[fail].begin(), ending[fail].end());
+        for (int symbol = 0; symbol < classCount_; ++symbol) {
+            qint32& next = transitions_[state * classCount_ + symbol];
+            const qint32 fallback = transitions_[fail * classCount_ + symbol];
+            if (next < 0) {
+                next = fallback;
+            } else {
+                failure[next] = fallback;
+                queue.push_back(next);
+            }
+        }
+    }
+
+    outputBegin_.assign(1, 0);
+    outputs_.clear();
+    for (const std::vector<qint32>& ids : ending) {
+        outputs_.insert(outputs_.end(), ids.begin(), ids.end());
+        outputBegin_.push_back(static_cast<qint32>(outputs_.size()));
+    }
+
+    allMask_ = 0;
+    for (size_t id = 0; id < patterns_.size() && id < 64; ++id) {
+        allMask_ |= quint64(1) << id;
+    }
+}
+
+bool AhoCorasick::isEmpty() const
+{
+    return patterns_.empty();
+}
+
+int AhoCorasick::patternCount() const
+{
+    return static_cast<int>(patterns_.size());
+}
+
+const QByteArray& AhoCorasick::pattern(int id) const
+{
+    return patterns_[id].bytes;
+}
+
+bool AhoCorasick::confirm(int id, const char* data, qint64 begin) const
+{
+    const Pattern& pattern = patterns_[id];
+    return !pattern.verify || std::memcmp(data + begin, pattern.bytes.constData(), pattern.bytes.size()) == 0;
+}
+
+quint64 AhoCorasick::findMask(const char* data, qint64 length) const
+{
+    quint64 found = 0;
+    forEachMatch(data, length, [this, &found](int id, qint64) {
+        if (id < 64) {
+            found |= quint64(1) << id;
+        }
+        return found != allMask_; // Every pattern seen, the rest can't add anything
+    });
+    return found;
+}
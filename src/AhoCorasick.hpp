@@ -0,0 +1,79 @@
+#ifndef AHO_CORASICK_HPP
+#define AHO_CORASICK_HPP
+
+#include <array>
+#include <vector>
+
+#include <QByteArray>
+
+// Finds any number of literal patterns in a single pass over UTF-8 bytes.
+//
+// The patterns form a trie whose failure links are resolved into a dense transition table
+// when built, so each input byte costs one lookup whatever the number of patterns.
+// Bytes that no pattern contains share one column of the table, and case-insensitive
+// patterns are folded by mapping both cases of an ASCII letter to the same column. When
+// case-sensitive and case-insensitive patterns are mixed, a case-sensitive hit is
+// confirmed against the original bytes.
+//
+// Usage: addPattern() for every pattern, build() once, then search from any thread.
+class AhoCorasick
+{
+public:
+    // Adds a non-empty pattern, returns its id. Ids count up from 0 in the order added.
+    int addPattern(const QByteArray& pattern, bool caseInsensitive);
+    void build();
+
+    bool isEmpty() const;
+    int patternCount() const;
+    const QByteArray& pattern(int id) const;
+
+    // Calls onMatch(int id, qint64 begin) for every occurrence of every pattern, overlapping
+    // ones included, in order of their end. onMatch returns false to stop the search.
+    template <typename Callback>
+    void forEachMatch(const char* data, qint64 length, Callback onMatch) const;
+
+    // Bit n set if pattern n occurs in data; only the first 64 patterns are reported
+    quint64 findMask(const char* data, qint64 length) const;
+
+private:
+    struct Pattern
+    {
+        QByteArray bytes;
+        bool caseInsensitive = false;
+        bool verify = false; // Case-sensitive, but found through folded columns
+    };
+
+    bool confirm(int id, const char* data, qint64 begin) const;
+
+    std::vector<Pattern> patterns_;
+    std::array<quint16, 256> classOf_ {}; // Byte -> column
+    int classCount_ = 0;
+    std::vector<qint32> transitions_;     // State x column -> state
+    std::vector<qint32> outputBegin_;     // Patterns ending in state s: outputs_[outputBegin_[s]..[s+1])
+    std::vector<qint32> outputs_;
+    quint64 allMask_ = 0;
+};
+
+template <typename Callback>
+void AhoCorasick::forEachMatch(const char* data, qint64 length, Callback onMatch) const
+{
+    if (transitions_.empty()) {
+        return;
+    }
+    const qint32* table = transitions_.data();
+    const qint32* outputBegin = outputBegin_.data();
+    const int classes = classCount_;
+    qint32 state = 0;
+    for (qint64 i = 0; i < length; ++i) {
+        state = table[state * classes + classOf_[static_cast<uchar>(data[i])]];
+        for (qint32 o = outputBegin[state]; o < outputBegin[state + 1]; ++o) {
+            const int id = outputs_[o];
+            const qint64 begin = i + 1 - patterns_[id].bytes.size();
+            if (confirm(id, data, begin) && !onMatch(id, begin)) {
+                return;
+            }
+        }
+    }
+}
+
+#endif // AHO_CORASICK_HPP
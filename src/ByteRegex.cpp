@@ -0,0 +1,1040 @@
+#include "ByteRegex.hpp"
+
+#include <algorithm>
+#include <bitset>
+#include <cstring>
+#include <map>
+#include <unordered_set>
+#include <utility>
+
+namespace
+{
+
+// Besides the 256 byte values the DFA reads two symbols of its own, fed before and after
+// the bytes of a line, so ^ and $ are ordinary transitions instead of special cases
+const int kLineStart = 256;
+const int kLineEnd = 257;
+const int kSymbolCount = 258;
+
+const int kMaxRepeat = 100;     // Counted repetition is unrolled, {1000} would blow up
+const int kMaxNfaStates = 10000;
+const int kMaxDfaStates = 2000; // At most a few MiB of transitions, built in milliseconds
+
+using SymbolSet = std::bitset<kSymbolCount>;
+
+bool isAsciiLetter(uchar c)
+{
+    const uchar lower = c | 0x20;
+    return lower >= 'a' && lower <= 'z';
+}
+
+// Parsed pattern
+struct Node
+{
+    enum Kind { Symbols, Sequence, Alternation, Repeat };
+
+    Kind kind = Sequence;
+    SymbolSet symbols;          // Symbols: reads one of these
+    std::vector<Node> children; // Sequence, Alternation; Repeat has exactly one
+    int min = 0;                // Repeat bounds, max -1 for unbounded
+    int max = -1;
+};
+
+Node symbolNode(const SymbolSet& symbols)
+{
+    Node node;
+    node.kind = Node::Symbols;
+    node.symbols = symbols;
+    return node;
+}
+
+Node symbolNode(int symbol)
+{
+    SymbolSet symbols;
+    symbols.set(symbol);
+    return symbolNode(symbols);
+}
+
+Node byteRangeNode(int low, int high)
+{
+    SymbolSet symbols;
+    for (int b = low; b <= high; ++b) {
+        symbols.set(b);
+    }
+    return symbolNode(symbols);
+}
+
+// Any character outside ASCII, as a UTF-8 sequence. Overlong forms and surrogates are let
+// through, lines containing them aren't valid UTF-8 and never reach the DFA.
+Node multiByteNode()
+{
+    Node alternation;
+    alternation.kind = Node::Alternation;
+    const int leads[3][2] = {{0xC2, 0xDF}, {0xE0, 0xEF}, {0xF0, 0xF4}};
+    for (int i = 0; i < 3; ++i) {
+        Node sequence;
+        sequence.children.push_back(byteRangeNode(leads[i][0], leads[i][1]));
+        for (int continuation = 0; continuation <= i; ++continuation) {
+            sequence.children.push_back(byteRangeNode(0x80, 0xBF));
+        }
+        alternation.children.push_back(std::move(sequence));
+    }
+    return alternation;
+}
+
+// Members of a bracketed class or shorthand like \w
+struct CharClass
+{
+    std::bitset<128> ascii;
+    bool nonAscii = false; // Every non-ASCII character is a member as well
+
+    void add(int low, int high)
+    {
+        for (int c = low; c <= high; ++c) {
+            ascii.set(c);
+        }
+    }
+
+    void foldCase()
+    {
+        for (int c = 'a'; c <= 'z'; ++c) {
+            if (ascii[c] || ascii[c - 'a' + 'A']) {
+                ascii.set(c);
+                ascii.set(c - 'a' + 'A');
+            }
+        }
+    }
+
+    void negate()
+    {
+        ascii.flip();
+        nonAscii = !nonAscii;
+    }
+
+    Node toNode() const
+    {
+        SymbolSet symbols;
+        for (int c = 0; c < 128; ++c) {
+            symbols[c] = ascii[c];
+        }
+        if (!nonAscii) {
+            return symbolNode(symbols);
+        }
+        Node alternation = multiByteNode();
+        alternation.children.push_back(symbolNode(symbols));
+        return alternation;
+    }
+};
+
+// \d \w \s and their negations; without Unicode properties PCRE2 keeps them to ASCII
+void addShorthand(CharClass* members, uchar letter)
+{
+    CharClass shorthand;
+    switch (letter | 0x20) {
+    case 'd':
+        shorthand.add('0', '9');
+        break;
+    case 'w':
+        shorthand.add('0', '9');
+        shorthand.add('A', 'Z');
+        shorthand.add('a', 'z');
+        shorthand.add('_', '_');
+        break;
+    case 's':
+        shorthand.add('\t', '\r');
+        shorthand.add(' ', ' ');
+        break;
+    }
+    if (letter >= 'A' && letter <= 'Z') {
+        shorthand.negate();
+    }
+    members->ascii |= shorthand.ascii;
+    members->nonAscii = members->nonAscii || shorthand.nonAscii;
+}
+
+int hexValue(uchar c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    const uchar lower = c | 0x20;
+    return lower >= 'a' && lower <= 'f' ? lower - 'a' + 10 : -1;
+}
+
+bool isShorthand(uchar c)
+{
+    switch (c) {
+    case 'd': case 'D': case 'w': case 'W': case 's': case 'S':
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Recursive descent over the UTF-8 pattern. QRegularExpression has already validated it,
+// so failing here means "not in the subset", not "malformed".
+class Parser
+{
+public:
+    Parser(const QByteArray& pattern, bool caseInsensitive)
+        : pattern_(pattern),
+          caseInsensitive_(caseInsensitive)
+    {
+    }
+
+    bool parse(Node* root, QString* error)
+    {
+        if (!parseAlternation(root) || (!atEnd() && !fail("unbalanced parenthesis"))) {
+            *error = error_;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    bool atEnd() const { return pos_ >= pattern_.size(); }
+    uchar peek(int ahead = 0) const
+    {
+        return pos_ + ahead < pattern_.size() ? static_cast<uchar>(pattern_.at(pos_ + ahead)) : 0;
+    }
+    bool fail(const char* reason)
+    {
+        error_ = QString::fromLatin1(reason);
+        return false;
+    }
+
+    Node literalNode(uchar c) const
+    {
+        SymbolSet symbols;
+        symbols.set(c);
+        if (caseInsensitive_ && isAsciiLetter(c)) {
+            symbols.set(c ^ 0x20);
+        }
+        return symbolNode(symbols);
+    }
+
+    bool parseAlternation(Node* out)
+    {
+        Node alternation;
+        alternation.kind = Node::Alternation;
+        for (;;) {
+            Node sequence;
+            if (!parseSequence(&sequence)) {
+                return false;
+            }
+            alternation.children.push_back(std::move(sequence));
+            if (peek() != '|') {
+                break;
+            }
+            ++pos_;
+        }
+        *out = alternation.children.size() == 1 ? std::move(alternation.children.front())
+                                                : std::move(alternation);
+        return true;
+    }
+
+    bool parseSequence(Node* out)
+    {
+        out->kind = Node::Sequence;
+        while (!atEnd() && peek() != '|' && peek() != ')') {
+            Node atom;
+            bool assertion = false;
+            if (!parseAtom(&atom, &assertion) || !parseQuantifier(&atom, assertion)) {
+                return false;
+            }
+            out->children.push_back(std::move(atom));
+        }
+        return true;
+    }
+
+    bool parseAtom(Node* out, bool* assertion)
+    {
+        const uchar c = peek();
+        ++pos_;
+        switch (c) {
+        case '(':
+            return parseGroup(out);
+        case '[':
+            return parseClass(out);
+        case '\\':
+            return parseEscape(out, assertion);
+        case '.': {
+            CharClass any; // Everything but the newline, which a line never contains anyway
+            any.add(0, 127);
+            any.ascii.reset('\n');
+            any.nonAscii = true;
+            *out = any.toNode();
+            return true;
+        }
+        case '^':
+            *assertion = true;
+            *out = symbolNode(kLineStart);
+            return true;
+        case '$':
+            *assertion = true;
+            *out = symbolNode(kLineEnd);
+            return true;
+        case '*':
+        case '+':
+        case '?':
+            return fail("quantifier without operand");
+        default:
+            --pos_;
+            return parseLiteral(out);
+        }
+    }
+
+    // One character, ASCII or a complete UTF-8 sequence
+    bool parseLiteral(Node* out)
+    {
+        const uchar lead = peek();
+        if (lead < 0x80) {
+            ++pos_;
+            *out = literalNode(lead);
+            return true;
+        }
+        const int length = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 0;
+        if (length == 0 || pos_ + length > pattern_.size()) {
+            return fail("invalid UTF-8 in pattern");
+        }
+        if (caseInsensitive_) {
+            return fail("case-insensitive non-ASCII character");
+        }
+        out->kind = Node::Sequence;
+        for (int i = 0; i < length; ++i) {
+            out->children.push_back(symbolNode(peek()));
+            ++pos_;
+        }
+        return true;
+    }
+
+    bool parseGroup(Node* out)
+    {
+        if (peek() == '?') {
+            // Only grouping matters for matching: capturing, non-capturing and named groups
+            // are all the same here. Lookaround, inline options, atomic groups etc. are not.
+            ++pos_;
+            if (peek() == ':') {
+                ++pos_;
+            } else if ((peek() == '<' && peek(1) != '=' && peek(1) != '!') || (peek() == 'P' && peek(1) == '<')
+                       || peek() == '\'') {
+                const uchar close = peek() == '\'' ? '\'' : '>';
+                while (!atEnd() && peek() != close) {
+                    ++pos_;
+                }
+                ++pos_;
+            } else {
+                return fail("unsupported group construct");
+            }
+        }
+        if (!parseAlternation(out)) {
+            return false;
+        }
+        if (peek() != ')') {
+            return fail("unbalanced parenthesis");
+        }
+        ++pos_;
+        return true;
+    }
+
+    bool parseBounds(int* min, int* max)
+    {
+        // {n}, {n,} or {n,m}; anything else is a literal '{' in PCRE2
+        int pos = pos_ + 1;
+        auto number = [&](int* value) {
+            const int begin = pos;
+            *value = 0;
+            while (pos < pattern_.size() && pattern_.at(pos) >= '0' && pattern_.at(pos) <= '9') {
+                *value = qMin(*value * 10 + (pattern_.at(pos) - '0'), kMaxRepeat + 1);
+                ++pos;
+            }
+            return pos > begin;
+        };
+        if (!number(min)) {
+            return false;
+        }
+        *max = *min;
+        if (pos < pattern_.size() && pattern_.at(pos) == ',') {
+            ++pos;
+            if (!number(max)) {
+                *max = -1;
+            }
+        }
+        if (pos >= pattern_.size() || pattern_.at(pos) != '}') {
+            return false;
+        }
+        pos_ = pos + 1;
+        return true;
+    }
+
+    bool parseQuantifier(Node* atom, bool assertion)
+    {
+        int min = 0;
+        int max = -1;
+        switch (peek()) {
+        case '*':
+            ++pos_;
+            break;
+        case '+':
+            ++pos_;
+            min = 1;
+            break;
+        case '?':
+            ++pos_;
+            max = 1;
+            break;
+        case '{':
+            if (peek(1) == ',') {
+                return fail("unsupported repeat syntax");
+            }
+            if (!parseBounds(&min, &max)) {
+                return true; // Literal '{', parsed as the next atom
+            }
+            break;
+        default:
+            return true;
+        }
+        if (assertion) {
+            return fail("quantified assertion");
+        }
+        if (peek() == '+') {
+            return fail("possessive quantifier");
+        }
+        if (peek() == '?') {
+            ++pos_; // Lazy: matches fewer characters, but the same lines
+        }
+        if (min > kMaxRepeat || max > kMaxRepeat) {
+            return fail("repeat count too large");
+        }
+        Node repeat;
+        repeat.kind = Node::Repeat;
+        repeat.min = min;
+        repeat.max = max;
+        repeat.children.push_back(std::move(*atom));
+        *atom = std::move(repeat);
+        const uchar after = peek();
+        return after == '*' || after == '+' || after == '?' || after == '{' ? fail("nested quantifier") : true;
+    }
+
+    // Escape standing for a single ASCII character, c is the character after the backslash
+    bool parseEscapedByte(uchar c, uchar* value)
+    {
+        switch (c) {
+        case 't': *value = '\t'; return true;
+        case 'n': *value = '\n'; return true;
+        case 'r': *value = '\r'; return true;
+        case 'f': *value = '\f'; return true;
+        case 'e': *value = 0x1B; return true;
+        case 'a': *value = 0x07; return true;
+        case 'x': {
+            int code = 0;
+            int digits = 0;
+            const bool braced = peek() == '{';
+            if (braced) {
+                ++pos_;
+            }
+            while ((braced || digits < 2) && hexValue(peek()) >= 0) {
+                code = code * 16 + hexValue(peek());
+                ++digits;
+                ++pos_;
+                if (code >= 0x80) {
+                    return fail("non-ASCII escape");
+                }
+            }
+            if (braced && peek() != '}') {
+                return fail("malformed \\x escape");
+            }
+            if (braced) {
+                ++pos_;
+            }
+            *value = static_cast<uchar>(code);
+            return true;
+        }
+        default:
+            // Escaped punctuation stands for itself; escaped letters and digits are
+            // backreferences, \b, \p{...} and friends
+            if (c < 0x80 && !isAsciiLetter(c) && !(c >= '0' && c <= '9')) {
+                *value = c;
+                return true;
+            }
+            return fail("unsupported escape sequence");
+        }
+    }
+
+    bool parseEscape(Node* out, bool* assertion)
+    {
+        if (atEnd()) {
+            return fail("trailing backslash");
+        }
+        const uchar c = peek();
+        ++pos_;
+        if (isShorthand(c)) {
+            CharClass members;
+            addShorthand(&members, c);
+            *out = members.toNode();
+            return true;
+        }
+        if (c == 'A' || c == 'z' || c == 'Z') {
+            *assertion = true;
+            *out = symbolNode(c == 'A' ? kLineStart : kLineEnd);
+            return true;
+        }
+        uchar value = 0;
+        if (!parseEscapedByte(c, &value)) {
+            return false;
+        }
+        *out = literalNode(value);
+        return true;
+    }
+
+    // Class member: a single character (returned in value) or a shorthand (value -1)
+    bool parseClassMember(CharClass* members, int* value)
+    {
+        const uchar c = peek();
+        ++pos_;
+        if (c >= 0x80) {
+            return fail("non-ASCII character in class");
+        }
+        if (c == '[' && (peek() == ':' || peek() == '.' || peek() == '=')) {
+            return fail("POSIX class");
+        }
+        if (c != '\\') {
+            *value = c;
+            return true;
+        }
+        if (atEnd()) {
+            return fail("unterminated class");
+        }
+        const uchar escaped = peek();
+        ++pos_;
+        if (isShorthand(escaped)) {
+            addShorthand(members, escaped);
+            *value = -1;
+            return true;
+        }
+        uchar byte = 0;
+        if (escaped == 'b') {
+            byte = 0x08; // Backspace inside a class
+        } else if (!parseEscapedByte(escaped, &byte)) {
+            return false;
+        }
+        *value = byte;
+        return true;
+    }
+
+    bool parseClass(Node* out)
+    {
+        CharClass members;
+        const bool negated = peek() == '^';
+        if (negated) {
+            ++pos_;
+        }
+        for (bool first = true;; first = false) {
+            if (atEnd()) {
+                return fail("unterminated class");
+            }
+            if (peek() == ']' && !first) {
+                ++pos_;
+                break;
+            }
+            int low = 0;
+            if (!parseClassMember(&members, &low)) {
+                return false;
+            }
+            if (low < 0) {
+                continue;
+            }
+            int high = low;
+            if (peek() == '-' && peek(1) != ']' && pos_ + 1 < pattern_.size()) {
+                ++pos_;
+                if (!parseClassMember(&members, &high)) {
+                    return false;
+                }
+                if (high < low) {
+                    return fail("invalid class range");
+                }
+            }
+            members.add(low, high);
+        }
+        if (caseInsensitive_) {
+            members.foldCase();
+        }
+        if (negated) {
+            members.negate();
+        }
+        *out = members.toNode();
+        return true;
+    }
+
+    const QByteArray& pattern_;
+    const bool caseInsensitive_;
+    int pos_ = 0;
+    QString error_;
+};
+
+struct NfaState
+{
+    SymbolSet symbols;         // Reads one of these and moves to next...
+    int next = -1;
+    std::vector<int> epsilon;  // ...or moves on to these without reading
+    bool match = false;
+};
+
+// Thompson construction, back to front: every node is built knowing where it continues
+class NfaBuilder
+{
+public:
+    std::vector<NfaState> states;
+    bool overflow = false;
+
+    int add(NfaState state)
+    {
+        overflow = overflow || states.size() >= static_cast<size_t>(kMaxNfaStates);
+        states.push_back(std::move(state));
+        return static_cast<int>(states.size()) - 1;
+    }
+
+    int build(const Node& node, int next)
+    {
+        if (overflow) {
+            return next;
+        }
+        switch (node.kind) {
+        case Node::Symbols: {
+            NfaState state;
+            state.symbols = node.symbols;
+            state.next = next;
+            return add(std::move(state));
+        }
+        case Node::Sequence:
+            for (auto it = node.children.rbegin(); it != node.children.rend(); ++it) {
+                next = build(*it, next);
+            }
+            return next;
+        case Node::Alternation: {
+            NfaState branch;
+            for (const Node& child : node.children) {
+                branch.epsilon.push_back(build(child, next));
+            }
+            return add(std::move(branch));
+        }
+        case Node::Repeat: {
+            const Node& body = node.children.front();
+            int entry = next;
+            if (node.max < 0) {
+                const int loop = add(NfaState());
+                const int bodyEntry = build(body, loop);
+                states[loop].epsilon = {bodyEntry, next};
+                entry = loop;
+            } else {
+                for (int i = node.min; i < node.max; ++i) {
+                    NfaState optional;
+                    optional.epsilon = {build(body, entry), next};
+                    entry = add(std::move(optional));
+                }
+            }
+            for (int i = 0; i < node.min; ++i) {
+                entry = build(body, entry);
+            }
+            return entry;
+        }
+        }
+        return next;
+    }
+};
+
+// Position after the construct opened at pos ('(' or '['), -1 if it isn't closed
+int skipBracketed(const QByteArray& pattern, int pos)
+{
+    int depth = 0;
+    bool inClass = false;
+    for (; pos < pattern.size(); ++pos) {
+        const char c = pattern.at(pos);
+        if (c == '\\') {
+            ++pos; // Escaped, whatever it is
+        } else if (inClass) {
+            if (c == '[' && pos + 1 < pattern.size() && pattern.at(pos + 1) == ':') {
+                const int posixEnd = pattern.indexOf(":]", pos + 2);
+                pos = posixEnd < 0 ? pos : posixEnd + 1;
+            } else if (c == ']') {
+                inClass = false;
+                if (depth == 0) {
+                    return pos + 1;
+                }
+            }
+        } else if (c == '[') {
+            inClass = true;
+            // A ']' right after '[' or '[^' is a member, not the end
+            if (pos + 1 < pattern.size() && pattern.at(pos + 1) == '^') {
+                ++pos;
+            }
+            if (pos + 1 < pattern.size() && pattern.at(pos + 1) == ']') {
+                ++pos;
+            }
+        } else if (c == '(') {
+            ++depth;
+        } else if (c == ')' && --depth == 0) {
+            return pos + 1;
+        }
+    }
+    return -1;
+}
+
+// Position after the escape sequence whose letter or digit is at pos
+int skipEscape(const QByteArray& pattern, int pos)
+{
+    const char letter = pattern.at(pos++);
+    auto skipTo = [&pattern, &pos](char close) {
+        const int end = pattern.indexOf(close, pos);
+        return end < 0 ? pattern.size() : end + 1;
+    };
+    const char next = pos < pattern.size() ? pattern.at(pos) : 0;
+    switch (letter) {
+    case 'x':
+        if (next == '{') {
+            return skipTo('}');
+        }
+        for (int digits = 0; digits < 2 && pos < pattern.size() && hexValue(pattern.at(pos)) >= 0; ++digits) {
+            ++pos;
+        }
+        return pos;
+    case 'o': case 'p': case 'P': case 'N': case 'g': case 'k':
+        if (next == '{') {
+            return skipTo('}');
+        }
+        if (next == '<') {
+            return skipTo('>');
+        }
+        if (next == '\'') {
+            ++pos;
+            return skipTo('\'');
+        }
+        return pos;
+    case 'c':
+        return qMin(pos + 1, pattern.size()); // Control character, \cX
+    default:
+        while (letter >= '0' && letter <= '9' && pos < pattern.size() && pattern.at(pos) >= '0'
+               && pattern.at(pos) <= '9') {
+            ++pos; // Backreference or octal code
+        }
+        return pos;
+    }
+}
+
+}  // namespace
+
+QByteArray ByteRegex::requiredLiteral(const QString& pattern, bool caseInsensitive)
+{
+    // Walks the top level of the pattern collecting runs of plain characters. Anything else
+    // (groups, classes, escapes for classes and assertions, anchors) ends a run; a quantifier
+    // allowing zero repetitions also drops the character it applies to. Alternation at the
+    // top level means no part is required.
+    const QByteArray utf8 = pattern.toUtf8();
+    QByteArray best;
+    QByteArray run;
+    auto endRun = [&best, &run]() {
+        if (run.size() > best.size()) {
+            best = run;
+        }
+        run.clear();
+    };
+
+    int pos = 0;
+    while (pos < utf8.size()) {
+        const uchar c = static_cast<uchar>(utf8.at(pos));
+        QByteArray literal; // The atom's bytes, if it is a plain character
+        switch (c) {
+        case '|':
+            return QByteArray();
+        case '(':
+            if (pos + 2 < utf8.size() && utf8.at(pos + 1) == '?') {
+                const char kind = utf8.at(pos + 2);
+                const bool inlineOptions = (kind >= 'a' && kind <= 'z' && kind != 'P') || kind == '-' || kind == '^';
+                if (inlineOptions) {
+                    return QByteArray(); // (?i) and the like change what later literals mean
+                }
+            }
+            pos = skipBracketed(utf8, pos);
+            break;
+        case '[':
+            pos = skipBracketed(utf8, pos);
+            break;
+        case '\\':
+            if (pos + 1 >= utf8.size()) {
+                return best;
+            }
+            if (utf8.at(pos + 1) == 'Q') {
+                return QByteArray(); // Quoting, rare enough not to bother
+            }
+            if (static_cast<uchar>(utf8.at(pos + 1)) < 0x80 && !isAsciiLetter(utf8.at(pos + 1))
+                && !(utf8.at(pos + 1) >= '0' && utf8.at(pos + 1) <= '9')) {
+                literal = utf8.mid(pos + 1, 1); // Escaped punctuation
+                pos += 2;
+            } else {
+                pos = skipEscape(utf8, pos + 1);
+            }
+            break;
+        case '.':
+        case '^':
+        case '$':
+        case ')':
+        case '*':
+        case '+':
+        case '?':
+        case '{':
+            ++pos;
+            break;
+        default:
+            if (c < 0x80) {
+                literal = utf8.mid(pos, 1);
+                ++pos;
+            } else {
+                const int length = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : 2;
+                if (!caseInsensitive) {
+                    literal = utf8.mid(pos, length); // Unicode case folding isn't ASCII folding
+                }
+                pos += length;
+            }
+            break;
+        }
+        if (pos < 0) {
+            return QByteArray(); // Unbalanced, QRegularExpression would have rejected it
+        }
+
+        // Quantifier applying to the atom
+        int min = 1;
+        bool quantified = true;
+        const char next = pos < utf8.size() ? utf8.at(pos) : 0;
+        if (next == '*' || next == '?') {
+            min = 0;
+            ++pos;
+        } else if (next == '+') {
+            ++pos;
+        } else if (next == '{' && pos + 1 < utf8.size() && utf8.at(pos + 1) >= '0' && utf8.at(pos + 1) <= '9') {
+            const int close = utf8.indexOf('}', pos);
+            if (close < 0) {
+                quantified = false;
+            } else {
+                min = utf8.mid(pos + 1, close - pos - 1).split(',').front().toInt();
+                pos = close + 1;
+            }
+        } else {
+            quantified = false;
+        }
+        if (quantified && pos < utf8.size() && (utf8.at(pos) == '?' || utf8.at(pos) == '+')) {
+            ++pos; // Lazy or possessive
+        }
+
+        if (literal.isEmpty()) {
+            endRun();
+        } else if (!quantified) {
+            run.append(literal);
+        } else {
+            if (min > 0) {
+                run.append(literal); // Required once, but what follows needn't be adjacent
+            }
+            endRun();
+        }
+    }
+    endRun();
+    return best;
+}
+
+ByteRegex::ByteRegex(const QString& pattern, bool caseInsensitive)
+{
+    const QByteArray utf8 = pattern.toUtf8();
+    Node root;
+    if (!Parser(utf8, caseInsensitive).parse(&root, &error_)) {
+        return;
+    }
+
+    NfaBuilder nfa;
+    NfaState matchState;
+    matchState.match = true;
+    const int match = nfa.add(matchState);
+    const int body = nfa.build(root, match);
+    // Searching, not anchored matching: any prefix of the line may come before the pattern
+    const int start = nfa.add(NfaState());
+    NfaState skip;
+    skip.symbols.set();
+    skip.symbols.reset(kLineEnd);
+    skip.next = start;
+    const int skipState = nfa.add(skip);
+    nfa.states[start].epsilon = {body, skipState};
+    if (nfa.overflow) {
+        error_ = QStringLiteral("pattern too large");
+        return;
+    }
+
+    // Symbols that no NFA state tells apart share a column of the transition table, which
+    // typically shrinks 258 columns to a dozen
+    classOf_.fill(0);
+    classCount_ = 1;
+    std::unordered_set<SymbolSet> seen;
+    for (const NfaState& state : nfa.states) {
+        if (state.symbols.none() || !seen.insert(state.symbols).second) {
+            continue;
+        }
+        std::vector<int> split(static_cast<size_t>(classCount_) * 2, -1);
+        int count = 0;
+        for (int symbol = 0; symbol < kSymbolCount; ++symbol) {
+            int& refined = split[classOf_[symbol] * 2 + (state.symbols[symbol] ? 1 : 0)];
+            if (refined < 0) {
+                refined = count++;
+            }
+            classOf_[symbol] = static_cast<quint16>(refined);
+        }
+        classCount_ = count;
+    }
+    std::vector<int> representative(classCount_);
+    for (int symbol = kSymbolCount - 1; symbol >= 0; --symbol) {
+        representative[classOf_[symbol]] = symbol;
+    }
+
+    // Subset construction. Every set containing the match state collapses into one
+    // absorbing state: what matters is whether the line matches, not where.
+    auto closure = [&nfa, match](std::vector<int> pending) {
+        std::vector<int> result;
+        std::vector<bool> visited(nfa.states.size());
+        while (!pending.empty()) {
+            const int index = pending.back();
+            pending.pop_back();
+            if (visited[index]) {
+                continue;
+            }
+            visited[index] = true;
+            const NfaState& state = nfa.states[index];
+            if (state.match) {
+                return std::vector<int> {match};
+            }
+            if (state.symbols.any()) {
+                result.push_back(index);
+            }
+            pending.insert(pending.end(), state.epsilon.begin(), state.epsilon.end());
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    };
+
+    std::map<std::vector<int>, int> ids;
+    std::vector<std::vector<int>> sets;
+    auto intern = [&ids, &sets](const std::vector<int>& set) {
+        const auto it = ids.find(set);
+        if (it != ids.end()) {
+            return it->second;
+        }
+        if (sets.size() >= static_cast<size_t>(kMaxDfaStates)) {
+            return -1;
+        }
+        ids.emplace(set, static_cast<int>(sets.size()));
+        sets.push_back(set);
+        return static_cast<int>(sets.size()) - 1;
+    };
+
+    const int startState = intern(closure({start}));
+    matchState_ = intern({match});
+    for (size_t state = 0; state < sets.size(); ++state) {
+        const std::vector<int> members = sets[state]; // intern() may reallocate sets
+        transitions_.resize((state + 1) * classCount_);
+        for (int symbolClass = 0; symbolClass < classCount_; ++symbolClass) {
+            int target = static_cast<int>(state);
+            if (target != matchState_) {
+                std::vector<int> reached;
+                for (int index : members) {
+                    if (nfa.states[index].symbols[representative[symbolClass]]) {
+                        reached.push_back(nfa.states[index].next);
+                    }
+                }
+                target = intern(closure(std::move(reached)));
+            }
+            if (target < 0) {
+                error_ = QStringLiteral("too many DFA states");
+                transitions_.clear();
+                return;
+            }
+            transitions_[state * classCount_ + symbolClass] = target;
+        }
+    }
+    start_ = startState;
+}
+
+bool ByteRegex::isValid() const
+{
+    return start_ >= 0;
+}
+
+const QString& ByteRegex::errorString() const
+{
+    return error_;
+}
+
+bool ByteRegex::matches(const char* line, qint64 length) const
+{
+    const qint32* table = transitions_.data();
+    const int classes = classCount_;
+    int state = table[start_ * classes + classOf_[kLineStart]];
+    for (qint64 i = 0; i < length && state != matchState_; ++i) {
+        state = table[state * classes + classOf_[static_cast<uchar>(line[i])]];
+    }
+    return state == matchState_ || table[state * classes + classOf_[kLineEnd]] == matchState_;
+}
+
+bool ByteRegex::isValidUtf8(const char* data, qint64 length)
+{
+    const uchar* bytes = reinterpret_cast<const uchar*>(data);
+    qint64 i = 0;
+    while (i < length) {
+        // Eight ASCII bytes at a time
+        if (i + 8 <= length) {
+            quint64 word;
+            std::memcpy(&word, bytes + i, sizeof(word));
+            if ((word & Q_UINT64_C(0x8080808080808080)) == 0) {
+                i += 8;
+                continue;
+            }
+        }
+        const uchar lead = bytes[i];
+        if (lead < 0x80) {
+            ++i;
+            continue;
+        }
+
+        // Bytes after the lead and the range of the first of them, which rules out overlong
+        // forms (E0, F0), surrogates (ED) and code points past U+10FFFF (F4)
+        int continuations = 0;
+        uchar low = 0x80;
+        uchar high = 0xBF;
+        if (lead >= 0xC2 && lead <= 0xDF) {
+            continuations = 1;
+        } else if (lead >= 0xE0 && lead <= 0xEF) {
+            continuations = 2;
+            if (lead == 0xE0) {
+                low = 0xA0;
+            } else if (lead == 0xED) {
+                high = 0x9F;
+            }
+        } else if (lead >= 0xF0 && lead <= 0xF4) {
+            continuations = 3;
+            if (lead == 0xF0) {
+                low = 0x90;
+            } else if (lead == 0xF4) {
+                high = 0x8F;
+            }
+        } else {
+            return false; // Stray continuation byte, C0, C1 or F5-FF
+        }
+        if (i + continuations >= length) {
+            return false; // Truncated by the end of the line
+        }
+        if (bytes[i + 1] < low || bytes[i + 1] > high) {
+            return false;
+        }
+        for (int c = 2; c <= continuations; ++c) {
+            if ((bytes[i + c] & 0xC0) != 0x80) {
+                return false;
+            }
+        }
+        i += continuations + 1;
+    }
+    return true;
+}
@@ -0,0 +1,57 @@
+#ifndef BYTE_REGEX_HPP
+#define BYTE_REGEX_HPP
+
+#include <array>
+#include <vector>
+
+#include <QByteArray>
+#include <QString>
+
+// Regular expression compiled to a DFA over UTF-8 bytes, so a line can be tested straight
+// from the mapped file: no QString decoding, no allocation, one table lookup per byte.
+//
+// Only the common subset of the QRegularExpression (PCRE2) syntax is supported: literals,
+// '.', classes with ASCII members, \d \w \s and their negations, groups, alternation,
+// greedy/lazy quantifiers and the ^ $ \A \z \Z anchors. Like QRegularExpression without
+// UseUnicodePropertiesOption, \d \w \s are ASCII-only and case folding applies to ASCII
+// letters; patterns using anything else (backreferences, lookaround, \b, non-ASCII
+// characters in a case-insensitive pattern, ...) or whose DFA gets too large leave the
+// ByteRegex invalid and the caller keeps using QRegularExpression.
+//
+// Lines must be valid UTF-8: '.' and negated classes match whole UTF-8 sequences, never
+// stray bytes. QString::fromUtf8() turns each byte of an invalid sequence into U+FFFD,
+// which '.' and [^x] do match, so callers check lines with isValidUtf8() and match the
+// invalid ones with QRegularExpression.
+class ByteRegex
+{
+public:
+    ByteRegex() = default;
+    ByteRegex(const QString& pattern, bool caseInsensitive);
+
+    bool isValid() const;
+    const QString& errorString() const; // Why the pattern can't be compiled, if invalid
+
+    // True if the pattern matches anywhere in the line (length excludes the terminator)
+    bool matches(const char* line, qint64 length) const;
+
+    // True if data is well-formed UTF-8 as QString::fromUtf8() decodes it: no stray
+    // continuation bytes, truncated or overlong sequences, surrogates or code points past
+    // U+10FFFF. Quick for ASCII, the usual log line.
+    static bool isValidUtf8(const char* data, qint64 length);
+
+    // Longest run of literal bytes every match of pattern contains, empty if none is found.
+    // Works on any QRegularExpression pattern (compiled without options other than
+    // CaseInsensitiveOption), not only the subset: what isn't understood is skipped over.
+    // For case-insensitive patterns the literal is ASCII and meant for ASCII case folding.
+    static QByteArray requiredLiteral(const QString& pattern, bool caseInsensitive);
+
+private:
+    std::vector<qint32> transitions_;      // stateCount x classCount_, next state
+    std::array<quint16, 258> classOf_ {};  // Symbol (byte, line start, line end) -> class
+    int classCount_ = 0;
+    int start_ = -1;
+    int matchState_ = -1; // Absorbing: once reached the line matches
+    QString error_;
+};
+
+#endif // BYTE_REGEX_HPP
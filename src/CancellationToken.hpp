@@ -0,0 +1,25 @@
+#ifndef CANCELLATION_TOKEN_HPP
+#define CANCELLATION_TOKEN_HPP
+
+#include <atomic>
+#include <memory>
+
+// Cooperative cancellation for background work. The owner keeps a token and hands copies
+// to its tasks; all copies share one flag. Tasks poll isCancelled() between chunks of work
+// (a few hundred KiB or a thousand rows), so a cancel takes effect within milliseconds
+// without any task being interrupted mid-write.
+//
+// A token can't be reset: work started after a cancel gets a fresh token.
+class CancellationToken
+{
+public:
+    CancellationToken() : cancelled_(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void cancel() const { cancelled_->store(true, std::memory_order_relaxed); }
+    bool isCancelled() const { return cancelled_->load(std::memory_order_relaxed); }
+
+private:
+    std::shared_ptr<std::atomic<bool>> cancelled_;
+};
+
+#endif // CANCELLATION_TOKEN_HPP
@@ -0,0 +1,25 @@
+#ifndef COMPLETION_LATCH_HPP
+#define COMPLETION_LATCH_HPP
+
+#include <atomic>
+#include <memory>
+
+// Counts down background work items; the one finishing last learns it from countDown() and
+// reports completion itself, so nobody has to poll. The owner creates the latch with the
+// number of items and hands copies to them; all copies share one counter.
+//
+// countDown() is acquire/release: whatever the other items wrote before counting down is
+// visible to the last one, and to whoever it hands the results to.
+class CompletionLatch
+{
+public:
+    explicit CompletionLatch(int count = 0) : remaining_(std::make_shared<std::atomic<int>>(count)) {}
+
+    bool countDown() const { return remaining_->fetch_sub(1, std::memory_order_acq_rel) == 1; } // True for the last
+    bool isDone() const { return remaining_->load(std::memory_order_acquire) <= 0; }
+
+private:
+    std::shared_ptr<std::atomic<int>> remaining_;
+};
+
+#endif // COMPLETION_LATCH_HPP
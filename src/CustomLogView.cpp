@@ -11,6 +11,9 @@
 #include <QApplication>
 #include <QTimer>
 #include <QVector> // Added for QVector
+#include <QPair>
+
+#include <algorithm>
 
 CustomLogView::CustomLogView(QWidget *parent)
     : QAbstractScrollArea(parent),
@@ -90,9 +93,78 @@ QAbstractItemModel *CustomLogView::model() const
 void CustomLogView::setHighlightRules(const QList<HighlightRule> &rules)
 {
     m_highlightRules = rules;
+
+    // One automaton for all rules: a painted line is searched once, not once per rule
+    m_highlightMatcher = AhoCorasick();
+    m_highlightRuleOf.clear();
+    for (int i = 0; i < m_highlightRules.size(); ++i) {
+        const HighlightRule &rule = m_highlightRules.at(i);
+        if (!rule.isEnabled || rule.substring.isEmpty()) continue;
+        // TODO: Add case sensitivity option from rule?
+        m_highlightMatcher.addPattern(rule.substring.toUtf8(), false);
+        m_highlightRuleOf.append(i);
+    }
+    m_highlightMatcher.build();
+
     viewport()->update(); // Trigger repaint to apply new rules
 }
 
+QVector<QTextLayout::FormatRange> CustomLogView::highlightFormats(const QString &text) const
+{
+    QVector<QTextLayout::FormatRange> formats;
+    if (m_highlightMatcher.isEmpty()) {
+        return formats;
+    }
+
+    // The matcher reports UTF-8 byte offsets, QTextLayout wants UTF-16 positions. They are
+    // the same unless the line has non-ASCII characters.
+    const QByteArray utf8 = text.toUtf8();
+    QVector<int> utf16At;
+    if (utf8.size() != text.size()) {
+        utf16At.resize(utf8.size() + 1);
+        int units = 0;
+        for (int i = 0; i < utf8.size(); ++i) {
+            utf16At[i] = units;
+            const uchar c = static_cast<uchar>(utf8.at(i));
+            if ((c & 0xC0) != 0x80) {
+                units += c >= 0xF0 ? 2 : 1; // 4-byte sequences are surrogate pairs
+            }
+        }
+        utf16At[utf8.size()] = units;
+    }
+    auto position = [&utf16At](qint64 byte) {
+        return utf16At.isEmpty() ? static_cast<int>(byte) : utf16At.at(static_cast<int>(byte));
+    };
+
+    // As when searching rule by rule from the left, a rule's own matches don't overlap
+    QVector<qint64> freeFrom(m_highlightMatcher.patternCount(), 0);
+    QVector<QPair<int, QTextLayout::FormatRange>> found;
+    m_highlightMatcher.forEachMatch(utf8.constData(), utf8.size(), [&](int id, qint64 begin) {
+        if (begin < freeFrom[id]) {
+            return true;
+        }
+        const qint64 end = begin + m_highlightMatcher.pattern(id).size();
+        freeFrom[id] = end;
+        QTextLayout::FormatRange range;
+        range.start = position(begin);
+        range.length = position(end) - range.start;
+        range.format.setForeground(m_highlightRules.at(m_highlightRuleOf.at(id)).color);
+        found.append(qMakePair(m_highlightRuleOf.at(id), range));
+        return true;
+    });
+
+    // Rule order decides which color wins where matches overlap, keep it
+    std::stable_sort(found.begin(), found.end(),
+                     [](const QPair<int, QTextLayout::FormatRange> &a, const QPair<int, QTextLayout::FormatRange> &b) {
+                         return a.first < b.first;
+                     });
+    formats.reserve(found.size());
+    for (const auto &match : found) {
+        formats.append(match.second);
+    }
+    return formats;
+}
+
 void CustomLogView::setupConnections()
 {
     if (!m_model) return;
@@ -151,25 +223,7 @@ void CustomLogView::paintEvent(QPaintEvent *event)
         QTextLayout textLayout(msgStr, m_font);
 
         // --- Apply Custom Highlighting Rules ---
-        QVector<QTextLayout::FormatRange> formats; // Changed from QList to QVector
-        for (const auto &rule : m_highlightRules) {
-            if (!rule.isEnabled || rule.substring.isEmpty()) continue;
-
-            int pos = 0;
-            // TODO: Add case sensitivity option from rule?
-            Qt::CaseSensitivity cs = Qt::CaseSensitive;
-            while ((pos = msgStr.indexOf(rule.substring, pos, cs)) != -1) {
-                QTextLayout::FormatRange range;
-                range.start = pos;
-                range.length = rule.substring.length();
-                QTextCharFormat format;
-                format.setForeground(rule.color);
-                // format.setBackground(rule.color.lighter(150)); // Example: slightly lighter background
-                range.format = format;
-                formats.append(range);
-                pos += rule.substring.length(); // Move past the found substring
-            }
-        }
+        QVector<QTextLayout::FormatRange> formats = highlightFormats(msgStr);
         // TODO: Handle overlapping formats if necessary (e.g., prioritize longer matches or first rule)
         textLayout.setFormats(formats);
 
@@ -460,11 +514,24 @@ void CustomLogView::onRowsInserted(const QModelIndex &parent, int first, int las
     Q_UNUSED(parent);
     Q_UNUSED(first);
     Q_UNUSED(last);
+    // Stay pinned to the end when following and the user hasn't scrolled away from it
+    const bool pinned = m_followTail && verticalScrollBar()->value() >= verticalScrollBar()->maximum();
     // Could potentially optimize repaint area, but full update is safer for now
     updateScrollBars();
+    if (pinned) {
+        verticalScrollBar()->setValue(verticalScrollBar()->maximum());
+    }
     viewport()->update();
 }
 
+void CustomLogView::setFollowTail(bool follow)
+{
+    m_followTail = follow;
+    if (m_followTail) {
+        verticalScrollBar()->setValue(verticalScrollBar()->maximum()); // Start at the end
+    }
+}
+
 void CustomLogView::onRowsRemoved(const QModelIndex &parent, int first, int last)
 {
      Q_UNUSED(parent);
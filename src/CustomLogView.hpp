@@ -7,6 +7,7 @@
 #include <QPersistentModelIndex> // Added for QPersistentModelIndex
 #include <QList> // Added for QList
 #include "HighlightRule.hpp" // Added for HighlightRule
+#include "AhoCorasick.hpp"
 
 // Forward declarations
 class LogfileModel;
@@ -56,6 +57,9 @@ public:
     // Method to set the highlighting rules
     void setHighlightRules(const QList<HighlightRule> &rules);
 
+    // Follow mode: while scrolled to the end, inserted rows keep the view at the end
+    void setFollowTail(bool follow);
+
 signals:
     // Emitted when the range of visible lines changes significantly (e.g., due to scrolling)
     void visibleRangeChanged(qint64 firstVisible, qint64 lastVisible);
@@ -84,6 +88,7 @@ private:
     int getTotalContentHeight() const;
     int getTotalContentWidth() const; // May need refinement for long lines
     QModelIndex indexAtPosition(const QPoint &position, int *charOffset = nullptr) const; // Get model index and char offset at a viewport position
+    QVector<QTextLayout::FormatRange> highlightFormats(const QString &text) const; // Highlight rule matches in one line
     // ensureIndexVisible moved to public section
 
     QAbstractItemModel *m_model = nullptr;
@@ -102,6 +107,10 @@ private:
 
     // Highlighting rules
     QList<HighlightRule> m_highlightRules;
+    AhoCorasick m_highlightMatcher;  // Substrings of the enabled rules, searched together
+    QVector<int> m_highlightRuleOf;  // Index in m_highlightRules of each matcher pattern
+
+    bool m_followTail = false;
 };
 
 #endif // CUSTOM_LOG_VIEW_HPP
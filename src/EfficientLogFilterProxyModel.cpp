@@ -2,123 +2,181 @@
 #include "Logfile.hpp" // Needed for Logfile methods
 #include "LogfileModel.hpp" // Needed to cast sourceModel()
 #include "GrepNode.hpp" // Needed for applyFilterChain
+#include "FilterPlan.hpp"
+#include "FilterQuery.hpp"
+#include "LineIndex.hpp"
+#include "MappedFile.hpp"
 
 #include <QDebug>
 #include <QApplication>
+#include <QLoggingCategory>
 #include <QRegularExpression>
 #include <QFile>
 #include <QVector>
-#include <QBitArray>
 #include <QList>
-#include <QThread>
-#include <QTimer>
-#include <QtConcurrent/QtConcurrent> // For QtConcurrent::run
+#include <QtAlgorithms> // For qPopulationCount
+#include <algorithm> // For std::rotate
 #include <stdexcept> // For std::runtime_error in mapFromSource
 #include <utility> // For std::pair
-#include <QMutexLocker> // For QMutexLocker
 
 // FilterParams and its operator== are now defined in FilterParams.hpp
 
+namespace
+{
+
+// Per-filter chatter, off by default: QT_LOGGING_RULES="prontopredator.filter.debug=true"
+Q_LOGGING_CATEGORY(lcFilter, "prontopredator.filter", QtWarningMsg)
+
+}  // namespace
+
 EfficientLogFilterProxyModel::EfficientLogFilterProxyModel(QObject* parent)
     : QAbstractProxyModel(parent)
 {
-    // Connection to filterWatcher_ removed (handled by QTimer/atomic counter)
+    connect(&tailWatcher_, &QFutureWatcher<QVector<int>>::finished,
+            this, &EfficientLogFilterProxyModel::handleTailFilterFinished);
+}
+
+EfficientLogFilterProxyModel::~EfficientLogFilterProxyModel()
+{
+    // Filter tasks write into members of this object. Running ones stop at their next
+    // check, queued ones are dropped right away instead of keeping the GUI thread waiting
+    // for a free worker.
+    filterCancel_.cancel();
+    tailCancel_.cancel();
+    lifetimeCancel_.cancel();
+    TaskScheduler::instance().discardCancelled();
+    for (QFuture<void>& task : filterTasks_) {
+        task.waitForFinished();
+    }
+}
+
+
+namespace
+{
+
+const qint64 kMatchSetCacheBytes = 64 * 1024 * 1024; // Budget of the cached match sets
+
+// Filter tasks publish their progress after every slice of rows. Slices start small, so the
+// first matches show up right away, and double up to a size where the per-slice cost
+// (range lookups, madvise) doesn't matter. Multiples of 64, the rows of a result word.
+const int kFirstSliceRows = 4096;
+const int kMaxSliceRows = 256 * 1024;
+
+// Rows are cut into chunks of about equal work for the worker threads to share. Aiming at
+// this many per worker leaves enough of them to even out skewed chunks by stealing; the
+// bounds keep small files from being cut into crumbs and huge ones from having chunks
+// that take long to finish (at the tail, the last chunk is what everybody waits for).
+const int kChunksPerWorker = 16;
+const qint64 kMinChunkBytes = 256 * 1024;
+const qint64 kMaxChunkBytes = 16 * 1024 * 1024;
+
+// The steps of a chain that actually filter; empty patterns (e.g. the grep tree's root) don't.
+// Chains are cached under these, so chains differing only in steps without a pattern share results.
+QList<FilterParams> stepsWithPattern(const QList<FilterParams>& chain)
+{
+    QList<FilterParams> steps;
+    for (const FilterParams& params : chain) {
+        if (!params.pattern.isEmpty()) {
+            steps.append(params);
+        }
+    }
+    return steps;
 }
 
+}  // namespace
 
 // --- FilterChunkTask Implementation ---
 void FilterChunkTask::run()
 {
     // Check for null pointers passed to constructor (basic safety)
-    // rowsToProcessChunk_ and lineIndex_ are now value members
-    if (!filename_ || !filterChainParams_ || !outputBitArray_ || !outputMutex_ || !tasksRemaining_) {
-        qWarning("FilterChunkTask %d: Invalid pointers provided.", taskId_);
-        if (tasksRemaining_) tasksRemaining_->fetch_sub(1); // Decrement counter if possible
+    if (!scheduler_ || !chunkStarts_ || !file_ || !lineIndex_ || !plan_ || !outputWords_ || !progress_) {
+        qWarning("FilterChunkTask %d: Invalid pointers provided.", workerId_);
+        finish();
         return;
     }
 
-    // Each thread needs its own QFile object
-    QFile threadLocalFile(*filename_);
-    if (!threadLocalFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        qWarning("FilterChunkTask %d: Failed to open file %s", taskId_, qPrintable(*filename_));
-        tasksRemaining_->fetch_sub(1); // Decrement counter
-        return;
+    // Own chunks in order, then stolen ones. A worker stops at the first chunk it can't
+    // finish: the filter was cancelled (so are the other workers), or the file can't be read.
+    WorkStealingScheduler::WorkerStats& stats = scheduler_->stats(workerId_);
+    QElapsedTimer busy;
+    busy.start();
+    for (int chunk = scheduler_->next(workerId_); chunk >= 0; chunk = scheduler_->next(workerId_)) {
+        if (!scanChunk(chunk)) {
+            break;
+        }
+        const int firstRow = chunkStarts_[chunk];
+        const int endRow = chunkStarts_[chunk + 1];
+        stats.rows += endRow - firstRow;
+        const qint64 endByte = lineIndex_->lineEnd(endRow - 1, file_->size());
+        stats.bytes += endByte - qMin(lineIndex_->at(firstRow), endByte);
+        if (onProgress_) {
+            onProgress_(); // Possibly the chunk the proxy is waiting for
+        }
     }
+    stats.busyMs = busy.elapsed();
 
-    // Process each row index in the assigned chunk (use the member variable)
-    for (int sourceRowIndex : rowsToProcessChunk_) {
-        // --- Cancellation Check (Optional but recommended) ---
-        // TODO: Implement a proper cancellation mechanism if needed (e.g., shared atomic bool)
-        // if (g_cancelFilteringFlag.load()) { threadLocalFile.close(); tasksRemaining_->fetch_sub(1); return; }
-
-        // Assume the line matches the full chain until proven otherwise
-        bool lineMatchesChain = true;
-
-        // Read the line text only if there's an actual filter to apply
-        QString lineText;
-        bool lineRead = false;
-
-        // Apply each filter step in the chain sequentially
-        for (const FilterParams& params : *filterChainParams_) { // Dereference pointer to list
-            // If the pattern for this step is empty, skip it
-            if (params.pattern.isEmpty()) continue;
-            // Regex validity already checked before starting tasks
-
-            // Read the line text if we haven't already for this row
-            if (!lineRead) {
-                // Check index bounds (important!) using the value member lineIndex_
-                if (sourceRowIndex < 0 || sourceRowIndex >= lineIndex_.size()) {
-                     qWarning("FilterChunkTask %d: Invalid sourceRowIndex %d", taskId_, sourceRowIndex);
-                     lineMatchesChain = false;
-                     break;
-                }
-                qint64 start_pos = lineIndex_.at(sourceRowIndex); // Use value member
-                if (!threadLocalFile.seek(start_pos)) {
-                    qWarning("FilterChunkTask %d: Failed to seek to pos %lld for line %d", taskId_, start_pos, sourceRowIndex + 1);
-                    lineMatchesChain = false; // Treat as non-match on error
-                    break; // Stop processing this line
-                }
-                QByteArray lineData = threadLocalFile.readLine();
-                lineText = QString::fromUtf8(lineData).trimmed();
-                lineRead = true;
-            }
+    finish();
+}
 
-            // Apply the *current step's* filter logic
-            bool stepMatchFound = false;
-            if (params.isRegex) {
-                 stepMatchFound = params.regex.match(lineText).hasMatch();
-            } else {
-                 stepMatchFound = lineText.contains(params.pattern, params.cs);
-            }
+bool FilterChunkTask::scanChunk(int chunk)
+{
+    const int firstRow = chunkStarts_[chunk];
+    const int endRow = chunkStarts_[chunk + 1];
 
-            // Check if the line passes this specific step (considering inversion)
-            bool passesThisStep = (params.inverted ? !stepMatchFound : stepMatchFound);
+    // Check index bounds (important!)
+    if (firstRow < 0 || (firstRow & 63) != 0 || endRow <= firstRow || endRow > lineIndex_->size()) {
+        qWarning("FilterChunkTask %d: Invalid row range %d-%d", workerId_, firstRow, endRow);
+        return false;
+    }
 
-            if (!passesThisStep) {
-                lineMatchesChain = false; // Line failed one step, it doesn't match the full chain
-                break; // No need to check further filter steps for this line
-            }
-        } // End of filter chain loop for one line
-
-        // If it's a match for the whole chain, update the shared output QBitArray safely
-        if (lineMatchesChain) {
-            QMutexLocker locker(outputMutex_); // Lock the mutex before accessing shared data
-            // Check bounds again before writing
-            if (sourceRowIndex >= 0 && sourceRowIndex < outputBitArray_->size()) {
-                 outputBitArray_->setBit(sourceRowIndex, true);
-            } else {
-                 qWarning("FilterChunkTask %d: Invalid sourceRowIndex %d for outputBitArray", taskId_, sourceRowIndex);
+    // Stream the chunk's rows as byte ranges, one per slice. Chunks and slices start at
+    // multiples of 64 rows, so every word of the result belongs to a single chunk and is
+    // complete at the end of a slice: matches are gathered in a local word and stored once
+    // it's complete, no locking. Words without a match stay zero. After each slice the
+    // proxy may show its rows (release pairs with the proxy's acquire). A cancelled result
+    // is thrown away by the proxy anyway.
+    quint64* const words = outputWords_;
+    std::atomic<int>* const progress = &progress_[chunk];
+    int sliceRows = kFirstSliceRows;
+    for (int sliceBegin = firstRow; sliceBegin < endRow; sliceRows = qMin(sliceRows * 2, kMaxSliceRows)) {
+        const int sliceEnd = static_cast<int>(qMin<qint64>(qint64(sliceBegin) + sliceRows, endRow));
+        qint64 wordIndex = sliceBegin >> 6;
+        quint64 word = 0;
+        auto collect = [&](qint64 row) {
+            if ((row >> 6) != wordIndex) {
+                words[wordIndex] = word;
+                wordIndex = row >> 6;
+                word = 0;
             }
-            // Mutex is automatically unlocked when locker goes out of scope
+            word |= quint64(1) << (row & 63);
+        };
+        bool complete;
+        if (candidates_) {
+            // Narrowing down a cached result: only its rows are read
+            complete = plan_->scanCandidates(*file_, *lineIndex_, candidates_->data(), sliceBegin, sliceEnd, cancel_,
+                                             collect);
+        } else {
+            complete = plan_->scan(*file_, *lineIndex_, sliceBegin, sliceEnd, cancel_, collect);
         }
-    } // End of row processing loop
-
-    threadLocalFile.close();
-    // qDebug("FilterChunkTask %d finished.", taskId_);
-
-    // Decrement the counter. The main thread will check if it reached zero.
-    tasksRemaining_->fetch_sub(1);
+        words[wordIndex] = word;
+        if (!complete) {
+            return false; // Cancelled or unreadable, the rest stays unmatched
+        }
+        progress->store(sliceEnd, std::memory_order_release);
+        if (onProgress_ && sliceEnd < endRow) {
+            onProgress_(); // The last slice is reported by run()
+        }
+        sliceBegin = sliceEnd;
+        TaskScheduler::yieldToUrgentWork(); // E.g. the viewport of another tab
+    }
+    return true;
+}
 
+void FilterChunkTask::finish()
+{
+    if (done_.countDown() && onDone_) {
+        onDone_();
+    }
 }
 // --- End FilterChunkTask Implementation ---
 
@@ -142,17 +200,17 @@ void EfficientLogFilterProxyModel::setSourceModel(QAbstractItemModel* sourceMode
     if (sourceModel_) {
         // Connect the crucial modelReset signal
         connect(sourceModel_, &QAbstractItemModel::modelReset, this, &EfficientLogFilterProxyModel::sourceModelReset);
+        // The source grows while its file is being indexed
+        connect(sourceModel_, &QAbstractItemModel::rowsInserted, this, &EfficientLogFilterProxyModel::sourceRowsInserted);
+        connect(sourceModel_, &QAbstractItemModel::rowsRemoved, this, &EfficientLogFilterProxyModel::sourceRowsRemoved);
         // Other connections remain commented out for now unless needed
-        // connect(sourceModel_, &QAbstractItemModel::rowsInserted, this, &EfficientLogFilterProxyModel::sourceRowsInserted);
-        // connect(sourceModel_, &QAbstractItemModel::rowsRemoved, this, &EfficientLogFilterProxyModel::sourceRowsRemoved);
         // connect(sourceModel_, &QAbstractItemModel::dataChanged, this, &EfficientLogFilterProxyModel::sourceDataChanged);
         // connect(sourceModel_, &QAbstractItemModel::layoutChanged, this, &EfficientLogFilterProxyModel::sourceLayoutChanged);
 
         // Initial population of mapping (assuming no filter initially)
         if (sourceModel_->rowCount() > 0) {
-             currentSourceMatches_.resize(sourceModel_->rowCount());
-              currentSourceMatches_.fill(true); // Initially, all rows match (no filter)
-              updateMapping(currentSourceMatches_); // Update view based on initial state
+              // Initially, all rows match (no filter)
+              updateMapping(RankSelectBitset(sourceModel_->rowCount(), true)); // Update view based on initial state
          } else {
               currentSourceMatches_.clear();
               // proxyToSourceMap_.clear(); // REMOVED
@@ -164,7 +222,7 @@ void EfficientLogFilterProxyModel::setSourceModel(QAbstractItemModel* sourceMode
          // proxyToSourceMap_.clear(); // REMOVED
          // sourceToProxyMap_.clear(); // REMOVED
          // Update mapping with empty results
-         updateMapping(currentSourceMatches_);
+         updateMapping(RankSelectBitset());
      }
 
      endResetModel(); // Signal completion of the model change
@@ -173,27 +231,24 @@ void EfficientLogFilterProxyModel::setSourceModel(QAbstractItemModel* sourceMode
 
 QModelIndex EfficientLogFilterProxyModel::mapToSource(const QModelIndex& proxyIndex) const
 {
-    // Use the restored map
-    if (!sourceModel_ || !proxyIndex.isValid() || proxyIndex.row() >= proxyToSourceMap_.size()) {
+    // The n-th proxy row is the n-th matching source row
+    if (!sourceModel_ || !proxyIndex.isValid() || proxyIndex.row() >= currentSourceMatches_.count()) {
         return QModelIndex();
     }
-    int sourceRow = proxyToSourceMap_.at(proxyIndex.row());
+    int sourceRow = currentSourceMatches_.select(proxyIndex.row());
     return sourceModel_->index(sourceRow, proxyIndex.column());
 }
 
 QModelIndex EfficientLogFilterProxyModel::mapFromSource(const QModelIndex& sourceIndex) const
 {
-    // Use the restored map
     if (!sourceModel_ || !sourceIndex.isValid()) {
         return QModelIndex();
     }
 
-    // Use the hash map for efficient lookup O(1) average
+    // A matching source row's proxy row is the number of matching rows before it
     int sourceRow = sourceIndex.row();
-    int proxyRow = sourceToProxyMap_.value(sourceRow, -1); // Returns -1 if not found
-
-    if (proxyRow != -1) {
-        return createIndex(proxyRow, sourceIndex.column());
+    if (sourceRow < currentSourceMatches_.size() && currentSourceMatches_.testBit(sourceRow)) {
+        return createIndex(currentSourceMatches_.rank(sourceRow), sourceIndex.column());
     } else {
         // Source row is not currently visible in the proxy
         return QModelIndex();
@@ -219,7 +274,7 @@ int EfficientLogFilterProxyModel::rowCount(const QModelIndex& parent) const
 {
     // No hierarchy, return 0 if parent is valid.
     // Otherwise, return the number of mapped rows.
-    return (!parent.isValid() && sourceModel_) ? proxyToSourceMap_.size() : 0;
+    return (!parent.isValid() && sourceModel_) ? currentSourceMatches_.count() : 0;
 }
 
 int EfficientLogFilterProxyModel::columnCount(const QModelIndex& parent) const
@@ -248,11 +303,13 @@ void EfficientLogFilterProxyModel::setSourceLogfile(Logfile* logfile)
     // Reset filter state when logfile changes
     lastAppliedFilterChainParams_.clear();
     currentFilterChainParams_.clear();
+    matchSetCache_.clear();
+    matchSetCacheBytes_ = 0;
+    ++sourceVersion_;
+    ++filterGeneration_;
     if (sourceModel_) {
         beginResetModel();
-        currentSourceMatches_.resize(sourceModel_->rowCount());
-        currentSourceMatches_.fill(true); // All rows match initially
-        updateMapping(currentSourceMatches_); // Rebuild map
+        updateMapping(RankSelectBitset(sourceModel_->rowCount(), true)); // All rows match initially
         endResetModel();
     }
 }
@@ -262,33 +319,73 @@ bool EfficientLogFilterProxyModel::isFiltering() const
     return isFiltering_;
 }
 
+EfficientLogFilterProxyModel::FilterLatency EfficientLogFilterProxyModel::lastFilterLatency() const
+{
+    return lastFilterLatency_;
+}
+
+void EfficientLogFilterProxyModel::setFilterThreadCount(int threadCount)
+{
+    filterThreadCount_ = qMax(0, threadCount); // Used from the next filter on
+}
+
+int EfficientLogFilterProxyModel::filterThreadCount() const
+{
+    return filterThreadCount_ > 0 ? filterThreadCount_ : TaskScheduler::instance().threadCount();
+}
+
+void EfficientLogFilterProxyModel::setForeground(bool foreground)
+{
+    filterClass_ = foreground ? TaskClass::ActiveFilter : TaskClass::BackgroundFilter;
+}
+
+QVector<WorkStealingScheduler::WorkerStats> EfficientLogFilterProxyModel::lastFilterWorkerStats() const
+{
+    return lastFilterWorkerStats_;
+}
+
 void EfficientLogFilterProxyModel::cancelFiltering()
 {
     if (isFiltering_) {
-        qDebug() << "Attempting to cancel filtering (Efficient)...";
-        filterWatcher_.cancel();
-        // Note: The task might not stop immediately. handleFilterFinished will check isCanceled().
+        qCDebug(lcFilter) << "Attempting to cancel filtering (Efficient)...";
+        currentFilterChainParams_ = lastAppliedFilterChainParams_; // Nothing to run afterwards
+        filterCancel_.cancel();
+        // Tasks stop at their next check; handleParallelFilterCompletion() then restores the old mapping
     }
 }
 
 // Adapted from LogFilterProxyModel::applyFilterChain
 void EfficientLogFilterProxyModel::applyFilterChain(const QList<GrepNode*>& chain)
 {
-    qDebug() << "EfficientLogFilterProxyModel::applyFilterChain: Received chain of size:" << chain.size();
+    qCDebug(lcFilter) << "EfficientLogFilterProxyModel::applyFilterChain: Received chain of size:" << chain.size();
     if (!sourceModel_ || !sourceLogfile_) {
          qWarning("EfficientLogFilterProxyModel: Cannot apply filter chain, source model or logfile not set.");
          return;
     }
 
     QList<FilterParams> newParamsList;
-    qDebug() << "  Building FilterParams list..."; // Log param building
     for (const GrepNode* node : chain) {
         if (!node) continue;
         FilterParams params;
         params.pattern = QString::fromStdString(node->getPattern());
-        params.isRegex = node->isRegEx();
+        params.isQuery = node->isQuery();
+        params.isRegex = node->isRegEx() && !params.isQuery; // A query marks its regexes itself
         params.cs = node->isCaseInsensitive() ? Qt::CaseInsensitive : Qt::CaseSensitive;
         params.inverted = node->isInverted();
+        if (params.isQuery && !params.pattern.isEmpty()) {
+            // Parsed again by the plan; checked here so a typo is reported, not ignored
+            const FilterQuery query(params.pattern, params.cs);
+            if (!query.isValid()) {
+                QMessageBox::warning(nullptr,
+                                     tr("Invalid Filter"),
+                                     tr("Invalid filter query:\n'%1'\n\nError at position %2: %3")
+                                     .arg(params.pattern)
+                                     .arg(query.errorPosition() + 1)
+                                     .arg(query.errorString()));
+                qWarning() << "Invalid query in filter chain:" << params.pattern << "Error:" << query.errorString();
+                return;
+            }
+        }
         if (params.isRegex) {
             QRegularExpression::PatternOptions options = QRegularExpression::NoPatternOption;
             if (params.cs == Qt::CaseInsensitive) {
@@ -308,10 +405,7 @@ void EfficientLogFilterProxyModel::applyFilterChain(const QList<GrepNode*>& chai
              }
         }
         newParamsList.append(params);
-        // Log details of each param
-        qDebug() << "    Param:" << params.pattern << "Regex:" << params.isRegex << "CS:" << params.cs << "Inv:" << params.inverted;
     }
-    qDebug() << "  FilterParams list built. Size:" << newParamsList.size();
 
     // Check if the new chain is the same as the last applied one
     bool chainsAreEqual = (newParamsList.size() == lastAppliedFilterChainParams_.size());
@@ -327,20 +421,24 @@ void EfficientLogFilterProxyModel::applyFilterChain(const QList<GrepNode*>& chai
 
     // Skip if already filtering OR if the chain hasn't changed
     if (isFiltering_) {
-        qDebug() << "Filter chain changed while filtering, will apply new filter after current one finishes.";
-        // Store the new chain to be picked up later if needed, or handle differently
+        if (newParamsList == runningFilterChainParams_) {
+            currentFilterChainParams_ = newParamsList;
+            return; // Already being computed
+        }
+        qCDebug(lcFilter) << "Filter chain changed while filtering, cancelling the running filter.";
+        // The running result is of no use anymore; the new chain starts once its tasks stopped
         currentFilterChainParams_ = newParamsList; // Store the *intended* filter
-        // Maybe queue the request? For now, just update intended and let current finish.
+        filterCancel_.cancel();
         return;
     }
 
     if (chainsAreEqual) { // Re-enable this check
-        qDebug() << "Filter chain hasn't changed, skipping redundant filtering.";
+        qCDebug(lcFilter) << "Filter chain hasn't changed, skipping redundant filtering.";
         return;
     }
 
     currentFilterChainParams_ = newParamsList;
-    qDebug() << "EfficientLogFilterProxyModel::applyFilterChain: Starting async filtering...";
+    qCDebug(lcFilter) << "EfficientLogFilterProxyModel::applyFilterChain: Starting async filtering...";
     startAsyncFiltering();
 }
 
@@ -348,7 +446,7 @@ void EfficientLogFilterProxyModel::applyFilterChain(const QList<GrepNode*>& chai
 void EfficientLogFilterProxyModel::startAsyncFiltering()
 {
     if (isFiltering_) { // Double check
-        qDebug() << "Filtering already in progress.";
+        qCDebug(lcFilter) << "Filtering already in progress.";
         return;
     }
     if (!sourceLogfile_ || !sourceModel_) {
@@ -356,201 +454,510 @@ void EfficientLogFilterProxyModel::startAsyncFiltering()
         return;
     }
     if (sourceModel_->rowCount() == 0) {
-        qDebug() << "Source model is empty, skipping filtering.";
+        qCDebug(lcFilter) << "Source model is empty, skipping filtering.";
         // Directly update with empty results
-        updateMapping(QBitArray(0));
+        updateMapping(RankSelectBitset());
         lastAppliedFilterChainParams_ = currentFilterChainParams_;
         emit filteringFinished(0);
         return;
     }
 
+    const QList<FilterParams> steps = stepsWithPattern(currentFilterChainParams_);
+    const int sourceRowCount = sourceModel_->rowCount();
+    filterClock_.start();
+    CachedMatchSet* prefix = useCachedPrefix(steps);
+    if (prefix && prefix->steps.size() == steps.size() && prefix->matches.rows() == sourceRowCount) {
+        // Computed before for all rows: applied right away, no tasks
+        lastFilterLatency_.totalMs = lastFilterLatency_.firstResultsMs = filterClock_.elapsed();
+        lastFilterLatency_.fromCache = true;
+        ++filterGeneration_;
+        tailCancel_.cancel();
+        lastAppliedFilterChainParams_ = currentFilterChainParams_;
+        RankSelectBitset matches(prefix->matches.toWords(), sourceRowCount);
+        const int matchCount = matches.count();
+        qCDebug(lcFilter) << "Applying the cached match set of a chain of" << steps.size() << "steps";
+        emit filteringStarted();
+        updateMapping(std::move(matches));
+        emit filteringFinished(matchCount); // Listeners see the new rows
+        filterAppendedRows();
+        return;
+    }
+
     isFiltering_ = true;
+    ++filterGeneration_; // Tail evaluations of the previous chain are stale now
+    tailCancel_.cancel(); // A tail evaluation of the previous chain is stale
+    filterCancel_ = CancellationToken();
+    runningFilterChainParams_ = currentFilterChainParams_;
+    runningSourceVersion_ = sourceVersion_;
+    runningFilterLatency_ = FilterLatency();
     emit filteringStarted();
 
     // Prepare data for tasks (use pointers/references where safe)
-    const QString* filenamePtr = &sourceLogfile_->getFileName(); // Pointer is fine, Logfile lifetime > task
-    // Store the copy locally first, then take its address
-    QVector<qint64> lineIndexCopy = sourceLogfile_->getLineIndexCopy();
-    const QVector<qint64>* lineIndexPtr = &lineIndexCopy;
-    const QList<FilterParams>* filterChainParamsPtr = &currentFilterChainParams_; // Pointer is fine
-
-    int sourceRowCount = sourceModel_->rowCount();
-    parallelFilterResult_.resize(sourceRowCount); // Resize shared result array
-    parallelFilterResult_.fill(false); // Initialize to false (only set true on match)
-
-    int numThreads = QThread::idealThreadCount();
-    // Clamp threads to a reasonable number, e.g., max 8, min 1
-    numThreads = qBound(1, numThreads, 8);
-    int chunkSize = (sourceRowCount + numThreads - 1) / numThreads; // Ceiling division
-
-    qDebug() << "Starting parallel filtering with" << numThreads << "threads, chunk size" << chunkSize;
+    std::shared_ptr<const MappedFile> mappedFile = sourceLogfile_->getMappedFile(); // Shared by all tasks
+    if (!mappedFile) {
+        qWarning("Cannot filter: source Logfile has no open file.");
+        isFiltering_ = false;
+        emit filteringFinished(currentSourceMatches_.count());
+        return;
+    }
+    std::shared_ptr<const LineIndex> lineIndex = sourceLogfile_->getLineIndex(); // Shared, not copied
 
-    tasksRemaining_.store(numThreads); // Initialize atomic counter
+    // Matches are shown as the tasks find them, in file order, starting from an empty view.
+    // The current mapping comes back if the filter is cancelled.
+    beginResetModel();
+    previousSourceMatches_ = std::move(currentSourceMatches_);
+    currentSourceMatches_.clear();
+    endResetModel();
 
-    // Create and start tasks
-    QVector<QVector<int>> rowChunks(numThreads);
-    for (int i = 0; i < sourceRowCount; ++i) {
-        rowChunks[i / chunkSize].append(i); // Distribute source row indices into chunks
+    parallelFilterWords_.assign((static_cast<size_t>(sourceRowCount) + 63) / 64, 0); // Only set on match
+    parallelFilterValidRows_ = sourceRowCount;
+
+    // A child node refines its parent: if a prefix of the chain was filtered before, only
+    // the rows it matched can match the whole chain. Rows appended since it was computed
+    // are candidates too, and then all steps have to be checked again.
+    QList<FilterParams> planSteps = steps;
+    std::shared_ptr<const std::vector<quint64>> candidates;
+    if (prefix) {
+        auto words = std::make_shared<std::vector<quint64>>(prefix->matches.toWords());
+        words->resize(parallelFilterWords_.size(), 0);
+        const int coveredRows = qMin(prefix->matches.rows(), sourceRowCount);
+        if (coveredRows & 63) {
+            (*words)[coveredRows >> 6] |= ~quint64(0) << (coveredRows & 63);
+        }
+        std::fill(words->begin() + ((coveredRows + 63) >> 6), words->end(), ~quint64(0));
+        if (coveredRows == sourceRowCount) {
+            planSteps = steps.mid(prefix->steps.size());
+        }
+        candidates = std::move(words);
+        qCDebug(lcFilter) << "Filtering the matches of a cached chain of" << prefix->steps.size() << "steps";
     }
-
-    for (int i = 0; i < numThreads; ++i) {
-        if (rowChunks[i].isEmpty()) {
-             tasksRemaining_.fetch_sub(1); // Decrement counter if a chunk is empty
-             continue;
+    auto plan = std::make_shared<const FilterPlan>(planSteps); // Compiled once for all tasks
+
+    const int workerCount = filterThreadCount();
+
+    // Chunks of about equal work, starting at whole words of the result bitset
+    QVector<int> chunkStarts;
+    chunkStarts.append(0);
+    if (candidates) {
+        // Work is per candidate row
+        qint64 total = 0;
+        for (quint64 word : *candidates) {
+            total += qPopulationCount(word);
+        }
+        const qint64 chunkCandidates = qMax<qint64>(1, total / (qint64(workerCount) * kChunksPerWorker));
+        qint64 seen = 0;
+        qint64 nextCut = chunkCandidates;
+        for (size_t w = 0; w < candidates->size(); ++w) {
+            if (seen >= nextCut) {
+                chunkStarts.append(static_cast<int>(w * 64));
+                nextCut = seen + chunkCandidates;
+            }
+            seen += qPopulationCount((*candidates)[w]);
+        }
+        qCDebug(lcFilter) << "Starting parallel filtering of" << total << "candidate rows on" << workerCount << "threads";
+    } else {
+        // Chunks of about the same size in bytes, so long and short lines even out
+        const qint64 endByte = lineIndex->lineEnd(sourceRowCount - 1, mappedFile->size());
+        const qint64 firstByte = qMin(lineIndex->at(0), endByte);
+        const qint64 chunkBytes = qBound(kMinChunkBytes, (endByte - firstByte) / (qint64(workerCount) * kChunksPerWorker),
+                                         kMaxChunkBytes);
+        for (qint64 offset = firstByte + chunkBytes; offset < endByte; offset += chunkBytes) {
+            // Rounded down to a whole word of the result bitset
+            const qint64 row = FilterPlan::rowAtOffset(*lineIndex, sourceRowCount, offset) & ~qint64(63);
+            if (row > chunkStarts.last() && row < sourceRowCount) {
+                chunkStarts.append(static_cast<int>(row));
+            }
+        }
+        qCDebug(lcFilter) << "Starting parallel filtering over" << (endByte - firstByte) << "bytes on" << workerCount
+                          << "threads";
+    }
+    if (chunkStarts.last() >= sourceRowCount) {
+        chunkStarts.removeLast();
+    }
+    chunkStarts.append(sourceRowCount);
+    const int chunkCount = chunkStarts.size() - 1;
+    const int taskCount = qMin(workerCount, chunkCount);
+
+    parallelFilterRanges_ = chunkStarts;
+    parallelFilterProgress_.reset(new std::atomic<int>[chunkCount]);
+    for (int i = 0; i < chunkCount; ++i) {
+        parallelFilterProgress_[i].store(chunkStarts[i]);
+    }
+    publishedFilterChunks_ = 0;
+    filterScheduler_ = std::make_shared<WorkStealingScheduler>(chunkCount, taskCount);
+
+    // Tasks report back on this thread through queued calls: progress at most one call at a
+    // time (the flag is cleared when it runs), completion by the last task to finish. Both
+    // are dropped if the model is gone, and it waits for its tasks when destroyed anyway.
+    filterProgressQueued_.store(false);
+    auto onProgress = [this]() {
+        if (!filterProgressQueued_.exchange(true)) {
+            QMetaObject::invokeMethod(this, "publishFilterProgress", Qt::QueuedConnection);
         }
-        // Pass vectors by const reference (constructor will copy them)
-        // Pass other data by pointer
-        FilterChunkTask* task = new FilterChunkTask(
+    };
+    auto onDone = [this]() { QMetaObject::invokeMethod(this, "handleFilterTasksFinished", Qt::QueuedConnection); };
+    const CompletionLatch done(taskCount);
+
+    // One task per worker thread, each taking chunks until none are left. They're queued
+    // with lifetimeCancel_, not filterCancel_: a task dropped when the filter is cancelled
+    // would never count down the latch. Only the destructor drops them, nothing waits for the
+    // latch by then.
+    filterTasks_.clear();
+    for (int i = 0; i < taskCount; ++i) {
+        auto task = std::make_shared<FilterChunkTask>(
             i,
-            rowChunks[i],       // Pass vector by const reference
-            filenamePtr,
-            lineIndexCopy,      // Pass vector by const reference
-            filterChainParamsPtr,
-            &parallelFilterResult_, // Pointer to shared result array
-            &resultMutex_,         // Pointer to shared mutex
-            &tasksRemaining_       // Pointer to atomic counter
+            filterScheduler_,
+            parallelFilterRanges_.constData(), // Kept until the tasks are done
+            mappedFile,
+            lineIndex,
+            plan,
+            candidates,
+            parallelFilterWords_.data(), // Shared result bitset, disjoint words per chunk
+            parallelFilterProgress_.get(),
+            onProgress,
+            done,
+            onDone,
+            filterCancel_
         );
-        QThreadPool::globalInstance()->start(task);
-    }
-
-    // We no longer use QFutureWatcher directly here.
-    // Completion is handled when tasksRemaining_ hits zero.
-    // We need a mechanism to check this counter and call handleFilterFinished.
-    // Using a QTimer is one way, or connecting a signal from the task (more complex).
-
-    // Let's try checking periodically with a QTimer (simplest for now)
-    // This timer should be stopped in handleFilterFinished or cancelFiltering
-    QTimer* checkTimer = new QTimer(this);
-    connect(checkTimer, &QTimer::timeout, this, [this, checkTimer]() {
-        if (tasksRemaining_.load() == 0) {
-            checkTimer->stop();
-            checkTimer->deleteLater();
-            // Check if cancellation was requested *during* the tasks
-            // TODO: Implement proper cancellation check for parallel tasks if needed
-            bool wasCancelled = false; // Placeholder
-            handleParallelFilterCompletion(wasCancelled);
-        }
-    });
-    checkTimer->start(50); // Check every 50ms
+        filterTasks_.append(TaskScheduler::instance().run(filterClass_, lifetimeCancel_, [task]() { task->run(); }));
+    }
+}
+
+// Queued by the last filter task to finish
+void EfficientLogFilterProxyModel::handleFilterTasksFinished()
+{
+    if (!isFiltering_) {
+        return;
+    }
+    // Cancellation requested until now counts: the result may no longer be wanted
+    handleParallelFilterCompletion(filterCancel_.isCancelled());
 }
 
 // New function to handle completion of parallel tasks
 void EfficientLogFilterProxyModel::handleParallelFilterCompletion(bool wasCancelled)
 {
-     // This function is called when tasksRemaining_ hits 0
-     qDebug() << "All parallel filter tasks finished.";
+     // Called once all tasks of the running filter finished (see handleFilterTasksFinished())
+     qCDebug(lcFilter) << "All parallel filter tasks finished.";
 
-     int matchCount = 0;
+     isFiltering_ = false; // Mark filtering as done
 
      if (!wasCancelled) {
-         // The result is already in parallelFilterResult_
-         lastAppliedFilterChainParams_ = currentFilterChainParams_; // Store the successfully applied filter
-         matchCount = parallelFilterResult_.count(true);
-         qDebug() << "Parallel filtering finished. Matches found:" << matchCount;
-     } else {
-         qDebug() << "Parallel filtering was cancelled.";
-         // If cancelled, revert to the state before this filter started
-         parallelFilterResult_ = currentSourceMatches_; // Use old matches
-         matchCount = parallelFilterResult_.count(true);
+         // Rows removed from the source while the tasks ran are dropped and evaluated again
+         // once they're back
+         publishFilterMatches(parallelFilterValidRows_);
+         lastAppliedFilterChainParams_ = runningFilterChainParams_; // Store the successfully applied filter
+         cacheMatchSet(stepsWithPattern(runningFilterChainParams_), runningSourceVersion_,
+                       MatchSet::fromWords(parallelFilterWords_.data(), parallelFilterValidRows_));
+         runningFilterLatency_.totalMs = filterClock_.elapsed();
+         lastFilterLatency_ = runningFilterLatency_;
+         qInfo("Filtered %d rows in %lld ms (first matches shown after %lld ms), %d matches",
+               parallelFilterValidRows_, lastFilterLatency_.totalMs, lastFilterLatency_.firstResultsMs,
+               currentSourceMatches_.count());
+         lastFilterWorkerStats_.clear();
+         for (int worker = 0; worker < filterScheduler_->workerCount(); ++worker) {
+             const WorkStealingScheduler::WorkerStats& stats = filterScheduler_->stats(worker);
+             lastFilterWorkerStats_.append(stats);
+             qCDebug(lcFilter, "Filter worker %d: %d chunks (%d stolen in %d steals), %lld rows, %lld bytes, busy %lld ms",
+                     worker, stats.chunks, stats.stolenChunks, stats.steals, stats.rows, stats.bytes, stats.busyMs);
+         }
+     } else if (currentFilterChainParams_ == lastAppliedFilterChainParams_) {
+         qCDebug(lcFilter) << "Parallel filtering was cancelled.";
+         // Back to the state before this filter started
+         updateMapping(std::move(previousSourceMatches_));
      }
+     // Otherwise the chain applied meanwhile starts over from an empty view below
 
-     isFiltering_ = false; // Mark filtering as done
+     previousSourceMatches_.clear();
+     std::vector<quint64>().swap(parallelFilterWords_); // Release the bitset
+     parallelFilterProgress_.reset();
+     parallelFilterRanges_.clear();
+     filterScheduler_.reset();
+     filterTasks_.clear(); // Done with this object
 
-     // Emit signal *before* potentially blocking map update
-     emit filteringFinished(matchCount);
+     emit filteringFinished(currentSourceMatches_.count());
 
-     // Update the model mapping using the combined result
-     if (!wasCancelled) {
-         updateMapping(parallelFilterResult_);
+     // A chain applied while this one ran cancelled it and is started now
+     if (wasCancelled && !(currentFilterChainParams_ == lastAppliedFilterChainParams_)) {
+         startAsyncFiltering();
+         return;
      }
-     // If cancelled, mapping remains unchanged (using old currentSourceMatches_)
+
+     // Rows appended while the filter ran are evaluated on their own
+     filterAppendedRows();
 }
 
 
-// Adapted from LogFilterProxyModel::handleFilterFinished - REMOVED (handled by handleParallelFilterCompletion)
+// Shows the matches in the leading rows the running filter is done with: every chunk up to
+// the first unfinished one, and that one's finished slices
+void EfficientLogFilterProxyModel::publishFilterProgress()
+{
+    filterProgressQueued_.store(false); // Progress made from now on needs another call
+    if (!isFiltering_ || filterCancel_.isCancelled()) {
+        return;
+    }
+    const int chunkCount = parallelFilterRanges_.size() - 1;
+    while (publishedFilterChunks_ < chunkCount
+           && parallelFilterProgress_[publishedFilterChunks_].load(std::memory_order_acquire)
+                  >= parallelFilterRanges_[publishedFilterChunks_ + 1]) {
+        ++publishedFilterChunks_; // Done for good, no need to look at it again
+    }
+    const int readyRows = publishedFilterChunks_ < chunkCount
+        ? parallelFilterProgress_[publishedFilterChunks_].load(std::memory_order_acquire)
+        : parallelFilterRanges_.last();
+    const int shownRows = currentSourceMatches_.size();
+    publishFilterMatches(qMin(readyRows, parallelFilterValidRows_));
+    if (currentSourceMatches_.size() > shownRows) {
+        if (runningFilterLatency_.firstResultsMs < 0 && currentSourceMatches_.count() > 0) {
+            runningFilterLatency_.firstResultsMs = filterClock_.elapsed();
+        }
+        emit filteringProgress(currentSourceMatches_.count());
+    }
+}
 
-// --- Static Filtering Task --- (REMOVED - Dead Code)
-/*
-QBitArray EfficientLogFilterProxyModel::performFilteringTask(...) { ... }
-*/
+// Appends the running filter's matches in [currentSourceMatches_.size(), endRow) to the
+// mapping, one rowsInserted for all of them
+void EfficientLogFilterProxyModel::publishFilterMatches(int endRow)
+{
+    const int first = currentSourceMatches_.size();
+    if (endRow <= first) {
+        return;
+    }
+    // Straight from the tasks' words, no list of rows
+    const int added = RankSelectBitset::countBits(parallelFilterWords_.data(), first, endRow);
+    if (added == 0) {
+        currentSourceMatches_.resize(endRow);
+        return;
+    }
+    const int firstProxyRow = currentSourceMatches_.count();
+    beginInsertRows(QModelIndex(), firstProxyRow, firstProxyRow + added - 1);
+    currentSourceMatches_.appendWords(parallelFilterWords_.data(), endRow);
+    endInsertRows();
+}
 
 // --- The Core Update Logic ---
-void EfficientLogFilterProxyModel::updateMapping(const QBitArray& newMatches)
+void EfficientLogFilterProxyModel::updateMapping(RankSelectBitset newMatches)
 {
     if (!sourceModel_) return;
 
-    qDebug() << "Updating mapping...";
-    QBitArray oldMatches = currentSourceMatches_; // Keep a copy of the old state
-    currentSourceMatches_ = newMatches; // Store the new state
-
-    // Ensure sizes match (should happen if source model hasn't changed drastically)
-    if (oldMatches.size() != currentSourceMatches_.size()) {
-         qWarning("EfficientLogFilterProxyModel::updateMapping: Mismatch between old and new match array sizes. Resetting model.");
-         beginResetModel();
-         proxyToSourceMap_.clear();
-         for (int sourceRow = 0; sourceRow < currentSourceMatches_.size(); ++sourceRow) {
-             if (currentSourceMatches_.testBit(sourceRow)) {
-                 proxyToSourceMap_.append(sourceRow);
-             }
-         }
-         endResetModel();
-         return;
-    }
-
     // --- Always use Reset Model based on perf results ---
     // The batching logic (beginInsert/RemoveRows) triggers extremely expensive
     // QHeaderView::isSectionHidden calls when many rows change.
     // Resetting the model is faster overall, despite losing view state.
-    qDebug() << "Using beginResetModel/endResetModel for update.";
+    // The match bitset is the mapping itself (rank/select), so there's nothing to rebuild.
     beginResetModel();
-    proxyToSourceMap_.clear();
-    sourceToProxyMap_.clear();
-    int currentProxyRow = 0;
-    // Iterate based on the size of the new results
-    for (int sourceRow = 0; sourceRow < newMatches.size(); ++sourceRow) {
-        // Check the bit in the *new* results array passed to the function
-        if (newMatches.testBit(sourceRow)) {
-            proxyToSourceMap_.append(sourceRow);
-            sourceToProxyMap_.insert(sourceRow, currentProxyRow++);
-        }
-    }
+    currentSourceMatches_ = std::move(newMatches);
     endResetModel();
-    // --- End Reset Model Logic ---
 
-    qDebug() << "Mapping update finished. New proxy row count:" << proxyToSourceMap_.size();
+    qCDebug(lcFilter) << "Mapping update finished. New proxy row count:" << currentSourceMatches_.count();
 }
 
 // Slot implementation for source model reset
 void EfficientLogFilterProxyModel::sourceModelReset()
 {
-    qDebug() << "Source model reset detected. Re-evaluating filter mapping.";
+    qCDebug(lcFilter) << "Source model reset detected. Re-evaluating filter mapping.";
     if (!sourceModel_) return;
 
-    // Rebuild the mapping based on the current filter results (currentSourceMatches_)
-    // which should correspond to the last applied filter.
-    // If the source model size changed drastically, currentSourceMatches_ might be invalid.
-    // A safer approach is to assume no filter is active initially after a reset,
-    // or re-trigger the filtering process if a filter *was* active.
+    // The rows are new, whatever was matched before says nothing about them: the mapping
+    // shows all of them until the chain on display has run again over the new rows.
+    matchSetCache_.clear(); // Rows no longer are what the cached sets describe
+    matchSetCacheBytes_ = 0;
+    ++sourceVersion_;
+    ++filterGeneration_;
+    lastAppliedFilterChainParams_.clear(); // Nothing is applied to the rows shown now
+    updateMapping(RankSelectBitset(sourceModel_->rowCount(), true));
+    if (isFiltering_) {
+        // The running filter's rows are gone. Cancelled, it's started again over the new
+        // ones (see handleParallelFilterCompletion()), or if cancelled for good this state is
+        // what's left.
+        previousSourceMatches_ = currentSourceMatches_;
+        filterCancel_.cancel();
+    } else if (!currentFilterChainParams_.isEmpty()) {
+        startAsyncFiltering(); // Re-apply the chain that was shown
+    }
+}
 
-    // For simplicity, let's reset to show all rows initially, matching setSourceModel logic.
-    // A more complex approach could re-apply the last filter.
+// Slot implementation for rows appended to the source (progressive indexing, follow mode)
+void EfficientLogFilterProxyModel::sourceRowsInserted(const QModelIndex& parent, int first, int last)
+{
+    Q_UNUSED(last);
+    if (parent.isValid() || !sourceModel_) return;
+    if (first < currentSourceMatches_.size()) {
+        // Only appends are expected; anything else gets the reset treatment
+        sourceModelReset();
+        return;
+    }
+    filterAppendedRows();
+}
 
-    // Prepare the state (show all rows) and let updateMapping handle the reset signals
-    if (sourceModel_->rowCount() > 0) {
-         currentSourceMatches_.resize(sourceModel_->rowCount());
-         currentSourceMatches_.fill(true); // Assume all rows match initially
+// Slot implementation for trailing source rows removed because their lines changed on disk
+void EfficientLogFilterProxyModel::sourceRowsRemoved(const QModelIndex& parent, int first, int last)
+{
+    Q_UNUSED(last);
+    if (parent.isValid() || !sourceModel_) return;
+    if (isFiltering_) {
+        // The running tasks still write to the full result, it's cut when they're done
+        parallelFilterValidRows_ = qMin(parallelFilterValidRows_, first);
+        if (first < previousSourceMatches_.size()) {
+            previousSourceMatches_.resize(first);
+        }
+    }
+    ++filterGeneration_; // A running tail evaluation covers removed rows
+    for (auto it = matchSetCache_.begin(); it != matchSetCache_.end();) {
+        // The removed rows will be evaluated when they're back
+        matchSetCacheBytes_ -= it->matches.byteSize();
+        it->matches.truncate(first);
+        matchSetCacheBytes_ += it->matches.byteSize();
+        if (it->matches.rows() > 0) {
+            ++it;
+        } else {
+            matchSetCacheBytes_ -= it->matches.byteSize();
+            it = matchSetCache_.erase(it);
+        }
+    }
+    if (first >= currentSourceMatches_.size()) {
+        return;
+    }
+
+    // Proxy rows are ordered like their source rows, so the removed ones are a suffix
+    const int firstProxyRow = currentSourceMatches_.rank(first);
+    if (firstProxyRow < currentSourceMatches_.count()) {
+        beginRemoveRows(QModelIndex(), firstProxyRow, currentSourceMatches_.count() - 1);
+        currentSourceMatches_.resize(first);
+        endRemoveRows();
     } else {
-         currentSourceMatches_.clear();
+        currentSourceMatches_.resize(first);
     }
-    // Call updateMapping to rebuild the map and emit reset signals
-    updateMapping(currentSourceMatches_);
-
-    // Optional: If a filter was previously applied (lastAppliedFilterChainParams_ is not empty),
-    // you might want to automatically re-apply it here by calling applyFilterChain again.
-    // if (!lastAppliedFilterChainParams_.isEmpty()) {
-    //     qDebug() << "Re-applying previous filter after source model reset.";
-    //     // Need to copy params as applyFilterChain might modify them
-    //     QList<FilterParams> paramsToReapply = lastAppliedFilterChainParams_;
-    //     // applyFilterChain(paramsToReapply); // Be careful about triggering loops
-    // }
+}
+
+EfficientLogFilterProxyModel::CachedMatchSet* EfficientLogFilterProxyModel::useCachedPrefix(
+    const QList<FilterParams>& steps)
+{
+    auto best = matchSetCache_.end();
+    for (auto it = matchSetCache_.begin(); it != matchSetCache_.end(); ++it) {
+        const bool isPrefix = it->sourceVersion == sourceVersion_ && it->steps.size() <= steps.size()
+                              && std::equal(it->steps.begin(), it->steps.end(), steps.begin());
+        if (isPrefix && (best == matchSetCache_.end() || it->steps.size() > best->steps.size())) {
+            best = it;
+        }
+    }
+    if (best == matchSetCache_.end()) {
+        return nullptr;
+    }
+    std::rotate(best, best + 1, matchSetCache_.end()); // Most recently used last
+    return &matchSetCache_.back();
+}
+
+void EfficientLogFilterProxyModel::cacheMatchSet(const QList<FilterParams>& steps, quint64 sourceVersion,
+                                                 MatchSet matches)
+{
+    if (steps.isEmpty() || matches.rows() <= 0 || sourceVersion != sourceVersion_) {
+        return; // Every row matches, or the rows it describes are gone
+    }
+    for (auto it = matchSetCache_.begin(); it != matchSetCache_.end(); ++it) {
+        if (it->steps == steps) {
+            matchSetCacheBytes_ -= it->matches.byteSize();
+            matchSetCache_.erase(it);
+            break;
+        }
+    }
+    if (matches.byteSize() > kMatchSetCacheBytes) {
+        return;
+    }
+    matchSetCacheBytes_ += matches.byteSize();
+    CachedMatchSet cached;
+    cached.steps = steps;
+    cached.sourceVersion = sourceVersion;
+    cached.matches = std::move(matches);
+    matchSetCache_.push_back(std::move(cached));
+
+    // Least recently used sets go first
+    auto kept = matchSetCache_.begin();
+    while (matchSetCacheBytes_ > kMatchSetCacheBytes) {
+        matchSetCacheBytes_ -= kept->matches.byteSize();
+        ++kept;
+    }
+    matchSetCache_.erase(matchSetCache_.begin(), kept);
+}
+
+bool EfficientLogFilterProxyModel::showsAllRows() const
+{
+    for (const FilterParams& params : lastAppliedFilterChainParams_) {
+        if (!params.pattern.isEmpty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Brings the mapping up to date with source rows appended after the last evaluated one.
+// Only those rows are matched against the applied chain, never the whole file.
+void EfficientLogFilterProxyModel::filterAppendedRows()
+{
+    if (!sourceModel_ || isFiltering_ || tailWatcher_.isRunning()) {
+        return; // Picked up again when the running filter or tail evaluation completes
+    }
+    const int first = currentSourceMatches_.size();
+    const int last = sourceModel_->rowCount() - 1;
+    if (last < first) {
+        return;
+    }
+
+    if (showsAllRows()) {
+        // Nothing to evaluate, the new rows are simply shown
+        QVector<int> rows;
+        rows.reserve(last - first + 1);
+        for (int sourceRow = first; sourceRow <= last; ++sourceRow) {
+            rows.append(sourceRow);
+        }
+        appendMatches(last + 1, rows);
+        return;
+    }
+
+    std::shared_ptr<const MappedFile> file = sourceLogfile_ ? sourceLogfile_->getMappedFile() : nullptr;
+    std::shared_ptr<const LineIndex> lineIndex = sourceLogfile_ ? sourceLogfile_->getLineIndex() : nullptr;
+    if (!file || !lineIndex || lineIndex->size() <= last) {
+        qWarning("EfficientLogFilterProxyModel: appended rows are not indexed, leaving them hidden.");
+        currentSourceMatches_.resize(last + 1);
+        return;
+    }
+
+    auto plan = std::make_shared<const FilterPlan>(lastAppliedFilterChainParams_);
+    tailCancel_ = CancellationToken();
+    const CancellationToken cancel = tailCancel_;
+    tailFirst_ = first;
+    tailLast_ = last;
+    tailGeneration_ = filterGeneration_;
+    auto scanTail = [file, lineIndex, plan, first, last, cancel]() {
+        // Only cancelled once the result is stale, so a partial one is never used
+        QVector<int> matches;
+        plan->scan(*file, *lineIndex, first, last + 1, cancel,
+                   [&matches](qint64 row) { matches.append(static_cast<int>(row)); });
+        return matches;
+    };
+    tailWatcher_.setFuture(TaskScheduler::instance().run(filterClass_, cancel, scanTail));
+}
+
+void EfficientLogFilterProxyModel::handleTailFilterFinished()
+{
+    const QVector<int> matches = tailWatcher_.result();
+    // Discard results computed for a chain (or a source) that's no longer shown
+    if (tailGeneration_ == filterGeneration_ && !isFiltering_ && tailFirst_ == currentSourceMatches_.size()) {
+        appendMatches(tailLast_ + 1, matches);
+    }
+    filterAppendedRows(); // More rows may have arrived meanwhile
+}
+
+// Extends the evaluated range to sourceRowCount rows; matchingRows (ascending, all new) are
+// appended to the mapping with a single rowsInserted
+void EfficientLogFilterProxyModel::appendMatches(int sourceRowCount, const QVector<int>& matchingRows)
+{
+    if (matchingRows.isEmpty()) {
+        currentSourceMatches_.resize(sourceRowCount); // New rows are left unmatched
+        return;
+    }
+
+    const int firstProxyRow = currentSourceMatches_.count();
+    beginInsertRows(QModelIndex(), firstProxyRow, firstProxyRow + matchingRows.size() - 1);
+    currentSourceMatches_.appendBits(sourceRowCount, matchingRows.constData(), matchingRows.size());
+    endInsertRows();
 }
@@ -3,64 +3,92 @@
 
 #include <QAbstractProxyModel>
 #include <QFutureWatcher>
-#include <QBitArray>
 #include <QVector>
-#include <QRunnable> // For QRunnable
-#include <QThreadPool> // For QThreadPool
-#include <QMutex> // For potential result synchronization (if needed)
+#include <QFuture>
 #include <QList>
 #include <QRegularExpression>
 #include <QString>
+#include <QElapsedTimer>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "CancellationToken.hpp"
+#include "CompletionLatch.hpp"
 #include "FilterParams.hpp" // Added include
+#include "MatchSet.hpp"
+#include "RankSelectBitset.hpp"
+#include "TaskScheduler.hpp"
+#include "WorkStealingScheduler.hpp"
 
 // Forward declarations
 class Logfile;
 class GrepNode;
+class FilterPlan;
+class LineIndex;
+class MappedFile;
 
 // FilterParams struct is now defined in FilterParams.hpp
 
 
-// --- Helper Runnable for Parallel Filtering ---
+// --- Helper Task for Parallel Filtering ---
 // Note: Making this internal to the .cpp might be cleaner, but for simplicity let's put it here.
-class FilterChunkTask : public QRunnable
+// One per worker thread: scans the chunks the scheduler hands it until there are none left.
+// Runs as a TaskScheduler task, giving way to more urgent work between slices.
+class FilterChunkTask
 {
 public:
     // Constructor takes necessary data (pointers or copies)
     FilterChunkTask(
-        int taskId, // For debugging/identification
-        const QVector<int>& rowsToProcessChunk, // Pass chunk by const reference
-        const QString* filename,
-        const QVector<qint64>& lineIndex, // Pass line index by const reference
-        const QList<FilterParams>* filterChainParams, // Changed from single FilterParams*
-        QBitArray* outputBitArray, // Pointer to the shared output array
-        QMutex* outputMutex, // Mutex to protect access to outputBitArray
-        std::atomic<int>* tasksRemaining // Pointer to the atomic counter
-    ) : QRunnable(),
-        taskId_(taskId),
-        rowsToProcessChunk_(rowsToProcessChunk), // Copy the vector
-        filename_(filename),
-        lineIndex_(lineIndex), // Copy the vector
-        filterChainParams_(filterChainParams), // Store the list
-        outputBitArray_(outputBitArray),
-        outputMutex_(outputMutex), // Add missing comma here
-        tasksRemaining_(tasksRemaining) // Store the counter pointer
+        int workerId, // Worker in the scheduler, also for debugging/identification
+        std::shared_ptr<WorkStealingScheduler> scheduler, // Hands out the chunks, keeps the worker's stats
+        const int* chunkStarts, // Chunk i is rows [chunkStarts[i], chunkStarts[i + 1]), starts multiples of 64
+        std::shared_ptr<const MappedFile> file, // Shared mapping, read without locking
+        std::shared_ptr<const LineIndex> lineIndex, // Shared line index, no copy
+        std::shared_ptr<const FilterPlan> plan, // Compiled chain; the proxy may queue another one meanwhile
+        std::shared_ptr<const std::vector<quint64>> candidates, // Rows to test (bitset like the output), nullptr for all
+        quint64* outputWords, // Shared result bitset, 64 rows per word
+        std::atomic<int>* progress, // Per chunk: its rows before it are final in outputWords; starts at the chunk's first row
+        std::function<void()> onProgress, // Called (on the task's thread) after a chunk's progress moved
+        CompletionLatch done, // Counted down once the worker is out of chunks, whatever the outcome
+        std::function<void()> onDone, // Called (on the task's thread) by the last worker counting down
+        const CancellationToken& cancel // Checked every few thousand lines
+    ) : workerId_(workerId),
+        scheduler_(std::move(scheduler)),
+        chunkStarts_(chunkStarts),
+        file_(std::move(file)),
+        lineIndex_(std::move(lineIndex)),
+        plan_(std::move(plan)),
+        candidates_(std::move(candidates)),
+        outputWords_(outputWords),
+        progress_(progress),
+        onProgress_(std::move(onProgress)),
+        done_(std::move(done)),
+        onDone_(std::move(onDone)),
+        cancel_(cancel)
     {
-        setAutoDelete(true); // Auto-delete after run() finishes
     }
 
-    void run() override; // Implementation will be in the .cpp
+    void run(); // Implementation will be in the .cpp
 
 private:
-    int taskId_;
-    QVector<int> rowsToProcessChunk_; // Store chunk by value (copy)
-    const QString* filename_;
-    QVector<qint64> lineIndex_; // Store line index by value (copy)
-    const QList<FilterParams>* filterChainParams_; // Changed type
-    QBitArray* outputBitArray_;
-    QMutex* outputMutex_;
-    std::atomic<int>* tasksRemaining_; // Added member
+    bool scanChunk(int chunk); // False if cancelled or unreadable
+    void finish(); // Counts down the latch, reports completion if last
+
+    int workerId_;
+    std::shared_ptr<WorkStealingScheduler> scheduler_;
+    const int* chunkStarts_;
+    std::shared_ptr<const MappedFile> file_;
+    std::shared_ptr<const LineIndex> lineIndex_;
+    std::shared_ptr<const FilterPlan> plan_;
+    std::shared_ptr<const std::vector<quint64>> candidates_;
+    quint64* outputWords_;
+    std::atomic<int>* progress_;
+    std::function<void()> onProgress_;
+    CompletionLatch done_;
+    std::function<void()> onDone_;
+    CancellationToken cancel_;
 };
-// --- End Helper Runnable ---
+// --- End Helper Task ---
 
 
 class EfficientLogFilterProxyModel : public QAbstractProxyModel
@@ -69,7 +97,7 @@ class EfficientLogFilterProxyModel : public QAbstractProxyModel
 
 public:
     explicit EfficientLogFilterProxyModel(QObject* parent = nullptr);
-    ~EfficientLogFilterProxyModel() override = default;
+    ~EfficientLogFilterProxyModel() override; // Stops and waits for running filter tasks
 
     // --- QAbstractProxyModel overrides ---
     QModelIndex mapToSource(const QModelIndex& proxyIndex) const override;
@@ -88,39 +116,103 @@ public:
     bool isFiltering() const;
     void cancelFiltering();
 
+    // How long the last filter took to show its first matches and to complete
+    struct FilterLatency
+    {
+        qint64 firstResultsMs = -1; // -1 if nothing was shown before completion
+        qint64 totalMs = -1;        // -1 until a filter completed
+        bool fromCache = false;     // Applied from a cached match set, no scan
+    };
+    FilterLatency lastFilterLatency() const;
+
+    // Worker threads filtering uses; 0 (the default) for one per TaskScheduler thread
+    void setFilterThreadCount(int threadCount);
+    int filterThreadCount() const; // The count actually used
+    QVector<WorkStealingScheduler::WorkerStats> lastFilterWorkerStats() const; // Per worker, of the last completed scan
+
+    // Filters of the tab on screen run ahead of indexing, those of background tabs after it.
+    // Applies to the filters started from then on.
+    void setForeground(bool foreground);
+
 signals:
     void filteringStarted();
-    void filteringFinished(int matchCount); // Signal with the number of matches
+    void filteringProgress(int matchCount); // Matches shown so far while filtering
+    void filteringFinished(int matchCount); // Signal with the number of matches; lastFilterLatency() is up to date
 
 private slots:
-    // void handleFilterFinished(); // REMOVED - No longer connected to QFutureWatcher
     void sourceModelReset(); // Slot to handle source model reset
+    void sourceRowsInserted(const QModelIndex& parent, int first, int last); // Rows appended while indexing/following
+    void sourceRowsRemoved(const QModelIndex& parent, int first, int last); // Trailing rows rewritten on disk
+    void handleTailFilterFinished();
     void handleParallelFilterCompletion(bool wasCancelled); // Slot for parallel completion
+    void handleFilterTasksFinished(); // Queued by the last filter task
+    void publishFilterProgress(); // Queued by filter tasks: shows the matches in the rows they finished
 
 private:
     // --- Filtering Implementation ---
     void startAsyncFiltering();
-    // static QBitArray performFilteringTask(...) // REMOVED - Dead code
-    void updateMapping(const QBitArray& newMatches); // The core logic for smart updates
+    void updateMapping(RankSelectBitset newMatches); // Replaces the shown matches (model reset)
+    bool showsAllRows() const; // True if the applied chain has no pattern to check
+    void filterAppendedRows(); // Evaluates only source rows appended since the last evaluation
+    void appendMatches(int sourceRowCount, const QVector<int>& matchingRows);
+    void publishFilterMatches(int endRow); // Appends the running filter's matches up to endRow
+
+    // Match sets of completed chains, least recently used first and bounded in total size.
+    // Coming back to a chain applies its set at once; a chain extending a cached one
+    // (drilling down the grep tree) only tests the rows its cached prefix matched.
+    struct CachedMatchSet
+    {
+        QList<FilterParams> steps; // The chain's steps with a pattern
+        quint64 sourceVersion = 0; // sourceVersion_ the set was computed for
+        MatchSet matches; // Valid for its leading rows() source rows
+    };
+    CachedMatchSet* useCachedPrefix(const QList<FilterParams>& steps); // Longest, made most recent, or nullptr
+    void cacheMatchSet(const QList<FilterParams>& steps, quint64 sourceVersion, MatchSet matches);
 
     // --- Member Variables ---
     Logfile* sourceLogfile_ = nullptr; // Pointer to the source logfile data
     QAbstractItemModel* sourceModel_ = nullptr; // Pointer to the source LogfileModel
 
-    QFutureWatcher<QBitArray> filterWatcher_; // May become redundant or repurposed
-    QThreadPool threadPool_; // Use a member pool or QThreadPool::globalInstance()
-    QMutex resultMutex_; // Mutex for shared result array
-    std::atomic<int> tasksRemaining_; // Counter for running tasks
-    QBitArray parallelFilterResult_; // Shared result array
+    QVector<QFuture<void>> filterTasks_; // Of the running filter, waited for on destruction
+    TaskClass filterClass_ = TaskClass::ActiveFilter; // See setForeground()
+    std::atomic<bool> filterProgressQueued_ {false}; // A publishFilterProgress() call is pending
+    QElapsedTimer filterClock_; // Started with the running filter
+    FilterLatency runningFilterLatency_;
+    FilterLatency lastFilterLatency_;
+    int filterThreadCount_ = 0; // See setFilterThreadCount()
+    std::shared_ptr<WorkStealingScheduler> filterScheduler_; // Of the running filter
+    QVector<WorkStealingScheduler::WorkerStats> lastFilterWorkerStats_;
+    std::vector<quint64> parallelFilterWords_; // Shared result bitset; every word is written by one chunk only
+    QVector<int> parallelFilterRanges_; // Chunk i is rows [ranges[i], ranges[i + 1])
+    std::unique_ptr<std::atomic<int>[]> parallelFilterProgress_; // Per chunk, see FilterChunkTask
+    int publishedFilterChunks_ = 0; // Leading chunks whose matches are all shown
+    RankSelectBitset previousSourceMatches_; // Shown before the running filter, restored if it's cancelled
+    int parallelFilterValidRows_ = 0; // Leading rows of the result still present in the source
 
     bool isFiltering_ = false;
+    CancellationToken filterCancel_; // Cancels the running filter
 
+    QList<FilterParams> runningFilterChainParams_; // Parameters the running tasks evaluate
     QList<FilterParams> currentFilterChainParams_; // Parameters for the filter currently running or queued
     QList<FilterParams> lastAppliedFilterChainParams_; // Parameters for the filter whose results are currently displayed
 
-    QBitArray currentSourceMatches_; // Bitmask representing matches in the *source* model for the *last applied* filter
-    QVector<int> proxyToSourceMap_; // Maps proxy row index -> source row index (Restored)
-    QHash<int, int> sourceToProxyMap_; // Maps source row index -> proxy row index (Restored)
+    // Bitmask representing matches in the *source* model for the *last applied* filter, and the
+    // mapping itself: proxy row n is select(n), source row r is proxy row rank(r)
+    RankSelectBitset currentSourceMatches_;
+
+    // Incremental filtering of appended rows
+    QFutureWatcher<QVector<int>> tailWatcher_; // Matching rows of [tailFirst_, tailLast_]
+    int tailFirst_ = 0;
+    int tailLast_ = -1;
+    quint64 tailGeneration_ = 0;
+    CancellationToken tailCancel_;
+    CancellationToken lifetimeCancel_; // Cancelled on destruction only, drops filter tasks not started yet
+    quint64 filterGeneration_ = 0; // Bumped whenever the applied chain or the source is replaced
+
+    quint64 sourceVersion_ = 0; // Bumped whenever the source rows are replaced (new file, reset)
+    quint64 runningSourceVersion_ = 0; // sourceVersion_ when the running filter started
+    std::vector<CachedMatchSet> matchSetCache_; // Least recently used first
+    qint64 matchSetCacheBytes_ = 0; // Sum of the cached sets' byteSize()
 
 };
 
@@ -163,7 +163,8 @@ void FileViewer::addGrepFilter(const GrepDialogWindow::Result& result)
     GrepNode* newNode = new GrepNode(result.pattern.toStdString(),
                                      result.is_regex,
                                      result.is_case_insensitive,
-                                     result.is_inverted);
+                                     result.is_inverted,
+                                     result.is_query);
 
     // Add the new node via the GrepModel
     grep_model_->addGrepNode(parentNode, newNode);
@@ -12,6 +12,7 @@ struct FilterParams {
     Qt::CaseSensitivity cs = Qt::CaseSensitive;
     bool inverted = false;
     QRegularExpression regex; // Pre-compiled regex if isRegex is true
+    bool isQuery = false; // pattern is a boolean expression of terms, see FilterQuery
 
     // Need an equality operator for comparing chains
     friend bool operator==(const FilterParams& lhs, const FilterParams& rhs);
@@ -22,6 +23,7 @@ struct FilterParams {
 inline bool operator==(const FilterParams& lhs, const FilterParams& rhs) {
     return lhs.pattern == rhs.pattern &&
            lhs.isRegex == rhs.isRegex &&
+           lhs.isQuery == rhs.isQuery &&
            lhs.cs == rhs.cs &&
            lhs.inverted == rhs.inverted &&
            // Explicitly compare relevant QRegularExpression properties if needed
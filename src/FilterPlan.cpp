@@ -0,0 +1,473 @@
+#include "FilterPlan.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <QDebug>
+#include <QString>
+#include <QtAlgorithms>
+
+#include "LineIndex.hpp"
+#include "MappedFile.hpp"
+#include "simd/NewlineScanner.hpp"
+
+namespace
+{
+
+const qint64 kScanBlockSize = 4 * 1024 * 1024; // Read size when the file isn't mapped
+const int kCancelCheckLines = 1024;            // Lines matched between cancellation checks
+const qint64 kAnchorWindow = 1024 * 1024;      // Bytes searched for the anchor at once
+const int kMaxAutomatonLiterals = 64;          // Literals reported by AhoCorasick::findMask
+const int kMinPrefilterLength = 2;             // Shorter required literals reject too few lines
+
+bool isAsciiSpace(char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+}  // namespace
+
+FilterPlan::FilterPlan(const QList<FilterParams>& chain)
+{
+    nodes_.emplace_back(); // The root, ANDing the chain
+    root_ = 0;
+    for (const FilterParams& params : chain) {
+        if (params.pattern.isEmpty()) {
+            continue; // An empty step lets everything through
+        }
+        int node = -1;
+        if (params.isQuery) {
+            const FilterQuery query(params.pattern, params.cs);
+            if (!query.isValid()) {
+                // Queries are checked before they're applied; this one can't decide anything
+                qWarning() << "Filter query" << params.pattern << "is ignored:" << query.errorString();
+                continue;
+            }
+            node = addQueryNode(query, query.root());
+            if (params.inverted) {
+                Node inverted;
+                inverted.op = FilterQuery::Op::Not;
+                inverted.operands.push_back(node);
+                nodes_.push_back(std::move(inverted));
+                node = static_cast<int>(nodes_.size()) - 1;
+            }
+        } else {
+            node = addStep(params);
+        }
+        if (nodes_[node].op == FilterQuery::Op::And) {
+            const std::vector<int> operands = nodes_[node].operands; // The query's ANDs are the chain's
+            nodes_[root_].operands.insert(nodes_[root_].operands.end(), operands.begin(), operands.end());
+        } else {
+            nodes_[root_].operands.push_back(node);
+        }
+    }
+
+    // One literal is fastest with its SIMD search; from two on, a single automaton pass per
+    // line beats one search per literal. It finds the literals of all leaves at once, also
+    // those a short-circuit ends up not asking for.
+    int literalCount = 0;
+    for (const Step& step : steps_) {
+        literalCount += step.bytewise ? 1 : 0;
+    }
+    if (literalCount >= 2 && literalCount <= kMaxAutomatonLiterals) {
+        for (Step& step : steps_) {
+            if (step.bytewise) {
+                step.literalId = literals_.addPattern(step.params.pattern.toUtf8(),
+                                                      step.params.cs == Qt::CaseInsensitive);
+            }
+        }
+        literals_.build();
+    }
+
+    orderOperands(root_);
+    findAnchor(root_);
+}
+
+// Adds a leaf for a literal or regex, returns its node
+int FilterPlan::addStep(const FilterParams& params)
+{
+    Step step;
+    step.params = params;
+    // A literal is contained in the text iff its UTF-8 bytes are. Case-insensitively that
+    // only holds for ASCII patterns, whose letters fold bytewise; anything else goes
+    // through QString's Unicode case folding.
+    const QByteArray needle = params.pattern.toUtf8();
+    const bool caseInsensitive = params.cs == Qt::CaseInsensitive;
+    step.bytewise = !params.isRegex && (!caseInsensitive || simd::LiteralMatcher::isAscii(needle));
+    if (step.bytewise) {
+        step.matcher = simd::LiteralMatcher(needle, caseInsensitive);
+    }
+    if (params.isRegex && (params.regex.patternOptions() & ~QRegularExpression::CaseInsensitiveOption) == 0) {
+        step.dfa = ByteRegex(params.pattern, caseInsensitive);
+        if (!step.dfa.isValid()) {
+            qDebug() << "Filter regex" << params.pattern << "runs on QRegularExpression:" << step.dfa.errorString();
+        }
+        // Most log regexes contain fixed text ("timeout after \d+ms"); a line without it
+        // is rejected by a SIMD search instead of the regex engine
+        const QByteArray required = ByteRegex::requiredLiteral(params.pattern, caseInsensitive);
+        if (required.size() >= kMinPrefilterLength) {
+            step.prefilter = simd::LiteralMatcher(required, caseInsensitive);
+        }
+    }
+    steps_.push_back(std::move(step));
+
+    Node node;
+    node.op = FilterQuery::Op::Term;
+    node.step = static_cast<int>(steps_.size()) - 1;
+    nodes_.push_back(std::move(node));
+    return static_cast<int>(nodes_.size()) - 1;
+}
+
+// Copies the query's node at index and everything below it, returns the copy
+int FilterPlan::addQueryNode(const FilterQuery& query, int index)
+{
+    const FilterQuery::Node& source = query.nodes()[index];
+    if (source.op == FilterQuery::Op::Term) {
+        return addStep(source.term);
+    }
+    Node node;
+    node.op = source.op;
+    for (int operand : source.operands) {
+        node.operands.push_back(addQueryNode(query, operand));
+    }
+    nodes_.push_back(std::move(node));
+    return static_cast<int>(nodes_.size()) - 1;
+}
+
+int FilterPlan::stepCost(const Step& step) const
+{
+    if (step.literalId >= 0) {
+        return 1; // Looked up in the automaton's result, searched once for all of them
+    }
+    if (step.bytewise) {
+        return 2;
+    }
+    if (!step.prefilter.needle().isEmpty()) {
+        return step.dfa.isValid() ? 3 : 4; // Mostly rejected by the literal search
+    }
+    return step.dfa.isValid() ? 4 : 8; // Decoding the line and QString/PCRE matching
+}
+
+// Operands that are cheap to evaluate go first: they decide most lines before an expensive
+// one is needed. Evaluation has no side effects, so the order doesn't change results.
+void FilterPlan::orderOperands(int index)
+{
+    Node& node = nodes_[index];
+    if (node.op == FilterQuery::Op::Term) {
+        node.cost = stepCost(steps_[node.step]);
+        return;
+    }
+    int cost = 0;
+    for (int operand : node.operands) {
+        orderOperands(operand);
+        cost += nodes_[operand].cost;
+    }
+    node.cost = cost; // What it costs when no short-circuit helps
+    std::stable_sort(node.operands.begin(), node.operands.end(),
+                     [this](int a, int b) { return nodes_[a].cost < nodes_[b].cost; });
+}
+
+// A literal that must occur in every line passing the expression can anchor the scan: the
+// literals of positive leaves that are reached through ANDs only. Longer needles have fewer
+// false candidates and let the search skip more.
+void FilterPlan::findAnchor(int index)
+{
+    const Node& node = nodes_[index];
+    if (node.op == FilterQuery::Op::And) {
+        for (int operand : node.operands) {
+            findAnchor(operand);
+        }
+        return;
+    }
+    if (node.op != FilterQuery::Op::Term) {
+        return; // A line passing an OR or NOT needn't contain any particular literal
+    }
+    const Step& step = steps_[node.step];
+    const simd::LiteralMatcher& literal = step.bytewise ? step.matcher : step.prefilter;
+    const bool usable = !step.params.inverted && !literal.needle().isEmpty() && !literal.needle().contains('\n');
+    if (usable && (!anchored_ || literal.needle().size() > anchor_.needle().size())) {
+        anchor_ = literal;
+        anchored_ = true;
+    }
+}
+
+bool FilterPlan::acceptsAll() const
+{
+    return steps_.empty();
+}
+
+bool FilterPlan::matches(const char* line, qint64 length) const
+{
+    // Lines are matched trimmed, as they are displayed
+    while (length > 0 && isAsciiSpace(line[0])) {
+        ++line;
+        --length;
+    }
+    while (length > 0 && isAsciiSpace(line[length - 1])) {
+        --length;
+    }
+
+    LineState state;
+    state.line = line;
+    state.length = length;
+    // QString::trimmed() also strips non-ASCII spaces (U+00A0, U+3000...). When the line
+    // might have one at either end, byte and text matching could see different lines, and an
+    // anchored regex could tell; the DFA is skipped for those rare lines.
+    state.unicodeEdges = length > 0 && (static_cast<uchar>(line[0]) >= 0x80
+                                        || static_cast<uchar>(line[length - 1]) >= 0x80);
+    return evaluate(root_, state);
+}
+
+bool FilterPlan::evaluate(int index, LineState& state) const
+{
+    const Node& node = nodes_[index];
+    switch (node.op) {
+    case FilterQuery::Op::Term:
+        return evaluateStep(steps_[node.step], state);
+    case FilterQuery::Op::Not:
+        return !evaluate(node.operands.front(), state);
+    case FilterQuery::Op::And:
+        for (int operand : node.operands) {
+            if (!evaluate(operand, state)) {
+                return false; // Line failed one step, it doesn't match the full chain
+            }
+        }
+        return true;
+    case FilterQuery::Op::Or:
+        for (int operand : node.operands) {
+            if (evaluate(operand, state)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    return false;
+}
+
+// Invalid bytes are decoded as U+FFFD, which '.' and negated classes match but the DFA
+// doesn't see: such lines (mixed encodings, Latin-1) take the QRegularExpression path
+bool FilterPlan::isValidUtf8(LineState& state)
+{
+    if (!state.checkedUtf8) {
+        state.validUtf8 = ByteRegex::isValidUtf8(state.line, state.length);
+        state.checkedUtf8 = true;
+    }
+    return state.validUtf8;
+}
+
+bool FilterPlan::evaluateStep(const Step& step, LineState& state) const
+{
+    bool found = false;
+    if (step.literalId >= 0) {
+        if (!state.searchedLiterals) {
+            state.literalsFound = literals_.findMask(state.line, state.length);
+            state.searchedLiterals = true;
+        }
+        found = (state.literalsFound >> step.literalId) & 1;
+    } else if (step.bytewise) {
+        found = step.matcher.indexIn(state.line, state.length) >= 0;
+    } else if (!step.prefilter.needle().isEmpty() && step.prefilter.indexIn(state.line, state.length) < 0) {
+        found = false; // Without its required literal the regex can't match
+    } else if (step.dfa.isValid() && !state.unicodeEdges && isValidUtf8(state)) {
+        found = step.dfa.matches(state.line, state.length);
+    } else {
+        if (!state.decoded) {
+            state.text = QString::fromUtf8(state.line, static_cast<int>(state.length)).trimmed();
+            state.decoded = true;
+        }
+        found = step.params.isRegex ? step.params.regex.match(state.text).hasMatch()
+                                    : state.text.contains(step.params.pattern, step.params.cs);
+    }
+    return step.params.inverted ? !found : found;
+}
+
+// A line without the anchor literal can't pass the chain. Rather than splitting and testing
+// every line, search ahead for the anchor and step over all complete lines before the hit,
+// only counting them. Lines are matched trimmed but searched here untrimmed, which can only
+// keep a line, never drop one that matches.
+void FilterPlan::skipToAnchor(const char* data, qint64 length, qint64& pos, qint64& row, qint64 endRow) const
+{
+    const qint64 windowEnd = qMin(length, pos + kAnchorWindow);
+    const qint64 hit = anchor_.indexIn(data + pos, windowEnd - pos);
+
+    // No line ending before clear contains the anchor. Without a hit in the window, an
+    // occurrence could still start in its last needle size - 1 bytes and continue after it.
+    qint64 clear = length;
+    if (hit >= 0) {
+        clear = pos + hit;
+    } else if (windowEnd < length) {
+        clear = windowEnd - anchor_.needle().size() + 1;
+    }
+
+    qint64 lastNewline = clear - 1;
+    while (lastNewline >= pos && data[lastNewline] != '\n') {
+        --lastNewline;
+    }
+    if (lastNewline < pos) {
+        return; // The line at pos reaches clear, it has to be tested
+    }
+    const qint64 skipped = simd::NewlineScanner::count(data + pos, lastNewline + 1 - pos);
+    if (skipped >= endRow - row) {
+        // Range ends in the skipped part; past endRow the bytes belong to other rows
+        pos = length;
+        row = endRow;
+        return;
+    }
+    row += skipped;
+    pos = lastNewline + 1;
+}
+
+// Matches the complete lines in data, starting with row. The part after the last '\n' is a
+// line of its own only at the end of the range; otherwise it's left for the next block.
+bool FilterPlan::scanLines(const char* data, qint64 length, bool atEnd, qint64& row, qint64 endRow,
+                           const CancellationToken& cancel, const std::function<void(qint64)>& onMatch,
+                           qint64* consumed) const
+{
+    qint64 pos = 0;
+    int sinceCheck = 0;
+    while (pos < length && row < endRow) {
+        if (anchored_) {
+            skipToAnchor(data, length, pos, row, endRow);
+            if (pos >= length || row >= endRow) {
+                break;
+            }
+        }
+
+        const char* lineStart = data + pos;
+        const void* newline = std::memchr(lineStart, '\n', static_cast<size_t>(length - pos));
+        if (!newline && !atEnd) {
+            break;
+        }
+        const qint64 lineLength = newline ? static_cast<const char*>(newline) - lineStart : length - pos;
+
+        // A skip may have covered a whole window, so anchored scans check every time
+        if (anchored_ || ++sinceCheck == kCancelCheckLines) {
+            sinceCheck = 0;
+            if (cancel.isCancelled()) {
+                *consumed = pos;
+                return false;
+            }
+        }
+        if (matches(lineStart, lineLength)) {
+            onMatch(row);
+        }
+        ++row;
+        pos += lineLength + (newline ? 1 : 0);
+    }
+    *consumed = pos;
+    return true;
+}
+
+bool FilterPlan::scan(const MappedFile& file, const LineIndex& lineIndex, qint64 firstRow, qint64 endRow,
+                      const CancellationToken& cancel, const std::function<void(qint64)>& onMatch) const
+{
+    if (firstRow >= endRow) {
+        return true;
+    }
+    if (acceptsAll()) {
+        for (qint64 row = firstRow; row < endRow; ++row) {
+            onMatch(row);
+        }
+        return true;
+    }
+
+    // Rows are split at '\n' just like the index was built, so only the range's bounds are
+    // looked up; the rows in between are found while streaming
+    const qint64 end = lineIndex.lineEnd(endRow - 1, file.size());
+    const qint64 begin = qMin(lineIndex.at(firstRow), end); // Both within file, see lineEnd()
+    qint64 row = firstRow;
+    qint64 consumed = 0;
+
+    if (file.isMapped()) {
+        file.advise(begin, end, MappedFile::Access::Sequential);
+        const bool complete = scanLines(file.data() + begin, end - begin, true, row, endRow, cancel, onMatch,
+                                        &consumed);
+        file.advise(begin, end, MappedFile::Access::Random); // Back to viewport access
+        return complete;
+    }
+
+    // Not mapped: few large reads, an incomplete line is carried over to the next block
+    QByteArray pending;
+    for (qint64 pos = begin; pos < end;) {
+        const qint64 blockEnd = qMin(pos + kScanBlockSize, end);
+        const QByteArray block = file.bytes(pos, blockEnd);
+        if (block.size() != blockEnd - pos) {
+            qWarning("Filtering: failed to read %s at offset %lld", qPrintable(file.fileName()), pos);
+            return false;
+        }
+        pos = blockEnd;
+        pending.append(block);
+        if (!scanLines(pending.constData(), pending.size(), pos == end, row, endRow, cancel, onMatch, &consumed)) {
+            return false;
+        }
+        pending.remove(0, static_cast<int>(consumed));
+    }
+    return true;
+}
+
+bool FilterPlan::scanCandidates(const MappedFile& file, const LineIndex& lineIndex, const quint64* candidateWords,
+                                qint64 firstRow, qint64 endRow, const CancellationToken& cancel,
+                                const std::function<void(qint64)>& onMatch) const
+{
+    int sinceCheck = 0;
+    for (qint64 wordIndex = firstRow >> 6; (wordIndex << 6) < endRow; ++wordIndex) {
+        quint64 word = candidateWords[wordIndex];
+        if ((wordIndex << 6) < firstRow) {
+            word &= ~quint64(0) << (firstRow & 63);
+        }
+        for (; word; word &= word - 1) {
+            const qint64 row = (wordIndex << 6) + qCountTrailingZeroBits(word);
+            if (row >= endRow) {
+                break;
+            }
+            if (++sinceCheck == kCancelCheckLines) {
+                sinceCheck = 0;
+                if (cancel.isCancelled()) {
+                    return false;
+                }
+            }
+            if (acceptsAll()) {
+                onMatch(row);
+                continue;
+            }
+
+            const qint64 end = lineIndex.lineEnd(row, file.size()); // Includes the '\n'
+            const qint64 begin = qMin(lineIndex.at(row), end);
+            bool matched = false;
+            if (file.isMapped()) {
+                const char* line = file.data() + begin;
+                const qint64 length = end - begin;
+                matched = matches(line, length > 0 && line[length - 1] == '\n' ? length - 1 : length);
+            } else {
+                QByteArray line = file.bytes(begin, end);
+                if (line.size() != end - begin) {
+                    qWarning("Filtering: failed to read %s at offset %lld", qPrintable(file.fileName()), begin);
+                    return false;
+                }
+                if (line.endsWith('\n')) {
+                    line.chop(1);
+                }
+                matched = matches(line.constData(), line.size());
+            }
+            if (matched) {
+                onMatch(row);
+            }
+        }
+    }
+    return true;
+}
+
+qint64 FilterPlan::rowAtOffset(const LineIndex& lineIndex, qint64 rowCount, qint64 offset)
+{
+    qint64 low = 0;
+    qint64 high = rowCount;
+    while (low < high) {
+        const qint64 mid = low + (high - low) / 2;
+        if (lineIndex.at(mid) < offset) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
@@ -0,0 +1,123 @@
+#ifndef FILTER_PLAN_HPP
+#define FILTER_PLAN_HPP
+
+#include <functional>
+#include <vector>
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+#include "AhoCorasick.hpp"
+#include "ByteRegex.hpp"
+#include "CancellationToken.hpp"
+#include "FilterParams.hpp"
+#include "FilterQuery.hpp"
+#include "simd/LiteralMatcher.hpp"
+
+class LineIndex;
+class MappedFile;
+
+// A filter chain prepared for scanning: patterns are converted once, not per line, and
+// lines are matched on their raw bytes wherever the step allows it.
+//
+// scan() streams a contiguous run of rows: it walks the bytes of the range and finds line
+// boundaries itself, so the line index is consulted once per range instead of once per row,
+// and a line is only decoded to a QString when a step needs it (regex outside the ByteRegex
+// subset, non-ASCII case-insensitive literal). When the chain has a literal every matching line must contain,
+// the range is searched for that literal first and the lines in between are skipped
+// without being looked at individually. Regex steps get the same treatment through the
+// literal their matches require, which also rejects most lines before the regex runs. Several literal steps are found together, in one
+// pass of an Aho-Corasick automaton over the line.
+//
+// Query steps (see FilterQuery) are compiled into the same plan: the chain becomes one
+// boolean expression whose leaves are its literals and regexes. A line is evaluated once,
+// operands cheapest first, and AND/OR stop at the first operand that decides them; the
+// literals of all leaves still come from the single automaton pass, and the literals the
+// whole expression requires anchor the scan.
+class FilterPlan
+{
+public:
+    explicit FilterPlan(const QList<FilterParams>& chain);
+
+    // True if no step has a pattern, i.e. every line passes
+    bool acceptsAll() const;
+
+    // Tests one line; length excludes the line terminator
+    bool matches(const char* line, qint64 length) const;
+
+    // Calls onMatch(row) in ascending order for every row in [firstRow, endRow) that passes.
+    // Returns false if cancelled or the file can't be read; rows reported until then are valid.
+    bool scan(const MappedFile& file, const LineIndex& lineIndex, qint64 firstRow, qint64 endRow,
+              const CancellationToken& cancel, const std::function<void(qint64)>& onMatch) const;
+
+    // Like scan(), but only rows whose bit is set in candidateWords (bit row % 64 of word
+    // row / 64) are read and tested, each looked up in the line index on its own. For
+    // narrowing down an earlier result: a sparse set costs its rows, not the whole range.
+    bool scanCandidates(const MappedFile& file, const LineIndex& lineIndex, const quint64* candidateWords,
+                        qint64 firstRow, qint64 endRow, const CancellationToken& cancel,
+                        const std::function<void(qint64)>& onMatch) const;
+
+    // First row of a range starting at byte offset (or later), for splitting rows
+    // [0, rowCount) into runs of about equal size in bytes
+    static qint64 rowAtOffset(const LineIndex& lineIndex, qint64 rowCount, qint64 offset);
+
+private:
+    struct Step
+    {
+        FilterParams params;
+        bool bytewise = false;         // Literal matched on the UTF-8 bytes
+        simd::LiteralMatcher matcher;  // Used if bytewise
+        int literalId = -1;            // Pattern in literals_, if bytewise and there are several
+        ByteRegex dfa;                 // Regex matched on the UTF-8 bytes, if valid
+        simd::LiteralMatcher prefilter; // Literal every regex match contains, if not empty
+    };
+
+    // The chain as an expression: the root ANDs the steps, query steps add their own nodes
+    struct Node
+    {
+        FilterQuery::Op op = FilterQuery::Op::And;
+        int step = -1;             // Index into steps_, if Term
+        std::vector<int> operands; // Indexes into nodes_, in evaluation order
+        int cost = 0;              // Rough price of evaluating it, for ordering operands
+    };
+
+    // What the leaves of one line have found out so far, shared by all of them
+    struct LineState
+    {
+        const char* line;
+        qint64 length;
+        bool unicodeEdges;
+        QString text;
+        bool decoded = false;
+        quint64 literalsFound = 0;
+        bool searchedLiterals = false;
+        bool checkedUtf8 = false;
+        bool validUtf8 = false;
+    };
+
+    static bool isValidUtf8(LineState& state);
+    int addStep(const FilterParams& params);
+    int addQueryNode(const FilterQuery& query, int index);
+    int stepCost(const Step& step) const;
+    void orderOperands(int node);
+    void findAnchor(int node);
+    bool evaluate(int node, LineState& state) const;
+    bool evaluateStep(const Step& step, LineState& state) const;
+
+    // Jumps over the lines in [pos, length) before the next occurrence of the anchor literal
+    void skipToAnchor(const char* data, qint64 length, qint64& pos, qint64& row, qint64 endRow) const;
+
+    bool scanLines(const char* data, qint64 length, bool atEnd, qint64& row, qint64 endRow,
+                   const CancellationToken& cancel, const std::function<void(qint64)>& onMatch,
+                   qint64* consumed) const;
+
+    std::vector<Step> steps_; // The leaves: steps and query terms with a pattern
+    std::vector<Node> nodes_;
+    int root_ = -1;
+    bool anchored_ = false;
+    simd::LiteralMatcher anchor_; // Literal every matching line contains, if anchored_
+    AhoCorasick literals_;    // The bytewise steps' literals, when there are at least two
+};
+
+#endif // FILTER_PLAN_HPP
@@ -0,0 +1,390 @@
+#include "FilterQuery.hpp"
+
+#include <QRegularExpression>
+
+namespace
+{
+
+const int kMaxDepth = 100; // Nesting of groups and NOTs; plans evaluate the tree recursively
+
+bool endsWord(QChar c)
+{
+    return c.isSpace() || c == QLatin1Char('(') || c == QLatin1Char(')') || c == QLatin1Char('"');
+}
+
+// True if an && or || starts at pos; they end a word too ("ERROR&&FATAL" is two terms)
+bool isOperatorAt(const QString& text, int pos)
+{
+    const QChar c = text.at(pos);
+    return (c == QLatin1Char('&') || c == QLatin1Char('|')) && pos + 1 < text.size() && text.at(pos + 1) == c;
+}
+
+bool isKeyword(const QString& word, const char* keyword)
+{
+    return word.compare(QLatin1String(keyword), Qt::CaseInsensitive) == 0;
+}
+
+}  // namespace
+
+// Splits the text into tokens up front, then builds the tree by recursive descent with one
+// function per precedence level. The first error stops both.
+class FilterQuery::Parser
+{
+public:
+    Parser(const QString& text, Qt::CaseSensitivity cs, FilterQuery* query)
+        : text_(text), cs_(cs), query_(query)
+    {
+    }
+
+    int parse();
+
+private:
+    enum class Kind { End, Open, Close, And, Or, Not, Term };
+
+    struct Token
+    {
+        Kind kind = Kind::End;
+        int position = 0;
+        FilterParams term; // If Term
+    };
+
+    bool tokenize();
+    bool readQuoted(int& pos, QString* content);
+    bool readRegex(int& pos, FilterParams* term);
+    bool addTerm(FilterParams term, int position);
+
+    int parseOr(int depth);
+    int parseAnd(int depth);
+    int parseUnary(int depth);
+    int addGroup(Op op, const std::vector<int>& operands);
+    int addNot(int operand);
+
+    const Token& current() const { return tokens_[next_]; }
+    int fail(const QString& error, int position);
+
+    const QString& text_;
+    Qt::CaseSensitivity cs_;
+    FilterQuery* query_;
+    std::vector<Token> tokens_; // Always ends with an End token
+    size_t next_ = 0;
+    bool failed_ = false;
+};
+
+int FilterQuery::Parser::parse()
+{
+    if (!tokenize()) {
+        return -1;
+    }
+    if (current().kind == Kind::End) {
+        return fail(QStringLiteral("Empty query"), 0);
+    }
+    const int root = parseOr(0);
+    if (root < 0) {
+        return -1;
+    }
+    if (current().kind != Kind::End) {
+        // parseAnd() takes everything but a closing parenthesis
+        return fail(QStringLiteral("Unmatched ')'"), current().position);
+    }
+    return root;
+}
+
+bool FilterQuery::Parser::tokenize()
+{
+    int pos = 0;
+    while (pos < text_.size()) {
+        const QChar c = text_.at(pos);
+        if (c.isSpace()) {
+            ++pos;
+            continue;
+        }
+        Token token;
+        token.position = pos;
+        if (c == QLatin1Char('(') || c == QLatin1Char(')')) {
+            token.kind = c == QLatin1Char('(') ? Kind::Open : Kind::Close;
+            ++pos;
+        } else if (isOperatorAt(text_, pos)) {
+            token.kind = c == QLatin1Char('&') ? Kind::And : Kind::Or;
+            pos += 2;
+        } else if (c == QLatin1Char('!')) {
+            token.kind = Kind::Not;
+            ++pos;
+        } else if (c == QLatin1Char('"')) {
+            QString literal;
+            if (!readQuoted(pos, &literal)) {
+                return false;
+            }
+            FilterParams term;
+            term.pattern = literal;
+            term.cs = cs_;
+            if (!addTerm(term, token.position)) {
+                return false;
+            }
+            continue;
+        } else if (c == QLatin1Char('/')) {
+            FilterParams term;
+            if (!readRegex(pos, &term) || !addTerm(term, token.position)) {
+                return false;
+            }
+            continue;
+        } else {
+            const int begin = pos;
+            while (pos < text_.size() && !endsWord(text_.at(pos)) && !isOperatorAt(text_, pos)) {
+                ++pos;
+            }
+            const QString word = text_.mid(begin, pos - begin);
+            if (isKeyword(word, "AND")) {
+                token.kind = Kind::And;
+            } else if (isKeyword(word, "OR")) {
+                token.kind = Kind::Or;
+            } else if (isKeyword(word, "NOT")) {
+                token.kind = Kind::Not;
+            } else {
+                FilterParams term;
+                term.pattern = word;
+                term.cs = cs_;
+                if (!addTerm(term, begin)) {
+                    return false;
+                }
+                continue;
+            }
+        }
+        tokens_.push_back(token);
+    }
+    Token end;
+    end.position = text_.size();
+    tokens_.push_back(end);
+    return true;
+}
+
+// pos is at the opening quote; on success it's after the closing one
+bool FilterQuery::Parser::readQuoted(int& pos, QString* content)
+{
+    const int begin = pos++;
+    for (; pos < text_.size(); ++pos) {
+        const QChar c = text_.at(pos);
+        if (c == QLatin1Char('"')) {
+            ++pos;
+            return true;
+        }
+        if (c == QLatin1Char('\\') && pos + 1 < text_.size()
+            && (text_.at(pos + 1) == QLatin1Char('"') || text_.at(pos + 1) == QLatin1Char('\\'))) {
+            ++pos;
+        }
+        content->append(text_.at(pos));
+    }
+    fail(QStringLiteral("Unterminated quote"), begin);
+    return false;
+}
+
+// pos is at the opening slash; on success it's after the flags
+bool FilterQuery::Parser::readRegex(int& pos, FilterParams* term)
+{
+    const int begin = pos++;
+    QString pattern;
+    bool closed = false;
+    for (; pos < text_.size(); ++pos) {
+        const QChar c = text_.at(pos);
+        if (c == QLatin1Char('/')) {
+            closed = true;
+            ++pos;
+            break;
+        }
+        if (c == QLatin1Char('\\') && pos + 1 < text_.size()) {
+            // Only \/ is ours, every other escape belongs to the regex
+            if (text_.at(pos + 1) != QLatin1Char('/')) {
+                pattern.append(c);
+            }
+            ++pos;
+        }
+        pattern.append(text_.at(pos));
+    }
+    if (!closed) {
+        fail(QStringLiteral("Unterminated regular expression"), begin);
+        return false;
+    }
+
+    term->isRegex = true;
+    term->pattern = pattern;
+    term->cs = cs_;
+    for (; pos < text_.size() && text_.at(pos).isLetter(); ++pos) {
+        if (text_.at(pos) == QLatin1Char('i')) {
+            term->cs = Qt::CaseInsensitive;
+        } else if (text_.at(pos) == QLatin1Char('c')) {
+            term->cs = Qt::CaseSensitive;
+        } else {
+            fail(QStringLiteral("Unknown regular expression flag '%1'").arg(text_.at(pos)), pos);
+            return false;
+        }
+    }
+    term->regex.setPattern(pattern);
+    term->regex.setPatternOptions(term->cs == Qt::CaseInsensitive ? QRegularExpression::CaseInsensitiveOption
+                                                                   : QRegularExpression::NoPatternOption);
+    if (!term->regex.isValid()) {
+        fail(QStringLiteral("Invalid regular expression: %1").arg(term->regex.errorString()),
+             begin + 1 + term->regex.patternErrorOffset());
+        return false;
+    }
+    return true;
+}
+
+bool FilterQuery::Parser::addTerm(FilterParams term, int position)
+{
+    if (term.pattern.isEmpty()) {
+        fail(QStringLiteral("Empty term"), position); // It would match every line
+        return false;
+    }
+    Token token;
+    token.kind = Kind::Term;
+    token.position = position;
+    token.term = std::move(term);
+    tokens_.push_back(std::move(token));
+    return true;
+}
+
+int FilterQuery::Parser::parseOr(int depth)
+{
+    std::vector<int> operands{parseAnd(depth)};
+    while (operands.back() >= 0 && current().kind == Kind::Or) {
+        ++next_;
+        operands.push_back(parseAnd(depth));
+    }
+    return operands.back() < 0 ? -1 : addGroup(Op::Or, operands);
+}
+
+int FilterQuery::Parser::parseAnd(int depth)
+{
+    std::vector<int> operands{parseUnary(depth)};
+    while (operands.back() >= 0) {
+        const Kind kind = current().kind;
+        if (kind == Kind::And) {
+            ++next_;
+        } else if (kind != Kind::Term && kind != Kind::Open && kind != Kind::Not) {
+            break; // Terms next to each other are ANDed too
+        }
+        operands.push_back(parseUnary(depth));
+    }
+    return operands.back() < 0 ? -1 : addGroup(Op::And, operands);
+}
+
+int FilterQuery::Parser::parseUnary(int depth)
+{
+    const Token& token = current();
+    if (depth >= kMaxDepth) {
+        return fail(QStringLiteral("Query nested too deeply"), token.position);
+    }
+    switch (token.kind) {
+    case Kind::Term: {
+        Node node;
+        node.term = token.term;
+        query_->nodes_.push_back(std::move(node));
+        ++next_;
+        return static_cast<int>(query_->nodes_.size()) - 1;
+    }
+    case Kind::Not: {
+        ++next_;
+        const int operand = parseUnary(depth + 1);
+        return operand < 0 ? -1 : addNot(operand);
+    }
+    case Kind::Open: {
+        ++next_;
+        const int group = parseOr(depth + 1);
+        if (group < 0) {
+            return -1;
+        }
+        if (current().kind != Kind::Close) {
+            return fail(QStringLiteral("Missing ')'"), current().position);
+        }
+        ++next_;
+        return group;
+    }
+    case Kind::Close:
+        return fail(QStringLiteral("Expected a term before ')'"), token.position);
+    case Kind::And:
+    case Kind::Or:
+        return fail(QStringLiteral("Expected a term before %1").arg(QLatin1String(token.kind == Kind::And ? "AND" : "OR")),
+                    token.position);
+    case Kind::End:
+        break;
+    }
+    return fail(QStringLiteral("Expected a term at the end"), token.position);
+}
+
+int FilterQuery::Parser::addGroup(Op op, const std::vector<int>& operands)
+{
+    if (operands.size() == 1) {
+        return operands.front();
+    }
+    Node group;
+    group.op = op;
+    for (int operand : operands) {
+        // Groups of the same operator were parenthesized, their operands join this one
+        const Node& node = query_->nodes_[operand];
+        if (node.op == op) {
+            group.operands.insert(group.operands.end(), node.operands.begin(), node.operands.end());
+        } else {
+            group.operands.push_back(operand);
+        }
+    }
+    query_->nodes_.push_back(std::move(group));
+    return static_cast<int>(query_->nodes_.size()) - 1;
+}
+
+int FilterQuery::Parser::addNot(int operand)
+{
+    if (query_->nodes_[operand].op == Op::Not) {
+        return query_->nodes_[operand].operands.front();
+    }
+    Node node;
+    node.op = Op::Not;
+    node.operands.push_back(operand);
+    query_->nodes_.push_back(std::move(node));
+    return static_cast<int>(query_->nodes_.size()) - 1;
+}
+
+int FilterQuery::Parser::fail(const QString& error, int position)
+{
+    if (!failed_) {
+        failed_ = true;
+        query_->error_ = error;
+        query_->errorPosition_ = position;
+    }
+    return -1;
+}
+
+FilterQuery::FilterQuery(const QString& text, Qt::CaseSensitivity cs)
+{
+    Parser parser(text, cs, this);
+    root_ = parser.parse();
+    if (root_ >= 0) {
+        error_.clear();
+        errorPosition_ = -1;
+    } else {
+        nodes_.clear();
+    }
+}
+
+bool FilterQuery::isValid() const
+{
+    return root_ >= 0;
+}
+
+const QString& FilterQuery::errorString() const
+{
+    return error_;
+}
+
+int FilterQuery::errorPosition() const
+{
+    return errorPosition_;
+}
+
+const std::vector<FilterQuery::Node>& FilterQuery::nodes() const
+{
+    return nodes_;
+}
+
+int FilterQuery::root() const
+{
+    return root_;
+}
@@ -0,0 +1,62 @@
+#ifndef FILTER_QUERY_HPP
+#define FILTER_QUERY_HPP
+
+#include <vector>
+
+#include <QString>
+#include <QtCore/Qt> // For Qt::CaseSensitivity
+
+#include "FilterParams.hpp"
+
+// A boolean filter expression, as typed in the grep dialog's query mode:
+//
+//     ERROR AND (timeout OR "connection reset") NOT /retry \d+/i
+//
+// Terms are bare words or "quoted text" (\" and \\ escape inside quotes), both matched as
+// literals, and /regular expressions/ (\/ for a slash), optionally followed by i for a
+// case-insensitive or c for a case-sensitive match. Other terms use the case sensitivity
+// the query is parsed with. Terms combine with NOT (or !), AND (or &&, or nothing: terms
+// next to each other must all match) and OR (or ||), binding in that order; parentheses
+// group. Keywords are matched in any case; to look for the word itself, quote it ("and").
+// && and || also end the word before them, "ERROR&&FATAL" is two terms.
+//
+// The expression is kept as a tree in nodes(): same-operator groups are flattened
+// ("a AND (b AND c)" has one AND with three operands) and double negations dropped.
+class FilterQuery
+{
+public:
+    enum class Op
+    {
+        Term, // Line contains term
+        Not,  // Its only operand doesn't match
+        And,  // All operands match
+        Or    // Any operand matches
+    };
+
+    struct Node
+    {
+        Op op = Op::Term;
+        FilterParams term;         // If Term: a literal or regex, never inverted
+        std::vector<int> operands; // Indexes into nodes(), if not Term
+    };
+
+    FilterQuery() = default;
+    FilterQuery(const QString& text, Qt::CaseSensitivity cs);
+
+    bool isValid() const;
+    const QString& errorString() const; // Why the text doesn't parse, if invalid
+    int errorPosition() const;          // Offset in the text the error was found at, -1 if valid
+
+    const std::vector<Node>& nodes() const;
+    int root() const; // Index of the whole expression in nodes(), -1 if invalid
+
+private:
+    class Parser;
+
+    std::vector<Node> nodes_;
+    int root_ = -1;
+    QString error_ = QStringLiteral("Empty query");
+    int errorPosition_ = 0;
+};
+
+#endif // FILTER_QUERY_HPP
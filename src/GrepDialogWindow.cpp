@@ -4,6 +4,8 @@
 #include <QDebug>
 #include <QRegularExpression>
 
+#include "FilterQuery.hpp"
+
 GrepDialogWindow::GrepDialogWindow(QWidget *parent) :
     QDialog(parent),
     ui(new Ui::GrepDialogWindow)
@@ -23,6 +25,7 @@ GrepDialogWindow::Result GrepDialogWindow::getResult()
     result.is_regex = ui->regex_check->isChecked();
     result.is_case_insensitive = ui->case_insensitive_check->isChecked();
     result.is_inverted = ui->inverted_check->isChecked();
+    result.is_query = ui->query_check->isChecked();
     return result;
 }
 
@@ -47,8 +50,38 @@ void GrepDialogWindow::on_regex_check_clicked()
     }
 }
 
+void GrepDialogWindow::on_query_check_clicked()
+{
+    // A query marks its regexes with slashes, the whole pattern is never one
+    ui->regex_check->setEnabled(!ui->query_check->isChecked());
+    if (ui->query_check->isChecked())
+    {
+        ui->regex_check->setChecked(false);
+        ui->case_insensitive_check->setEnabled(true);
+        on_pattern_textEdited(ui->pattern->text());
+    }
+    else
+    {
+        QPalette pallete = ui->pattern->palette();
+        pallete.setColor(QPalette::Base, Qt::white);
+        ui->pattern->setPalette(pallete);
+        ui->pattern->setToolTip(QString());
+    }
+}
+
 void GrepDialogWindow::on_pattern_textEdited(const QString &arg1)
 {
+    if (ui->query_check->isChecked())
+    {
+        QPalette pallete = ui->pattern->palette();
+        const FilterQuery query(arg1, Qt::CaseSensitive);
+        if (query.isValid()) pallete.setColor(QPalette::Base, QColor(Qt::green).lighter());
+        else pallete.setColor(QPalette::Base, QColor(Qt::red).lighter());
+        ui->pattern->setPalette(pallete);
+        ui->pattern->setToolTip(query.isValid() ? QString()
+                                                : tr("Position %1: %2").arg(query.errorPosition() + 1)
+                                                                       .arg(query.errorString()));
+    }
     if (ui->regex_check->isChecked())
     {
         QPalette pallete = ui->pattern->palette();
@@ -21,6 +21,7 @@ public:
         bool is_regex{};
         bool is_case_insensitive{};
         bool is_inverted{};
+        bool is_query{}; // pattern is a FilterQuery expression
     };
 
     Result getResult();
@@ -28,6 +29,7 @@ public:
 private slots:
     void on_button_clicked();
     void on_regex_check_clicked();
+    void on_query_check_clicked();
     void on_pattern_textEdited(const QString &arg1);
 
 private:
@@ -170,7 +170,7 @@ QVariant GrepModel::data(const QModelIndex &index, int role) const
         else if (displayName.length() > 25) displayName = displayName.left(22) + "...";
 
         displayName += " (";
-        displayName += node->isRegEx() ? "R" : "r";
+        displayName += node->isQuery() ? "Q" : (node->isRegEx() ? "R" : "r");
         displayName += node->isCaseInsensitive() ? "C" : "c";
         displayName += node->isInverted() ? "I" : "i";
         displayName += ")";
@@ -13,11 +13,13 @@ GrepNode::GrepNode(
     const std::string& value,
     const bool& is_regex,
     const bool& is_case_insensitive,
-    const bool& is_inverted)
+    const bool& is_inverted,
+    const bool& is_query)
 : pattern_{value},
     is_regex_{is_regex},
     is_case_insensitive_{is_case_insensitive},
-    is_inverted_{is_inverted}
+    is_inverted_{is_inverted},
+    is_query_{is_query}
 {}
 
 GrepNode::~GrepNode()
@@ -56,6 +58,11 @@ bool GrepNode::isInverted() const
     return is_inverted_;
 }
 
+bool GrepNode::isQuery() const
+{
+    return is_query_;
+}
+
 // --- Setters ---
 void GrepNode::setPattern(const std::string& pattern) {
     if (pattern_ != pattern) {
@@ -85,6 +92,13 @@ void GrepNode::setIsInverted(bool isInverted) {
     }
 }
 
+void GrepNode::setIsQuery(bool isQuery) {
+    if (is_query_ != isQuery) {
+        is_query_ = isQuery;
+        emit changed();
+    }
+}
+
 // Corrected addChild
 void GrepNode::addChild(GrepNode* node)
 {
@@ -17,7 +17,8 @@ public:
         const std::string& value,
         const bool& is_regex = false,
         const bool& is_case_insensitive = false,
-        const bool& is_inverted = false);
+        const bool& is_inverted = false,
+        const bool& is_query = false);
 
     GrepNode() = default;
 
@@ -31,11 +32,14 @@ public:
 
     bool isInverted() const;
 
+    bool isQuery() const; // Pattern is a boolean expression, see FilterQuery
+
     // Setters
     void setPattern(const std::string& pattern);
     void setIsRegEx(bool isRegEx);
     void setIsCaseInsensitive(bool isCaseInsensitive);
     void setIsInverted(bool isInverted);
+    void setIsQuery(bool isQuery);
 
     void addChild(GrepNode* node);
 
@@ -51,6 +55,7 @@ protected:
     bool is_regex_{};
     bool is_case_insensitive_{};
     bool is_inverted_{};
+    bool is_query_{};
 
     friend class serializer::GrepNode;
 
@@ -0,0 +1,325 @@
+#include "IndexCache.hpp"
+#include "LineIndex.hpp"
+#include "MappedFile.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace
+{
+
+constexpr char kMagic[8] = {'P', 'P', 'L', 'I', 'D', 'X', '\0', '\0'};
+constexpr quint32 kVersion = 1;
+constexpr quint32 kByteOrderMark = 0x01020304; // Sidecars are only read on the machine that wrote them
+constexpr qint64 kFingerprintWindow = 64 * 1024;
+
+// Sidecar layout, every part 8-byte aligned:
+//   Header
+//   path (UTF-8, padded to 8 bytes)
+//   chunkCount x qint64: file offset of each chunk section
+//   chunk sections: rel[kChunkLines] quint16, groupBase[kGroupsPerChunk] qint64,
+//                   qint64 wideCount, wideCount x (qint64 group, qint64 offsets[kGroupLines])
+struct Header
+{
+    char magic[8];
+    quint32 version;
+    quint32 byteOrder;
+    qint64 fileSize;     // Bytes of the log covered by the index
+    qint64 mtime;        // Log mtime (ms since epoch) when the sidecar was written
+    quint64 headHash;    // Fingerprint of the first kFingerprintWindow bytes
+    quint64 tailHash;    // Fingerprint of the kFingerprintWindow bytes ending at fileSize
+    qint64 lineCount;
+    qint64 chunkCount;
+    qint64 pathBytes;
+};
+
+qint64 align8(qint64 value)
+{
+    return (value + 7) & ~qint64(7);
+}
+
+qint64 modificationTime(const QString& filename)
+{
+    return QFileInfo(filename).lastModified().toMSecsSinceEpoch();
+}
+
+// Keeps a mapped sidecar alive for as long as any index chunk points into it
+struct SidecarMapping
+{
+    QFile file;
+    uchar* data = nullptr;
+    qint64 size = 0;
+
+    ~SidecarMapping()
+    {
+        if (data) file.unmap(data);
+    }
+};
+
+}  // namespace
+
+QString IndexCache::sidecarPath(const QString& filename)
+{
+    const QString absolute = QFileInfo(filename).absoluteFilePath();
+    const QByteArray key = QCryptographicHash::hash(absolute.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+           + QStringLiteral("/index/") + QString::fromLatin1(key) + QStringLiteral(".lidx");
+}
+
+bool IndexCache::load(const MappedFile& file, LineIndex& index, qint64* indexedSize)
+{
+    auto mapping = std::make_shared<SidecarMapping>();
+    mapping->file.setFileName(sidecarPath(file.fileName()));
+    if (!mapping->file.exists() || !mapping->file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    mapping->size = mapping->file.size();
+    if (mapping->size < static_cast<qint64>(sizeof(Header))) {
+        return false;
+    }
+    mapping->data = mapping->file.map(0, mapping->size);
+    if (!mapping->data) {
+        qWarning("Unable to map index cache %s", qPrintable(mapping->file.fileName()));
+        return false;
+    }
+
+    const char* base = reinterpret_cast<const char*>(mapping->data);
+    Header header;
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion
+        || header.byteOrder != kByteOrderMark) {
+        return false;
+    }
+
+    // Plausibility first, nothing below may read past the mapping
+    const qint64 sectionBytes = LineIndex::kChunkLines * qint64(sizeof(quint16))
+                              + LineIndex::kGroupsPerChunk * qint64(sizeof(qint64)) + qint64(sizeof(qint64));
+    const qint64 pathOffset = sizeof(Header);
+    const qint64 directoryOffset = pathOffset + align8(header.pathBytes);
+    if (header.fileSize < 1 || header.lineCount < 1 || header.lineCount > LineIndex::kMaxLines
+        || header.pathBytes < 0 || header.pathBytes > mapping->size
+        || header.chunkCount != (header.lineCount + LineIndex::kChunkLines - 1) / LineIndex::kChunkLines
+        || directoryOffset + header.chunkCount * qint64(sizeof(qint64)) > mapping->size) {
+        qWarning("Ignoring malformed index cache %s", qPrintable(mapping->file.fileName()));
+        return false;
+    }
+
+    // Same path (the name is only a hash of it), and the content it covers is unchanged
+    const QString path = QString::fromUtf8(base + pathOffset, static_cast<int>(header.pathBytes));
+    if (path != QFileInfo(file.fileName()).absoluteFilePath() || file.size() < header.fileSize) {
+        return false;
+    }
+    if (file.size() == header.fileSize && modificationTime(file.fileName()) != header.mtime) {
+        return false;
+    }
+    if (file.fingerprint(0, qMin(kFingerprintWindow, header.fileSize)) != header.headHash
+        || file.fingerprint(header.fileSize - kFingerprintWindow, header.fileSize) != header.tailHash) {
+        return false;
+    }
+
+    // Everything is validated before the first chunk goes into index
+    std::vector<std::pair<std::shared_ptr<LineIndex::Chunk>, int>> chunks;
+    chunks.reserve(static_cast<size_t>(header.chunkCount));
+    const qint64* directory = reinterpret_cast<const qint64*>(base + directoryOffset);
+    for (qint64 c = 0; c < header.chunkCount; ++c) {
+        const qint64 section = directory[c];
+        if (section < 0 || (section & 7) != 0 || section + sectionBytes > mapping->size) {
+            qWarning("Ignoring malformed index cache %s", qPrintable(mapping->file.fileName()));
+            return false;
+        }
+        const char* p = base + section;
+        const quint16* rel = reinterpret_cast<const quint16*>(p);
+        p += LineIndex::kChunkLines * sizeof(quint16);
+        const qint64* groupBase = reinterpret_cast<const qint64*>(p);
+        p += LineIndex::kGroupsPerChunk * sizeof(qint64);
+        const qint64 wideCount = *reinterpret_cast<const qint64*>(p);
+        p += sizeof(qint64);
+        const qint64 wideBytes = wideCount * (1 + LineIndex::kGroupLines) * qint64(sizeof(qint64));
+        if (wideCount < 0 || wideCount > LineIndex::kGroupsPerChunk
+            || section + sectionBytes + wideBytes > mapping->size) {
+            qWarning("Ignoring malformed index cache %s", qPrintable(mapping->file.fileName()));
+            return false;
+        }
+
+        const int lines = static_cast<int>(qMin<qint64>(LineIndex::kChunkLines,
+                                                        header.lineCount - c * LineIndex::kChunkLines));
+        const bool partial = lines < LineIndex::kChunkLines;
+        std::shared_ptr<LineIndex::Chunk> chunk;
+        if (partial) {
+            // The writer keeps appending to this one, so it needs its own copy
+            chunk = LineIndex::newOwnedChunk();
+            std::memcpy(chunk->relStorage.get(), rel, LineIndex::kChunkLines * sizeof(quint16));
+            std::memcpy(chunk->groupBaseStorage.get(), groupBase, LineIndex::kGroupsPerChunk * sizeof(qint64));
+        } else {
+            chunk = std::make_shared<LineIndex::Chunk>();
+            chunk->rel = rel;
+            chunk->groupBase = groupBase;
+            chunk->backing = mapping;
+            for (auto& wide : chunk->wide) {
+                wide.store(nullptr, std::memory_order_relaxed);
+            }
+        }
+
+        qint64 previousGroup = -1;
+        for (qint64 w = 0; w < wideCount; ++w) {
+            const qint64* entry = reinterpret_cast<const qint64*>(p) + w * (1 + LineIndex::kGroupLines);
+            const qint64 group = entry[0];
+            // Ascending, like the writer escapes them (append() relies on that for the tail)
+            if (group <= previousGroup || group * LineIndex::kGroupLines >= lines) {
+                qWarning("Ignoring malformed index cache %s", qPrintable(mapping->file.fileName()));
+                return false;
+            }
+            const qint64* offsets = entry + 1;
+            if (partial) {
+                std::unique_ptr<qint64[]> storage(new qint64[LineIndex::kGroupLines]);
+                std::memcpy(storage.get(), offsets, LineIndex::kGroupLines * sizeof(qint64));
+                offsets = storage.get();
+                chunk->wideStorage.push_back(std::move(storage));
+            }
+            chunk->wide[group].store(offsets, std::memory_order_relaxed);
+            previousGroup = group;
+        }
+        chunks.emplace_back(std::move(chunk), lines);
+    }
+
+    for (auto& chunk : chunks) {
+        index.adoptChunk(std::move(chunk.first), chunk.second);
+    }
+    *indexedSize = header.fileSize;
+    return true;
+}
+
+bool IndexCache::save(const MappedFile& file, qint64 fileSize, qint64 lineCount, const LineIndex& index)
+{
+    // Lines appended after the caller's snapshot aren't covered by fileSize
+    if (lineCount < 1 || lineCount > index.size()) {
+        return false;
+    }
+
+    const QString sidecar = sidecarPath(file.fileName());
+    QDir().mkpath(QFileInfo(sidecar).absolutePath());
+    QSaveFile out(sidecar);
+    if (!out.open(QIODevice::WriteOnly)) {
+        qWarning("Unable to write index cache %s: %s", qPrintable(sidecar), qPrintable(out.errorString()));
+        return false;
+    }
+
+    const QByteArray path = QFileInfo(file.fileName()).absoluteFilePath().toUtf8();
+    Header header;
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.byteOrder = kByteOrderMark;
+    header.fileSize = fileSize;
+    header.mtime = modificationTime(file.fileName());
+    header.headHash = file.fingerprint(0, qMin(kFingerprintWindow, fileSize));
+    header.tailHash = file.fingerprint(fileSize - kFingerprintWindow, fileSize);
+    header.lineCount = lineCount;
+    header.chunkCount = (lineCount + LineIndex::kChunkLines - 1) / LineIndex::kChunkLines;
+    header.pathBytes = path.size();
+
+    const QByteArray padding(8, '\0');
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(path);
+    out.write(padding.constData(), align8(path.size()) - path.size());
+
+    // Sections are written in order, so the directory can be laid out up front
+    const qint64 fixedBytes = LineIndex::kChunkLines * qint64(sizeof(quint16))
+                            + LineIndex::kGroupsPerChunk * qint64(sizeof(qint64)) + qint64(sizeof(qint64));
+    std::vector<std::vector<qint64>> wideGroups(static_cast<size_t>(header.chunkCount));
+    std::vector<qint64> directory(static_cast<size_t>(header.chunkCount));
+    qint64 position = sizeof(Header) + align8(path.size()) + header.chunkCount * qint64(sizeof(qint64));
+    for (qint64 c = 0; c < header.chunkCount; ++c) {
+        const LineIndex::Chunk* chunk = index.chunkAt(c);
+        const qint64 lines = qMin<qint64>(LineIndex::kChunkLines, lineCount - c * LineIndex::kChunkLines);
+        // Groups escaped after lineCount was sampled describe lines we don't save
+        for (int g = 0; g * qint64(LineIndex::kGroupLines) < lines; ++g) {
+            if (chunk->wide[g].load(std::memory_order_acquire)) {
+                wideGroups[c].push_back(g);
+            }
+        }
+        directory[c] = position;
+        position += fixedBytes + qint64(wideGroups[c].size()) * (1 + LineIndex::kGroupLines) * qint64(sizeof(qint64));
+    }
+    out.write(reinterpret_cast<const char*>(directory.data()), header.chunkCount * qint64(sizeof(qint64)));
+
+    // Only entries below lineCount are read; in the tail chunk the rest may be being written
+    // right now, so it's saved as zeros
+    const QByteArray zeros(LineIndex::kChunkLines * sizeof(quint16), '\0');
+    const auto writePadded = [&out, &zeros](const void* data, qint64 used, qint64 total) {
+        out.write(static_cast<const char*>(data), used);
+        out.write(zeros.constData(), total - used);
+    };
+    for (qint64 c = 0; c < header.chunkCount; ++c) {
+        const LineIndex::Chunk* chunk = index.chunkAt(c);
+        const qint64 lines = qMin<qint64>(LineIndex::kChunkLines, lineCount - c * LineIndex::kChunkLines);
+        const qint64 groups = (lines + LineIndex::kGroupLines - 1) / LineIndex::kGroupLines;
+        writePadded(chunk->rel, lines * sizeof(quint16), LineIndex::kChunkLines * sizeof(quint16));
+        writePadded(chunk->groupBase, groups * sizeof(qint64), LineIndex::kGroupsPerChunk * sizeof(qint64));
+        const qint64 wideCount = wideGroups[c].size();
+        out.write(reinterpret_cast<const char*>(&wideCount), sizeof(wideCount));
+        for (const qint64 group : wideGroups[c]) {
+            const qint64 used = qMin<qint64>(LineIndex::kGroupLines, lines - group * LineIndex::kGroupLines);
+            out.write(reinterpret_cast<const char*>(&group), sizeof(group));
+            writePadded(chunk->wide[group].load(std::memory_order_acquire), used * sizeof(qint64),
+                        LineIndex::kGroupLines * sizeof(qint64));
+        }
+    }
+
+    if (!out.commit()) {
+        qWarning("Unable to write index cache %s: %s", qPrintable(sidecar), qPrintable(out.errorString()));
+        return false;
+    }
+    qInfo("Saved index cache for %s (%lld lines) to %s", qPrintable(file.fileName()), lineCount, qPrintable(sidecar));
+    return true;
+}
+
+void IndexCache::prune()
+{
+    const QString directory = QFileInfo(sidecarPath(QStringLiteral("x"))).absolutePath();
+    const QDateTime now = QDateTime::currentDateTime();
+    const QDateTime expiry = now.addDays(-kMaxAgeDays);
+
+    // A sidecar's mtime is when it was written; load() doesn't touch it, so an often reopened
+    // log that doesn't change counts as old. The last read time decides where available.
+    std::vector<QFileInfo> sidecars;
+    qint64 totalSize = 0;
+    QDirIterator it(directory, {QStringLiteral("*.lidx")}, QDir::Files);
+    while (it.hasNext()) {
+        it.next();
+        const QFileInfo info = it.fileInfo();
+        const QDateTime used = qMax(info.lastModified(), info.lastRead());
+        if (used < expiry) {
+            QFile::remove(info.absoluteFilePath());
+            continue;
+        }
+        totalSize += info.size();
+        sidecars.push_back(info);
+    }
+    if (totalSize <= kMaxTotalSize) {
+        return;
+    }
+
+    std::sort(sidecars.begin(), sidecars.end(), [](const QFileInfo& a, const QFileInfo& b) {
+        return qMax(a.lastModified(), a.lastRead()) < qMax(b.lastModified(), b.lastRead());
+    });
+    for (const QFileInfo& info : sidecars) {
+        if (totalSize <= kMaxTotalSize) {
+            break;
+        }
+        if (QFile::remove(info.absoluteFilePath())) {
+            totalSize -= info.size();
+        }
+    }
+    qInfo("Pruned index cache %s to %lld MiB", qPrintable(directory), totalSize / (1024 * 1024));
+}
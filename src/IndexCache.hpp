@@ -0,0 +1,48 @@
+#ifndef INDEX_CACHE_HPP
+#define INDEX_CACHE_HPP
+
+#include <memory>
+
+#include <QString>
+
+class LineIndex;
+class MappedFile;
+
+// Persists line indexes to sidecar files in the user's cache directory, so reopening a big
+// log doesn't rescan it from byte 0.
+//
+// A sidecar is keyed by the log's absolute path and validated against its size, mtime and a
+// fingerprint of the first and last 64 KiB it covered. Full index chunks are used straight
+// from the memory-mapped sidecar; only the last, partial chunk is copied so that indexing can
+// carry on from where the cached index ended when the log has grown since.
+//
+// Sidecars of logs that are gone, or haven't been opened for a while, would pile up: after
+// every save the directory is pruned to kMaxAge and kMaxTotalSize, oldest first.
+class IndexCache
+{
+public:
+    // Below this size rescanning is quicker than reading a sidecar, so nothing is cached
+    static constexpr qint64 kMinFileSize = qint64(16) * 1024 * 1024;
+    // Sidecars not written or read for this long are deleted
+    static constexpr qint64 kMaxAgeDays = 30;
+    // Beyond this, the least recently used sidecars are deleted
+    static constexpr qint64 kMaxTotalSize = qint64(1024) * 1024 * 1024;
+
+    // Fills the empty index with the cached lines of the first *indexedSize bytes of file.
+    // *indexedSize is file.size() on an exact hit and smaller when the file has grown.
+    // Returns false, leaving index untouched, if there's no valid sidecar.
+    static bool load(const MappedFile& file, LineIndex& index, qint64* indexedSize);
+
+    // Writes the first lineCount lines of index, which must cover exactly the first fileSize
+    // bytes of file. Both are sampled together by the caller, on the thread that appends to
+    // the index. Meant to run in a background thread; the index may keep growing meanwhile.
+    static bool save(const MappedFile& file, qint64 fileSize, qint64 lineCount, const LineIndex& index);
+
+    // Deletes sidecars past kMaxAgeDays, then the least recently used ones until the rest fit
+    // in kMaxTotalSize. Slow (it lists the directory), background threads only.
+    static void prune();
+
+    static QString sidecarPath(const QString& filename);
+};
+
+#endif // INDEX_CACHE_HPP
@@ -0,0 +1,171 @@
+#include "LineIndex.hpp"
+
+LineIndex::LineIndex()
+{
+    for (auto& page : pages_) {
+        page.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+LineIndex::~LineIndex()
+{
+    for (auto& page : pages_) {
+        delete page.load(std::memory_order_relaxed);
+    }
+}
+
+qint64 LineIndex::size() const
+{
+    return size_.load(std::memory_order_acquire);
+}
+
+bool LineIndex::isEmpty() const
+{
+    return size() == 0;
+}
+
+const LineIndex::Chunk* LineIndex::chunkAt(qint64 chunk) const
+{
+    const ChunkPage* page = pages_[chunk >> kPageShift].load(std::memory_order_acquire);
+    return page->chunks[chunk & (kPageChunks - 1)].get();
+}
+
+qint64 LineIndex::at(qint64 line) const
+{
+    Q_ASSERT(line >= 0 && line < size());
+    const Chunk* chunk = chunkAt(line >> kChunkShift);
+    const int within = static_cast<int>(line & (kChunkLines - 1));
+    const int group = within >> kGroupShift;
+    if (const qint64* wide = chunk->wide[group].load(std::memory_order_acquire)) {
+        return wide[within & (kGroupLines - 1)];
+    }
+    return chunk->groupBase[group] + chunk->rel[within];
+}
+
+qint64 LineIndex::lineEnd(qint64 line, qint64 fileSize) const
+{
+    // The index may have been extended for a longer mapping of the file than the caller's
+    return (line + 1 < size()) ? qMin(at(line + 1), fileSize) : fileSize;
+}
+
+std::shared_ptr<LineIndex::Chunk> LineIndex::newOwnedChunk()
+{
+    auto chunk = std::make_shared<Chunk>();
+    chunk->relStorage.reset(new quint16[kChunkLines]);
+    chunk->groupBaseStorage.reset(new qint64[kGroupsPerChunk]);
+    chunk->rel = chunk->relStorage.get();
+    chunk->groupBase = chunk->groupBaseStorage.get();
+    for (auto& wide : chunk->wide) {
+        wide.store(nullptr, std::memory_order_relaxed);
+    }
+    return chunk;
+}
+
+LineIndex::Chunk* LineIndex::appendChunk(qint64 chunk)
+{
+    std::atomic<ChunkPage*>& slot = pages_[chunk >> kPageShift];
+    ChunkPage* page = slot.load(std::memory_order_relaxed);
+    if (!page) {
+        page = new ChunkPage();
+        slot.store(page, std::memory_order_release);
+    }
+    // Readers only reach this slot after the size_ store that publishes its first line
+    std::shared_ptr<Chunk>& entry = page->chunks[chunk & (kPageChunks - 1)];
+    entry = newOwnedChunk();
+    ++chunkCount_;
+    return entry.get();
+}
+
+void LineIndex::adoptChunk(std::shared_ptr<Chunk> chunk, int lineCount)
+{
+    const qint64 line = size_.load(std::memory_order_relaxed);
+    Q_ASSERT((line & (kChunkLines - 1)) == 0 && lineCount > 0 && lineCount <= kChunkLines);
+    const qint64 index = line >> kChunkShift;
+
+    std::atomic<ChunkPage*>& slot = pages_[index >> kPageShift];
+    ChunkPage* page = slot.load(std::memory_order_relaxed);
+    if (!page) {
+        page = new ChunkPage();
+        slot.store(page, std::memory_order_release);
+    }
+    page->chunks[index & (kPageChunks - 1)] = chunk;
+    ++chunkCount_;
+    for (const auto& wide : chunk->wide) {
+        if (wide.load(std::memory_order_relaxed)) ++wideGroups_;
+    }
+    // A partial chunk must be owned, append() continues filling it
+    tail_ = chunk->relStorage ? chunk.get() : nullptr;
+    size_.store(line + lineCount, std::memory_order_release);
+}
+
+bool LineIndex::append(qint64 offset)
+{
+    const qint64 line = size_.load(std::memory_order_relaxed); // Only the writer changes size_
+    if (line >= kMaxLines) {
+        return false;
+    }
+
+    const int within = static_cast<int>(line & (kChunkLines - 1));
+    if (within == 0) {
+        tail_ = appendChunk(line >> kChunkShift);
+    }
+    Chunk* chunk = tail_;
+    const int group = within >> kGroupShift;
+    const int inGroup = within & (kGroupLines - 1);
+
+    if (inGroup == 0) {
+        chunk->groupBaseStorage[group] = offset;
+        chunk->relStorage[within] = 0;
+    } else if (chunk->wide[group].load(std::memory_order_relaxed)) {
+        // Only the group being filled can still grow, and it's the most recent escape
+        chunk->wideStorage.back()[inGroup] = offset;
+    } else {
+        const qint64 delta = offset - chunk->groupBase[group];
+        if (delta <= 0xFFFF) {
+            chunk->relStorage[within] = static_cast<quint16>(delta);
+        } else {
+            // Escape: this group switches to full offsets. The relative entries already
+            // published stay valid, so concurrent readers see correct values either way.
+            std::unique_ptr<qint64[]> storage(new qint64[kGroupLines]);
+            const int groupStart = within - inGroup;
+            for (int i = 0; i < inGroup; ++i) {
+                storage[i] = chunk->groupBase[group] + chunk->rel[groupStart + i];
+            }
+            storage[inGroup] = offset;
+            chunk->wide[group].store(storage.get(), std::memory_order_release);
+            chunk->wideStorage.push_back(std::move(storage));
+            ++wideGroups_;
+        }
+    }
+
+    size_.store(line + 1, std::memory_order_release);
+    return true;
+}
+
+bool LineIndex::append(const qint64* offsets, qint64 count)
+{
+    for (qint64 i = 0; i < count; ++i) {
+        if (!append(offsets[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void LineIndex::sharePrefix(const LineIndex& other, qint64 lineCount)
+{
+    Q_ASSERT(isEmpty() && (lineCount & (kChunkLines - 1)) == 0 && lineCount <= other.size());
+    for (qint64 chunk = 0; chunk < (lineCount >> kChunkShift); ++chunk) {
+        const ChunkPage* page = other.pages_[chunk >> kPageShift].load(std::memory_order_acquire);
+        adoptChunk(page->chunks[chunk & (kPageChunks - 1)], static_cast<int>(kChunkLines));
+    }
+    tail_ = nullptr; // The next append() starts a chunk of its own
+}
+
+qint64 LineIndex::memoryUsage() const
+{
+    // Counts chunks mapped from a sidecar too; the OS pages those in and out as needed
+    return chunkCount_ * static_cast<qint64>(sizeof(Chunk) + kChunkLines * sizeof(quint16)
+                                             + kGroupsPerChunk * sizeof(qint64))
+         + wideGroups_ * kGroupLines * static_cast<qint64>(sizeof(qint64));
+}
@@ -0,0 +1,106 @@
+#ifndef LINE_INDEX_HPP
+#define LINE_INDEX_HPP
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <QtGlobal>
+
+// Compact, append-only table of line start offsets (line number -> byte offset).
+//
+// Lines are grouped by 32. Each group stores one absolute 64-bit offset and, per line, a
+// 16-bit offset relative to it, which is ~2.5 bytes per line instead of 8. A group where
+// some line lies 64 KiB or more past the group start ("escape") keeps full 64-bit offsets
+// instead. Lookups are O(1): one group base plus one relative offset.
+//
+// Storage is a list of fixed-size chunks (65536 lines each), so appending never moves or
+// copies existing entries. One writer may append while any number of threads read: readers
+// may access every line below a size() they have observed.
+//
+// Full chunks never change again; IndexCache persists them to disk and can hand back chunks
+// that point straight into a memory-mapped sidecar file.
+class LineIndex
+{
+public:
+    LineIndex();
+    ~LineIndex();
+
+    LineIndex(const LineIndex&) = delete;
+    LineIndex& operator=(const LineIndex&) = delete;
+
+    // Rows are ints in the item models, so that's the most lines an index needs to hold
+    static constexpr qint64 kMaxLines = qint64(1) << 31;
+
+    // Lines per storage chunk; a chunk is immutable once full
+    static constexpr int kChunkShift = 16;
+    static constexpr qint64 kChunkLines = qint64(1) << kChunkShift;
+
+    qint64 size() const;
+    bool isEmpty() const;
+
+    // Start offset of line (0-based); line must be < size()
+    qint64 at(qint64 line) const;
+    qint64 operator[](qint64 line) const { return at(line); }
+
+    // End offset of line: start of the next line, or fileSize for the last one. Never past
+    // fileSize, follow mode may have indexed lines beyond the caller's mapping.
+    qint64 lineEnd(qint64 line, qint64 fileSize) const;
+
+    // Offsets must be ascending. Returns false once kMaxLines is reached.
+    bool append(qint64 offset);
+    bool append(const qint64* offsets, qint64 count);
+
+    // Fills this empty index with the first lineCount lines of other, sharing its storage
+    // instead of copying it. lineCount must be a multiple of kChunkLines and at most
+    // other.size(), so only full chunks are shared; both indexes may then grow on their own.
+    void sharePrefix(const LineIndex& other, qint64 lineCount);
+
+    // Approximate memory footprint, for diagnostics
+    qint64 memoryUsage() const;
+
+private:
+    static constexpr int kGroupShift = 5;
+    static constexpr int kGroupLines = 1 << kGroupShift;
+    static constexpr int kGroupsPerChunk = kChunkLines >> kGroupShift;
+    static constexpr int kPageShift = 8; // Chunks per directory page
+    static constexpr int kPageChunks = 1 << kPageShift;
+    static constexpr int kMaxPages = static_cast<int>(kMaxLines >> (kChunkShift + kPageShift));
+
+    // The arrays either live in the storage members or in memory kept alive by backing
+    // (a mapped sidecar); only the writer's tail chunk is ever modified, and it's always owned.
+    struct Chunk
+    {
+        const quint16* rel = nullptr;       // [kChunkLines] offset relative to the group base
+        const qint64* groupBase = nullptr;  // [kGroupsPerChunk] absolute offset of each group's first line
+        std::atomic<const qint64*> wide[kGroupsPerChunk]; // [kGroupLines] full offsets for escaped groups, else null
+
+        std::unique_ptr<quint16[]> relStorage;
+        std::unique_ptr<qint64[]> groupBaseStorage;
+        std::vector<std::unique_ptr<qint64[]>> wideStorage; // In escape order
+        std::shared_ptr<const void> backing;
+    };
+
+    struct ChunkPage
+    {
+        std::shared_ptr<Chunk> chunks[kPageChunks];
+    };
+
+    const Chunk* chunkAt(qint64 chunk) const;
+    static std::shared_ptr<Chunk> newOwnedChunk();
+    Chunk* appendChunk(qint64 chunk);
+    // Adds a chunk built elsewhere holding lineCount lines; only valid at a chunk boundary
+    void adoptChunk(std::shared_ptr<Chunk> chunk, int lineCount);
+
+    friend class IndexCache;
+
+    std::atomic<ChunkPage*> pages_[kMaxPages];
+    std::atomic<qint64> size_{0};
+
+    // Writer-side state
+    Chunk* tail_ = nullptr;
+    qint64 chunkCount_ = 0;
+    qint64 wideGroups_ = 0;
+};
+
+#endif // LINE_INDEX_HPP
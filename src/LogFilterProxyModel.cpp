@@ -1,13 +1,14 @@
 #include "LogFilterProxyModel.hpp"
 #include "Logfile.hpp"
 #include "GrepNode.hpp"
+#include "LineIndex.hpp"
+#include "MappedFile.hpp"
 
 #include <QDebug>
 #include <QApplication>
 #include <QRegularExpression>
 #include <QFile>
 #include <QVector>
-#include <QBitArray>
 #include <QList>
 #include <QThread> // Added for cancellation check
 #include <QTimer>  // Added for delayed invalidateFilter
@@ -18,7 +19,7 @@
 LogFilterProxyModel::LogFilterProxyModel(QObject* parent)
     : QSortFilterProxyModel(parent)
 {
-    connect(&filterWatcher_, &QFutureWatcher<QBitArray>::finished,
+    connect(&filterWatcher_, &QFutureWatcher<MatchSet>::finished,
             this, &LogFilterProxyModel::handleFilterFinished);
 }
 
@@ -102,11 +103,11 @@ void LogFilterProxyModel::applyFilterChain(const QList<GrepNode*>& chain)
 // Updated filterAcceptsRow
 bool LogFilterProxyModel::filterAcceptsRow(int source_row, const QModelIndex& /*source_parent*/) const
 {
-    if (source_row < 0 || source_row >= matchingSourceRows_.size()) {
+    if (source_row < 0 || source_row >= matchingSourceRows_.rows()) {
         return false;
     }
-    // Accept row if filter chain is empty OR if the corresponding bit is set
-    return lastAppliedFilterChainParams_.isEmpty() || matchingSourceRows_.testBit(source_row);
+    // Accept row if filter chain is empty OR if the row is in the match set
+    return lastAppliedFilterChainParams_.isEmpty() || matchingSourceRows_.contains(source_row);
 }
 
 void LogFilterProxyModel::startAsyncFiltering()
@@ -126,17 +127,17 @@ void LogFilterProxyModel::startAsyncFiltering()
     // Don't invalidate here, wait for results
 
     // --- Prepare data copies for the background task ---
-    QString filenameCopy = sourceLogfile_->getFileName();
-    QVector<qint64> lineIndexCopy = sourceLogfile_->getLineIndexCopy();
+    std::shared_ptr<const MappedFile> mappedFile = sourceLogfile_->getMappedFile();
+    std::shared_ptr<const LineIndex> lineIndex = sourceLogfile_->getLineIndex();
     QList<FilterParams> filterChainParamsCopy = currentFilterChainParams_; // Use current chain
 
     // --- Run the filtering task in a separate thread using a lambda ---
-    auto filterLambda = [=]() -> QBitArray {
+    auto filterLambda = [=]() -> MatchSet {
         return LogFilterProxyModel::performFilteringTask(
-            filenameCopy, lineIndexCopy, filterChainParamsCopy
+            mappedFile, lineIndex, filterChainParamsCopy
         );
     };
-    QFuture<QBitArray> future = QtConcurrent::run(filterLambda);
+    QFuture<MatchSet> future = QtConcurrent::run(filterLambda);
     filterWatcher_.setFuture(future);
 }
 
@@ -147,12 +148,12 @@ void LogFilterProxyModel::handleFilterFinished()
      if (!wasCancelled) {
          matchingSourceRows_ = filterWatcher_.result(); // Update results
          lastAppliedFilterChainParams_ = currentFilterChainParams_; // Store the successfully applied filter
-         matchCount = matchingSourceRows_.count(true); // Use QBitArray::count()
+         matchCount = matchingSourceRows_.count();
          qDebug() << "Filtering finished. Matches found:" << matchCount;
      } else {
          qDebug() << "Filtering was cancelled.";
          // Use count on the existing (stale) matchingSourceRows_ if cancelled
-         matchCount = matchingSourceRows_.count(true);
+         matchCount = matchingSourceRows_.count();
      }
 
     isFiltering_ = false;
@@ -170,17 +171,16 @@ void LogFilterProxyModel::handleFilterFinished()
 
 // --- Static method executed in the background thread ---
 // Reworked logic to perform *chained* filtering correctly
-QBitArray LogFilterProxyModel::performFilteringTask(
-    QString filename, QVector<qint64> lineIndex, QList<FilterParams> filterChainParams)
+MatchSet LogFilterProxyModel::performFilteringTask(
+    std::shared_ptr<const MappedFile> file, std::shared_ptr<const LineIndex> lineIndex, QList<FilterParams> filterChainParams)
 {
-    qint64 lineCount = lineIndex.size();
-    // Start with all lines matching (indices 0 to lineCount-1)
-    QBitArray currentMatches(lineCount, true);
-    QFile localFile(filename);
-
-    if (!localFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        qWarning("Background task: Failed to open file %s", qPrintable(filename));
-        return QBitArray(lineCount, false); // Return empty matches on error
+    const int lineCount = lineIndex ? static_cast<int>(lineIndex->size()) : 0;
+    // Start with all lines matching (indices 0 to lineCount-1), a single run
+    MatchSet currentMatches = MatchSet::filled(lineCount);
+
+    if (!file) {
+        qWarning("Background task: No open file to filter");
+        return MatchSet(lineCount); // Return empty matches on error
     }
 
     // Apply each filter step sequentially
@@ -188,38 +188,31 @@ QBitArray LogFilterProxyModel::performFilteringTask(
         // If the pattern for this step is empty, skip it (this represents the "Base" level)
         if (params.pattern.isEmpty()) continue;
 
-        QBitArray stepMatches(lineCount, false); // Results for *this* step
+        MatchSet stepMatches(lineCount); // Results for *this* step
         bool stepRegexIsValid = !params.isRegex || params.regex.isValid();
 
         if (params.isRegex && !stepRegexIsValid) {
              qWarning("Background task: Invalid regex '%s' encountered in chain.", qPrintable(params.pattern));
-             currentMatches.fill(false); // Invalidate all previous matches
+             currentMatches = MatchSet(lineCount); // Invalidate all previous matches
              break; // Stop processing chain
         }
 
         // Iterate only through lines that matched the *previous* step
-        for (qint64 i = 0; i < lineCount; ++i) {
-            // Use int for bit array index
-            int rowIndex = static_cast<int>(i);
-            if (!currentMatches.testBit(rowIndex)) {
-                continue; // Skip if didn't pass previous filters
-            }
+        bool interrupted = false;
+        currentMatches.forEach([&](int rowIndex) {
+            const qint64 i = rowIndex;
 
             // --- Cancellation Check ---
             if (QThread::currentThread()->isInterruptionRequested()) {
-                qDebug() << "Background filtering task interrupted.";
-                return QBitArray(); // Return empty array on cancellation
+                interrupted = true;
+                return false;
             }
             // --- End Cancellation Check ---
 
-            // Get line data
-            qint64 start_pos = lineIndex[i];
-            if (!localFile.seek(start_pos)) {
-                 qWarning("Background task: Failed to seek to pos %lld for line %lld", start_pos, i + 1);
-                 continue; // Skip line on seek error
-            }
-            QByteArray lineData = localFile.readLine();
-            QString lineText = QString::fromUtf8(lineData).trimmed();
+            // Get line data straight from the shared mapping
+            qint64 start_pos = lineIndex->at(i);
+            qint64 end_pos = lineIndex->lineEnd(i, file->size());
+            QString lineText = QString::fromUtf8(file->bytes(start_pos, end_pos)).trimmed();
 
             // Apply the *current step's* filter
             bool matchFound = false;
@@ -229,16 +222,22 @@ QBitArray LogFilterProxyModel::performFilteringTask(
                  matchFound = lineText.contains(params.pattern, params.cs);
             }
 
-            // If the line passes this step (considering inversion), mark it in stepMatches
+            // If the line passes this step (considering inversion), add it to stepMatches
             if (params.inverted ? !matchFound : matchFound) {
-                stepMatches.setBit(rowIndex, true);
+                stepMatches.append(rowIndex);
             }
+            return true;
+        });
+        if (interrupted) {
+            qDebug() << "Background filtering task interrupted.";
+            return MatchSet(); // Return empty set on cancellation
         }
         // The results of this step become the input for the next step
-        currentMatches = stepMatches;
+        stepMatches.optimize();
+        currentMatches = std::move(stepMatches);
 
         // Optimization: if no lines match at any step, stop early
-        if (currentMatches.count(true) == 0) {
+        if (currentMatches.count() == 0) {
             qDebug() << "Filter chain resulted in 0 matches at step:" << params.pattern;
             break;
         }
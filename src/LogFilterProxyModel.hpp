@@ -3,13 +3,16 @@
 
 #include <QSortFilterProxyModel>
 #include <QRegularExpression>
-#include <QBitArray>
 #include <QFutureWatcher>
 #include <QtConcurrent/QtConcurrent>
 #include <QList> // For filter chain
+#include <memory>
 #include "FilterParams.hpp" // Added include
+#include "MatchSet.hpp"
 
 class LogfileModel;
+class LineIndex;
+class MappedFile;
 class Logfile;
 class GrepNode; // Forward declaration
 
@@ -29,7 +32,7 @@ public:
     // New method to apply the entire filter chain
     void applyFilterChain(const QList<GrepNode*>& chain);
 
-    // Override the core filtering method (checks internal bit array)
+    // Override the core filtering method (checks the internal match set)
     bool filterAcceptsRow(int source_row, const QModelIndex& source_parent) const override;
 
     void setSourceLogfile(Logfile* logfile);
@@ -50,14 +53,14 @@ private:
 
     // Internal state
     Logfile* sourceLogfile_ = nullptr;
-    QBitArray matchingSourceRows_;
-    QFutureWatcher<QBitArray> filterWatcher_;
+    MatchSet matchingSourceRows_;
+    QFutureWatcher<MatchSet> filterWatcher_;
     bool isFiltering_ = false;
 
     // Helper methods
     void startAsyncFiltering(); // Triggers the background filtering task
     // Static method for the background task (updated signature)
-    static QBitArray performFilteringTask(QString filename, QVector<qint64> lineIndex, QList<FilterParams> filterChainParams);
+    static MatchSet performFilteringTask(std::shared_ptr<const MappedFile> file, std::shared_ptr<const LineIndex> lineIndex, QList<FilterParams> filterChainParams);
 };
 
 #endif // LOGFILTERPROXYMODEL_HPP
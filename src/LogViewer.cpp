@@ -71,11 +71,15 @@ LogViewer::LogViewer(QWidget* parent, Logfile* logfile)
 
     // Connect signals from proxy model
     connect(proxyModel_, &EfficientLogFilterProxyModel::filteringStarted, this, &LogViewer::onFilteringStarted);
+    connect(proxyModel_, &EfficientLogFilterProxyModel::filteringProgress, this, &LogViewer::onFilteringProgress);
     connect(proxyModel_, &EfficientLogFilterProxyModel::filteringFinished, this, &LogViewer::onFilteringFinished);
 
     // Connect visible range changes from view to trigger cache population in logfile
     connect(view_, &CustomLogView::visibleRangeChanged, this, &LogViewer::onVisibleRangeChanged);
 
+    // Keep the view at the end of the file while it's being followed
+    connect(logfile_, &Logfile::followingChanged, view_, &CustomLogView::setFollowTail);
+
     // --- Add Copy Action ---
     QAction* copyAction = new QAction(tr("Copy"), this);
     copyAction->setShortcut(QKeySequence::Copy); // Standard Ctrl+C / Cmd+C
@@ -108,7 +112,7 @@ void LogViewer::applyFilterChain(const QList<GrepNode*>& chain)
 void LogViewer::onFilteringStarted()
 {
     qDebug() << "LogViewer: Filtering started...";
-    view_->setEnabled(false); // Disable view interaction during filtering
+    // The view stays usable: matches are appended to it while filtering goes on
 
     // Show status label instead of dialog
     if (statusLabel_) {
@@ -117,10 +121,16 @@ void LogViewer::onFilteringStarted()
     }
 }
 
+void LogViewer::onFilteringProgress(int matchCount)
+{
+    if (statusLabel_) {
+        statusLabel_->setText(tr("Filtering... Matches so far: %1").arg(matchCount));
+    }
+}
+
 void LogViewer::onFilteringFinished(int matchCount)
 {
      qDebug() << "LogViewer: Filtering finished. Matches:" << matchCount;
-     view_->setEnabled(true); // Re-enable view interaction
 
      // Update status label and hide it after a short delay
      if (statusLabel_) {
@@ -165,6 +175,22 @@ CustomLogView* LogViewer::getCustomView() const
     return view_;
 }
 
+void LogViewer::showEvent(QShowEvent* event)
+{
+    QWidget::showEvent(event);
+    if (proxyModel_) {
+        proxyModel_->setForeground(true);
+    }
+}
+
+void LogViewer::hideEvent(QHideEvent* event)
+{
+    QWidget::hideEvent(event);
+    if (proxyModel_) {
+        proxyModel_->setForeground(false); // Switched to another tab
+    }
+}
+
 // Slot to handle visible range changes from the view
 void LogViewer::onVisibleRangeChanged(qint64 firstVisible, qint64 lastVisible)
 {
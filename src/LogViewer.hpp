@@ -30,6 +30,7 @@ public:
 private slots:
     // Slots to handle filtering state changes from the proxy model
     void onFilteringStarted();
+    void onFilteringProgress(int matchCount);
     void onFilteringFinished(int matchCount);
     // Slot for copying selected text
     void copySelectionToClipboard();
@@ -37,10 +38,14 @@ private slots:
     void onVisibleRangeChanged(qint64 firstVisible, qint64 lastVisible);
 
 protected:
+    // The tab on screen filters ahead of the others, see EfficientLogFilterProxyModel::setForeground()
+    void showEvent(QShowEvent* event) override;
+    void hideEvent(QHideEvent* event) override;
+
     Logfile* logfile_;
     CustomLogView* view_; // Changed type from QTableView
     LogfileModel* baseSourceModel_;
-    EfficientLogFilterProxyModel* proxyModel_; // Changed type
+    EfficientLogFilterProxyModel* proxyModel_ = nullptr; // Changed type
     // QLabel* statusOverlay_; // Removed old overlay label
     QLabel* statusLabel_ = nullptr; // Label to show filtering status
 };
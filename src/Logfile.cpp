@@ -1,8 +1,16 @@
 #include "Logfile.hpp"
+#include <algorithm>
 #include <memory>
 #include <atomic> // For cancellation flag
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <vector>
 
+#include <QDateTime>
 #include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
 #include <QMessageBox>
 #include <QVector>
 #include <QObject>
@@ -11,10 +19,30 @@
 
 #include "BookmarksModel.hpp"
 #include "GrepNode.hpp"
+#include "IndexCache.hpp"
+#include "simd/NewlineScanner.hpp"
+
+namespace
+{
+
+// A writer appending many lines per second triggers change notifications nonstop; they
+// are folded into one check (and, when following, one row insert) per interval
+const int kChangeCoalesceMs = 100;
+
+// Between a rotation moving the file away and the new one being created there's nothing
+// to watch, so the path is polled
+const int kMissingFileRetryMs = 1000;
+
+// Bytes hashed per index checkpoint. Log lines start with timestamps and the like, so a
+// short window already tells a rewritten file from the original.
+const qint64 kCheckpointWindow = 1024;
+
+}  // namespace
 
 // Constructor: Initialize members, connect watcher
 Logfile::Logfile(QObject* parent)
-    : QObject(parent)
+    : QObject(parent),
+      line_index_(std::make_shared<LineIndex>())
 {
     // Set cache size (e.g., max 10000 lines)
     line_cache_.setMaxCost(10000);
@@ -22,20 +50,29 @@ Logfile::Logfile(QObject* parent)
     // Connect the watcher's finished signal to our handler slot
     connect(&index_watcher_, &QFutureWatcher<bool>::finished,
             this, &Logfile::handleIndexFinished);
+    connect(&extend_watcher_, &QFutureWatcher<bool>::finished,
+            this, &Logfile::handleExtendFinished);
+
+    change_timer_.setSingleShot(true);
+    change_timer_.setInterval(kChangeCoalesceMs);
+    connect(&change_timer_, &QTimer::timeout, this, &Logfile::checkForChanges);
     // Optional: Connect progress signals if needed
     // connect(&index_watcher_, &QFutureWatcher<bool>::progressValueChanged, ...);
 }
 
-// Destructor: Ensure file is closed. QFutureWatcher cleanup is automatic.
+// Destructor: The mapping is released with the last MappedFile reference.
 Logfile::~Logfile()
 {
-    // Request cancellation if indexing is still running
-    // index_watcher_.cancel(); // Might be needed depending on ownership/threading model
-    // index_watcher_.waitForFinished(); // Ensure thread completes before destruction if necessary
-
-    if (file_.isOpen()) {
-        file_.close();
-    }
+    // Background tasks stop at their next chunk. The indexing task works on this object, so
+    // it must be done before any member goes away; the others only hold shared references,
+    // waiting for them just keeps them from outliving the tab.
+    cancel_token_.cancel();
+    view_cancel_.cancel();
+    TaskScheduler::instance().discardCancelled(); // Queued ones are done with right away
+    index_watcher_.waitForFinished();
+    extend_watcher_.waitForFinished();
+    viewport_watcher_.waitForFinished();
+    cache_watcher_.waitForFinished();
 }
 
 // Asynchronous initialization function
@@ -46,28 +83,46 @@ void Logfile::initialize(const QString& filename)
         return;
     }
 
+    setFollowing(false); // Following applies to the file being replaced
+    cancel_token_.cancel(); // Extension and prefetch tasks of the previous file
+    cancel_token_ = CancellationToken();
+    view_cancel_.cancel();
+    delete file_watcher_;
+    file_watcher_ = nullptr;
+    change_timer_.stop();
+    change_recheck_ = false;
+    reindexing_ = false;
     filename_ = filename;
     initialized_ = false; // Reset initialization state
-    line_index_.clear(); // Clear previous index
+    visible_lines_ = 0;
+    checkpoints_.clear();
+    end_fingerprint_ = 0;
+    line_index_ = std::make_shared<LineIndex>(); // Fresh index; tasks still holding the old one keep it alive
     line_cache_.clear(); // Clear cache
+    mapped_file_.reset();
+    emit linesIndexed(0); // Views drop the rows of a previous file
     emit initializedChanged(); // Notify state change
 
-    file_.setFileName(filename_);
-    if (!file_.open(QIODevice::ReadOnly | QIODevice::Text))
+    QString errorString;
+    mapped_file_ = MappedFile::open(filename_, &errorString);
+    if (!mapped_file_)
     {
         // Show user-facing error message
         QMessageBox::warning(nullptr, // No parent window available here easily
                              tr("Error Opening File"),
-                             tr("Unable to open file '%1':\n%2").arg(filename_).arg(file_.errorString()));
-        qWarning("Unable to open file '%s': %s", qPrintable(filename_), qPrintable(file_.errorString())); // Keep log warning
+                             tr("Unable to open file '%1':\n%2").arg(filename_).arg(errorString));
+        qWarning("Unable to open file '%s': %s", qPrintable(filename_), qPrintable(errorString)); // Keep log warning
         emit indexingFinished(false); // Signal failure immediately
         emit initializedChanged(); // Ensure state is updated
         return;
     }
+    watchFile(); // Rotation and truncation are detected from the start
 
     // Run buildIndexInternal in a separate thread
     // Correct order: (pointerToObject, &ClassName::memberFunction)
-    QFuture<bool> future = QtConcurrent::run(this, &Logfile::buildIndexInternal);
+    // The task fills line_index_ in place; the GUI thread reads the lines published so far
+    QFuture<bool> future = QtConcurrent::run(this, &Logfile::buildIndexInternal, mapped_file_, line_index_,
+                                             cancel_token_);
     index_watcher_.setFuture(future);
 }
 
@@ -77,66 +132,249 @@ bool Logfile::isInitialized() const
 }
 
 
-// Internal blocking function to build the index (runs in background thread)
-bool Logfile::buildIndexInternal()
+namespace
 {
-    // Note: This function runs in a background thread.
-    // Do NOT interact with GUI elements directly. Use signals to communicate.
-    // QFile operations should be safe if the QFile object is not accessed
-    // concurrently from other threads (which it shouldn't be here).
 
-    line_index_.clear(); // Ensure it's clear before starting
-    if (!file_.seek(0)) {
-        qWarning("Failed to seek to beginning of file for indexing.");
-        return false; // Return failure
-    }
+const qint64 kIndexRangeSize = 32 * 1024 * 1024; // Bytes scanned by one indexing task
+const qint64 kIndexReadSize = 1024 * 1024;       // Read buffer used inside a range
+const qint64 kIndexBatchSize = 64 * 1024;        // Offsets collected before copying into the result
+
+// Line starts found in one byte range of the file
+struct RangeScan
+{
+    QVector<qint64> offsets;
+    bool ok = false;
+};
 
-    line_index_.append(0); // First line always starts at 0
+// Copies a batch of offsets to the end of a range result
+void appendOffsets(QVector<qint64>& offsets, const qint64* batch, qint64 count)
+{
+    const int oldSize = offsets.size();
+    offsets.resize(oldSize + static_cast<int>(count));
+    std::memcpy(offsets.data() + oldSize, batch, static_cast<size_t>(count) * sizeof(qint64));
+}
+
+// Scans [begin, end) of a buffer that starts at file offset baseOffset
+void scanBuffer(const char* data, qint64 length, qint64 baseOffset, std::vector<qint64>& batch,
+                QVector<qint64>& offsets)
+{
+    qint64 scanned = 0;
+    while (scanned < length) {
+        qint64 found = 0;
+        scanned += simd::NewlineScanner::scan(data + scanned, length - scanned, baseOffset + scanned,
+                                              batch.data(), static_cast<qint64>(batch.size()), &found);
+        appendOffsets(offsets, batch.data(), found);
+    }
+}
 
-    const qint64 bufferSize = 1024 * 1024; // 1MB buffer
-    QByteArray buffer;
-    qint64 currentPos = 0;
-    qint64 fileSize = file_.size(); // Get total size for progress calculation
-    int lastPercent = -1; // Track last emitted percentage
+// Scans [begin, end) and collects the offset following every '\n'. Runs as an indexing task.
+// Mapped files are scanned in place; otherwise the range opens its own QFile, so any number
+// of ranges can still be read at the same time. A cancelled scan stops after the current
+// read block and fails.
+RangeScan scanRange(const MappedFile& file, qint64 begin, qint64 end,
+                    const std::function<void(qint64)>& onBytesScanned, const CancellationToken& cancel)
+{
+    RangeScan result;
+    std::vector<qint64> batch(static_cast<size_t>(kIndexBatchSize));
+
+    if (file.isMapped()) {
+        file.advise(begin, end, MappedFile::Access::Sequential);
+        for (qint64 pos = begin; pos < end; pos += kIndexReadSize) {
+            if (cancel.isCancelled()) {
+                return result;
+            }
+            const qint64 len = qMin(kIndexReadSize, end - pos);
+            scanBuffer(file.data() + pos, len, pos, batch, result.offsets);
+            onBytesScanned(len);
+            TaskScheduler::yieldToUrgentWork(); // Screens and filters being looked at go first
+        }
+        file.advise(begin, end, MappedFile::Access::Random); // Back to viewport access
+        result.ok = true;
+        return result;
+    }
 
-    while (!file_.atEnd()) {
-        // Optional: Cancellation check could be added here using index_watcher_.isCanceled()
+    QFile localFile(file.fileName());
+    if (!localFile.open(QIODevice::ReadOnly) || !localFile.seek(begin)) {
+        qWarning("Indexing: failed to read %s at offset %lld", qPrintable(file.fileName()), begin);
+        return result;
+    }
 
-        buffer = file_.read(bufferSize);
-        if (buffer.isEmpty() && !file_.atEnd()) {
-            // Error reading or EOF reached unexpectedly
-             qWarning("Error reading file during indexing.");
-             line_index_.clear();
-             return false;
+    std::vector<char> buffer(static_cast<size_t>(kIndexReadSize));
+    qint64 pos = begin;
+    while (pos < end) {
+        if (cancel.isCancelled()) {
+            return result;
         }
-        if (buffer.isEmpty()) break; // Normal EOF
-
-        const char* data = buffer.constData();
-        int len = buffer.size();
-        for (int i = 0; i < len; ++i) {
-            if (data[i] == '\n') {
-                qint64 nextLinePos = currentPos + i + 1;
-                if (nextLinePos < fileSize) {
-                     line_index_.append(nextLinePos);
-                }
+        const qint64 len = localFile.read(buffer.data(), qMin(kIndexReadSize, end - pos));
+        if (len <= 0) {
+            qWarning("Indexing: unexpected end of %s at offset %lld", qPrintable(file.fileName()), pos);
+            return result;
+        }
+        scanBuffer(buffer.data(), len, pos, batch, result.offsets);
+        pos += len;
+        onBytesScanned(len);
+        TaskScheduler::yieldToUrgentWork();
+    }
+
+    result.ok = true;
+    return result;
+}
+
+// Prepares an index covering the first indexedSize bytes for lines found after that: if
+// those bytes ended with '\n', the start of the (then empty) line after it was left out.
+bool continueIndexAt(const MappedFile& file, LineIndex& lineIndex, qint64 indexedSize)
+{
+    if (indexedSize > 0 && indexedSize < file.size()
+        && file.bytes(indexedSize - 1, indexedSize) == "\n") {
+        return lineIndex.append(indexedSize);
+    }
+    return true;
+}
+
+// Appends the lines after the one starting at begin, which must be the last line in the
+// index. Runs as an indexing task.
+bool appendLinesFrom(const MappedFile& file, LineIndex& lineIndex, qint64 begin, const CancellationToken& cancel)
+{
+    const qint64 fileSize = file.size();
+    const RangeScan range = scanRange(file, begin, fileSize, [](qint64) {}, cancel);
+    if (!range.ok) {
+        return false;
+    }
+    int count = range.offsets.size();
+    if (count > 0 && range.offsets.last() >= fileSize) {
+        --count; // Trailing '\n', see buildIndexInternal()
+    }
+    return lineIndex.append(range.offsets.constData(), count);
+}
+
+// Follow mode: appends the lines starting in [indexedSize, file.size()). Runs as an indexing task.
+bool extendIndex(const MappedFile& file, LineIndex& lineIndex, qint64 indexedSize, const CancellationToken& cancel)
+{
+    return continueIndexAt(file, lineIndex, indexedSize) && appendLinesFrom(file, lineIndex, indexedSize, cancel);
+}
+
+// True if the bytes before the checkpoint's line are unchanged in file
+template <typename Checkpoint>
+bool checkpointMatches(const MappedFile& file, const Checkpoint& checkpoint)
+{
+    return checkpoint.offset <= file.size()
+        && file.fingerprint(checkpoint.offset - kCheckpointWindow, checkpoint.offset) == checkpoint.hash;
+}
+
+}  // namespace
+
+// Internal blocking function to build the index (runs in background thread)
+bool Logfile::buildIndexInternal(std::shared_ptr<MappedFile> mappedFile, std::shared_ptr<LineIndex> lineIndex,
+                                 CancellationToken cancel)
+{
+    // Note: This function runs in a background thread.
+    // Do NOT interact with GUI elements directly. Use signals to communicate.
+    // The file is split into fixed byte ranges which are scanned in parallel as indexing
+    // tasks of the TaskScheduler; results are merged here strictly in file order, and every
+    // merged range is announced with linesIndexed() so the view can show it right away.
+    // This thread only waits and merges, so it's not a scheduler thread itself: those may
+    // not wait for tasks.
+
+    const qint64 fileSize = mappedFile->size(); // Get total size for progress calculation
+
+    // Reuse the sidecar index of an earlier session; if the file has grown since, only the
+    // new bytes are scanned
+    qint64 scanStart = 0;
+    if (fileSize >= IndexCache::kMinFileSize && IndexCache::load(*mappedFile, *lineIndex, &scanStart)) {
+        qInfo("Loaded cached index of %s: %lld lines, %lld of %lld bytes", qPrintable(filename_),
+              lineIndex->size(), scanStart, fileSize);
+        continueIndexAt(*mappedFile, *lineIndex, scanStart);
+        emit linesIndexed(lineIndex->size() - 1);
+    } else {
+        lineIndex->append(0); // First line always starts at 0
+        scanStart = 0;
+    }
+    const qint64 scanSize = fileSize - scanStart;
+
+    // Progress is aggregated over all ranges; whichever task crosses a percent boundary emits it
+    std::atomic<qint64> bytesScanned{0};
+    std::atomic<int> lastPercent{-1};
+    const std::function<void(qint64)> reportProgress = [this, scanSize, &bytesScanned, &lastPercent](qint64 bytes) {
+        const qint64 done = bytesScanned.fetch_add(bytes) + bytes;
+        const int percent = (scanSize > 0) ? static_cast<int>((done * 100) / scanSize) : 100;
+        int last = lastPercent.load();
+        while (percent > last) {
+            if (lastPercent.compare_exchange_weak(last, percent)) {
+                emit indexingProgress(percent); // Signal progress
+                break;
             }
         }
-        currentPos += len;
+    };
+
+    // Keep a bounded number of ranges in flight, so finished but not yet merged results
+    // can't pile up in memory while an earlier range is still being read
+    const qint64 rangeCount = (scanSize + kIndexRangeSize - 1) / kIndexRangeSize;
+    const int maxInFlight = qMax(2, TaskScheduler::instance().threadCount() * 2);
+    std::deque<QFuture<RangeScan>> pending;
+    qint64 nextRange = 0;
+    bool ok = true;
+    bool truncated = false;
+
+    while (nextRange < rangeCount || !pending.empty()) {
+        while (ok && nextRange < rangeCount && static_cast<int>(pending.size()) < maxInFlight) {
+            const qint64 begin = scanStart + nextRange * kIndexRangeSize;
+            const qint64 end = qMin(begin + kIndexRangeSize, fileSize);
+            pending.push_back(TaskScheduler::instance().run(TaskClass::Indexing, cancel,
+                                                            [mappedFile, begin, end, &reportProgress, &cancel]() {
+                return scanRange(*mappedFile, begin, end, reportProgress, cancel);
+            }));
+            ++nextRange;
+        }
+        if (pending.empty()) break;
+
+        // A range dropped after a cancel reports a failed scan
+        const RangeScan range = pending.front().result();
+        pending.pop_front();
+        if (!ok) continue; // Only draining the remaining tasks after a failure
+        if (cancel.isCancelled()) {
+            ok = false; // Queued ranges see the token too and return right away
+            continue;
+        }
+        if (!range.ok) {
+            qWarning("Error reading file during indexing.");
+            ok = false;
+            continue;
+        }
 
-        // Update progress (emit signal only when percentage changes)
-        int percent = (fileSize > 0) ? static_cast<int>((currentPos * 100) / fileSize) : 100;
-        if (percent != lastPercent) {
-            emit indexingProgress(percent); // Signal progress
-            lastPercent = percent;
+        // A trailing '\n' doesn't start another line, so the final offset may be dropped
+        int count = range.offsets.size();
+        if (count > 0 && range.offsets.last() >= fileSize) {
+            --count;
+        }
+        if (!lineIndex->append(range.offsets.constData(), count)) {
+            qWarning("Indexing: %s has more than %lld lines, the rest is not shown.",
+                     qPrintable(filename_), LineIndex::kMaxLines);
+            ok = false; // Index is still usable, just drain the remaining tasks
+            truncated = true;
         }
+        // The last line's end is only known once the next range is in
+        emit linesIndexed(lineIndex->size() - 1);
+    }
+
+    if (cancel.isCancelled()) {
+        qInfo("Indexing of %s cancelled", qPrintable(filename_));
+        return false;
+    }
+    if (!ok && !truncated) {
+        return false;
     }
 
     // Ensure final progress is 100% if loop finished normally
-    if (lastPercent != 100) {
+    if (lastPercent.load() != 100) {
         emit indexingProgress(100);
     }
 
-    qInfo("Indexed %lld lines for file %s", line_index_.size(), qPrintable(filename_));
+    qInfo("Indexed %lld lines for file %s in %lld ranges (%s scanner, %lld KiB index)", lineIndex->size(),
+          qPrintable(filename_), rangeCount,
+          simd::NewlineScanner::kernelName(simd::NewlineScanner::activeKernel()),
+          lineIndex->memoryUsage() / 1024);
+
+    index_needs_save_ = !truncated && rangeCount > 0 && fileSize >= IndexCache::kMinFileSize;
     return true; // Indexing completed successfully
 }
 
@@ -147,24 +385,50 @@ void Logfile::handleIndexFinished()
 
     if (success) {
         qInfo("Background indexing finished successfully for %s.", qPrintable(filename_));
-        // Initialize models now that indexing is complete
-        grep_hierarchy_ = std::make_unique<GrepNode>();
-        bookmarks_model_ = std::make_unique<BookmarksModel>(this); // Pass parent
-        connect_events(); // Connect signals from models
+        // Initialize models now that indexing is complete; a rescanned file keeps the user's
+        if (!reindexing_) {
+            grep_hierarchy_ = std::make_unique<GrepNode>();
+            bookmarks_model_ = std::make_unique<BookmarksModel>(this); // Pass parent
+            connect_events(); // Connect signals from models
+        }
+
+        if (index_needs_save_) {
+            // Write the sidecar off the GUI thread, whenever nothing else is waiting; the task
+            // keeps its own references. Following may append to the index before the task runs,
+            // so the line count matching the file size is taken now.
+            std::shared_ptr<const MappedFile> file = mapped_file_;
+            std::shared_ptr<const LineIndex> index = line_index_;
+            const qint64 lineCount = index->size();
+            TaskScheduler::instance().run(TaskClass::Prefetch, [file, index, lineCount]() {
+                if (IndexCache::save(*file, file->size(), lineCount, *index)) {
+                    IndexCache::prune();
+                }
+            });
+        }
     } else {
         qWarning("Background indexing failed or was cancelled for %s.", qPrintable(filename_));
-        // Ensure models are null if indexing failed
-        grep_hierarchy_.reset();
-        bookmarks_model_.reset();
-        // Ensure file is closed if it was opened but indexing failed
-        if (file_.isOpen()) {
-            file_.close();
+        // Ensure models are null if indexing failed, unless views already show them
+        if (!reindexing_) {
+            grep_hierarchy_.reset();
+            bookmarks_model_.reset();
         }
+        // Release the mapping if it was opened but indexing failed
+        mapped_file_.reset();
     }
 
+    reindexing_ = false;
     initialized_ = success; // Update initialization state
+    visible_lines_ = success ? line_index_->size() : 0;
+    if (success) {
+        updateCheckpoints();
+    }
+    emit linesIndexed(getLineCount()); // Now includes the last line, or drops everything on failure
     emit indexingFinished(success); // Signal completion status
     emit initializedChanged(); // Signal state change
+
+    if (success) {
+        checkForChanges(); // Catch up with whatever was written while indexing
+    }
 }
 
 
@@ -190,97 +454,247 @@ const QString& Logfile::getFileName() const
 
 qint64 Logfile::getLineCount() const
 {
-    // Return the number of lines found during indexing.
-    // This will be 0 until indexing is complete.
-    return initialized_ ? line_index_.size() : 0;
+    // Lines are available as soon as the indexing task publishes them. While it still runs,
+    // the last line found so far has no known end yet and is left out.
+    if (!mapped_file_) {
+        return 0;
+    }
+    if (initialized_) {
+        return visible_lines_;
+    }
+    return qMax<qint64>(0, line_index_->size() - 1);
 }
 
-// Added getter implementation
-QVector<qint64> Logfile::getLineIndexCopy() const
+std::shared_ptr<const LineIndex> Logfile::getLineIndex() const
 {
-    // Return copy only if initialized
-    return initialized_ ? line_index_ : QVector<qint64>();
+    // Every line below getLineCount() is in the index, also while indexing still runs
+    return line_index_;
 }
 
-Line Logfile::getLine(qint64 line_number) const
+void Logfile::setFollowing(bool following)
 {
-    // Ensure initialized and line number is valid
-    if (!initialized_ || line_number < 1 || line_number > line_index_.size() || !file_.isOpen()) {
-        return {line_number, QString()}; // Return empty line
+    if (following == following_) {
+        return;
     }
+    following_ = following;
+    if (following_) {
+        checkForChanges();
+    }
+    emit followingChanged(following_);
+}
 
-    // Check cache first (thread-safe access to QCache is handled internally by Qt)
-    if (QString* cachedLine = line_cache_.object(line_number)) {
-        return {line_number, *cachedLine}; // Cache hit!
+void Logfile::watchFile()
+{
+    if (!file_watcher_) {
+        file_watcher_ = new QFileSystemWatcher(this);
+        // Notifications only start the coalescing timer; a running one is left alone so a
+        // steady stream of writes still gets checked every kChangeCoalesceMs
+        connect(file_watcher_, &QFileSystemWatcher::fileChanged, this, [this]() {
+            if (!change_timer_.isActive()) {
+                change_timer_.start();
+            }
+        });
+    }
+    // The watch ends with the file it was set on, a rotated log is watched anew
+    if (!file_watcher_->files().contains(filename_) && !file_watcher_->addPath(filename_)) {
+        qWarning("Unable to watch %s for changes", qPrintable(filename_));
     }
+}
 
-    // Cache miss, proceed to read from file
-    // IMPORTANT: File I/O (seek, readLine) should ideally happen in a separate
-    // thread if this getLine() can be called frequently from the GUI thread
-    // causing stutters. This is the primary performance bottleneck to address later.
-    // The const_cast below is necessary because QFile::seek/readLine are not declared const,
-    // even though we are only reading from the file in this const method.
-    qint64 start_pos = line_index_[line_number - 1];
+bool Logfile::isFollowing() const
+{
+    return following_;
+}
 
-    // --- Read-Ahead Caching ---
-    const int READ_AHEAD_COUNT = 50; // How many lines to read ahead
-    qint64 current_read_pos = start_pos;
-    // const_cast needed because QFile::seek is not const
-    if (!const_cast<QFile&>(file_).seek(current_read_pos)) {
-         qWarning("Failed to seek to position %lld for line %lld", current_read_pos, line_number);
-         return {line_number, QString()}; // Seek failed
+void Logfile::checkForChanges()
+{
+    if (!initialized_ || !mapped_file_) {
+        return; // Indexing still running; handleIndexFinished() checks again
+    }
+    if (extend_watcher_.isRunning()) {
+        change_recheck_ = true;
+        return;
     }
+    change_timer_.setInterval(kChangeCoalesceMs);
 
-    QString line_text_to_return; // Store the specifically requested line
+    const QFileInfo info(filename_);
+    if (!info.exists()) {
+        // Rotated away and not recreated yet; the old contents stay until it is
+        change_timer_.start(kMissingFileRetryMs);
+        return;
+    }
+    watchFile();
+
+    const qint64 indexedSize = mapped_file_->size();
+    const qint64 currentSize = info.size();
+    const quint64 currentId = MappedFile::fileIdOf(filename_);
+    const bool replaced = currentId != 0 && mapped_file_->fileId() != 0 && currentId != mapped_file_->fileId();
+    const qint64 currentMtime = info.lastModified().toMSecsSinceEpoch();
+    if (!replaced && currentSize == indexedSize && currentMtime == checked_mtime_) {
+        return; // Untouched since the last look
+    }
+    checked_mtime_ = currentMtime;
 
-    for (int i = 0; i < READ_AHEAD_COUNT; ++i) {
-        qint64 current_line_num = line_number + i;
-        // Stop if we go past the known number of lines
-        if (current_line_num > line_index_.size()) {
-            break;
-        }
-        // Stop if we are trying to read a line already in cache (implies we caught up)
-        if (i > 0 && line_cache_.contains(current_line_num)) {
-             break;
-        }
+    // Readers keep using the old mapping until the changed lines are indexed
+    QString errorString;
+    std::shared_ptr<MappedFile> current = MappedFile::open(filename_, &errorString);
+    if (!current) {
+        qWarning("Unable to reopen %s after it changed: %s", qPrintable(filename_), qPrintable(errorString));
+        return;
+    }
 
-        // const_cast needed because QFile::readLine is not const
-        QByteArray line_data = const_cast<QFile&>(file_).readLine();
-        if (line_data.isNull()) { // Check for read error or EOF
-             break;
-        }
+    // Plain appends leave the indexed bytes alone. A file truncated and written again up to or
+    // past its old size (copytruncate rotation) looks just like one by its size, the
+    // fingerprints tell them apart. They're compared whether following or not: a rewrite has
+    // to be picked up either way, only indexing appended lines waits for follow mode.
+    const bool appended = !replaced && current->size() >= indexedSize
+        && current->fingerprint(indexedSize - kCheckpointWindow, indexedSize) == end_fingerprint_
+        && std::all_of(checkpoints_.begin(), checkpoints_.end(), [&current](const IndexCheckpoint& checkpoint) {
+               return checkpointMatches(*current, checkpoint);
+           });
+    if (appended && (current->size() == indexedSize || !following_)) {
+        return; // Only touched, or grown while nobody asked for the new lines
+    }
+    if (appended) {
+        extend_file_ = current;
+        extend_index_ = line_index_;
+        std::shared_ptr<LineIndex> lineIndex = line_index_;
+        const CancellationToken cancel = cancel_token_;
+        extend_watcher_.setFuture(TaskScheduler::instance().run(TaskClass::Indexing, cancel,
+                                                                [current, lineIndex, indexedSize, cancel]() {
+            return extendIndex(*current, *lineIndex, indexedSize, cancel);
+        }));
+        return;
+    }
 
-        QString line_text = QString::fromUtf8(line_data).trimmed();
+    qInfo("%s was %s, reindexing changed lines", qPrintable(filename_),
+          replaced ? "replaced" : "truncated or rewritten");
+    reindexChangedFile(current);
+}
 
-        // Store the requested line separately
-        if (i == 0) {
-            line_text_to_return = line_text;
-        }
+// Rebuilds the index for a file whose indexed bytes changed. Lines before the last checkpoint
+// that still matches are kept and only what follows is scanned again.
+void Logfile::reindexChangedFile(std::shared_ptr<MappedFile> current)
+{
+    // Nothing after the first mismatch can be trusted, even if a later checkpoint matches
+    size_t matching = 0;
+    while (matching < checkpoints_.size() && checkpointMatches(*current, checkpoints_[matching])) {
+        ++matching;
+    }
+    checkpoints_.resize(matching);
+    line_cache_.clear();
+
+    if (matching == 0) {
+        // Nothing to keep: rescan the whole file, keeping the filters and bookmarks set up on it
+        qInfo("Rescanning %s from the start", qPrintable(filename_));
+        mapped_file_ = current;
+        line_index_ = std::make_shared<LineIndex>();
+        initialized_ = false;
+        reindexing_ = true;
+        visible_lines_ = 0;
+        end_fingerprint_ = 0;
+        emit linesIndexed(0);
+        emit initializedChanged();
+        index_watcher_.setFuture(QtConcurrent::run(this, &Logfile::buildIndexInternal, mapped_file_, line_index_,
+                                                   cancel_token_));
+        return;
+    }
 
-        // Add to cache only if not already there (QCache::insert replaces)
-        // Use cost 1 per line. QCache takes ownership of the new QString.
-        if (!line_cache_.contains(current_line_num)) {
-             line_cache_.insert(current_line_num, new QString(line_text), 1);
-        }
+    // The kept lines share their storage with the old index, which readers may still hold
+    const IndexCheckpoint resume = checkpoints_.back();
+    std::shared_ptr<LineIndex> kept = std::make_shared<LineIndex>();
+    kept->sharePrefix(*line_index_, resume.line);
+    if (resume.offset < current->size()) {
+        kept->append(resume.offset); // The first line to rescan, see continueIndexAt()
+    }
+    qInfo("Keeping %lld lines of %s, rescanning from offset %lld", resume.line, qPrintable(filename_),
+          resume.offset);
+
+    mapped_file_ = current;
+    line_index_ = kept;
+    visible_lines_ = resume.line;
+    emit linesRemoved(resume.line);
+
+    extend_file_ = current;
+    extend_index_ = kept;
+    const qint64 begin = resume.offset;
+    const CancellationToken cancel = cancel_token_;
+    extend_watcher_.setFuture(TaskScheduler::instance().run(TaskClass::Indexing, cancel,
+                                                            [current, kept, begin, cancel]() {
+        return appendLinesFrom(*current, *kept, begin, cancel);
+    }));
+}
+
+// Fingerprints the indexed bytes: one checkpoint per chunk of lines not covered yet, and
+// the end of the mapped file
+void Logfile::updateCheckpoints()
+{
+    qint64 line = checkpoints_.empty() ? LineIndex::kChunkLines : checkpoints_.back().line + LineIndex::kChunkLines;
+    for (; line < visible_lines_; line += LineIndex::kChunkLines) {
+        const qint64 offset = line_index_->at(line);
+        checkpoints_.push_back({line, offset, mapped_file_->fingerprint(offset - kCheckpointWindow, offset)});
+    }
+    const qint64 size = mapped_file_->size();
+    end_fingerprint_ = mapped_file_->fingerprint(size - kCheckpointWindow, size);
+}
+
+void Logfile::handleExtendFinished()
+{
+    const std::shared_ptr<MappedFile> grown = std::move(extend_file_);
+    const std::shared_ptr<LineIndex> extended = std::move(extend_index_);
+    if (!grown || extended != line_index_ || !initialized_) {
+        return; // A different file was opened meanwhile
+    }
+    if (!extend_watcher_.result()) {
+        qWarning("Failed to index changed data of %s", qPrintable(filename_));
+        return;
+    }
+
+    const qint64 previousLines = visible_lines_;
+    mapped_file_ = grown;
+    visible_lines_ = line_index_->size();
+    updateCheckpoints();
+    // The previous last line may have been incomplete and gained text
+    line_cache_.remove(previousLines);
+    emit linesIndexed(visible_lines_);
+
+    if (change_recheck_) {
+        change_recheck_ = false;
+        checkForChanges();
+    }
+}
+
+std::shared_ptr<const MappedFile> Logfile::getMappedFile() const
+{
+    return mapped_file_;
+}
 
-        // Note: readLine() advances the file pointer, so manually updating current_read_pos is not needed.
+QByteArray Logfile::getLineBytes(qint64 line_number) const
+{
+    if (line_number < 1 || line_number > getLineCount()) {
+        return QByteArray();
     }
+    const qint64 begin = line_index_->at(line_number - 1);
+    const qint64 end = line_index_->lineEnd(line_number - 1, mapped_file_->size());
+    return mapped_file_->bytes(begin, end);
+}
 
-    // Ensure the originally requested line was actually read and cached
-    // (It should have been if i == 0 loop ran)
-    if (line_text_to_return.isNull()) {
-         // This might happen if the file ends exactly at the start_pos
-         // or if readLine immediately returned null. Re-check cache just in case.
-         if (QString* cachedLine = line_cache_.object(line_number)) {
-             return {line_number, *cachedLine};
-         } else {
-              qWarning("Failed to read line %lld even after attempt.", line_number);
-              return {line_number, QString()}; // Read failed
-         }
+Line Logfile::getLine(qint64 line_number) const
+{
+    // Ensure initialized and line number is valid
+    if (line_number < 1 || line_number > getLineCount()) {
+        return {line_number, QString()}; // Return empty line
     }
 
+    // The cache holds decoded lines and is only touched from the GUI thread
+    if (QString* cachedLine = line_cache_.object(line_number)) {
+        return {line_number, *cachedLine}; // Cache hit!
+    }
 
-    return {line_number, line_text_to_return};
+    // Cache miss: decode straight from the mapped bytes, no seek/read involved
+    QString line_text = QString::fromUtf8(getLineBytes(line_number)).trimmed();
+    line_cache_.insert(line_number, new QString(line_text), 1);
+    return {line_number, line_text};
 }
 
 
@@ -317,92 +731,68 @@ void Logfile::bookmarks_model_changed()
 // Public slot to trigger background cache population
 void Logfile::requestCachePopulation(qint64 centerLine, int contextLines)
 {
-   if (!initialized_ || cache_watcher_.isRunning()) {
-       // Don't start a new task if not initialized or if one is already running
+   if (!mapped_file_ || contextLines <= 0) {
        return;
    }
 
-   // Calculate the range to cache (e.g., centerLine +/- contextLines/2)
-   qint64 startLine = qMax(1LL, centerLine - (contextLines / 2));
-   int count = contextLines;
-
-   // Launch the population task in the background
-   // Use a lambda to capture necessary arguments by value/reference safely
-   // Note: 'this' pointer capture is generally safe for member functions if object lifetime is managed.
-   QFuture<void> future = QtConcurrent::run([this, startLine, count]() {
-       this->populateCacheInBackground(startLine, count);
-   });
-
-   // Monitor the future (optional, could be used for cancellation or progress)
-   cache_watcher_.setFuture(future);
+   // The view moved on: what the previous request hasn't read yet is no longer needed
+   view_cancel_.cancel();
+   view_cancel_ = CancellationToken();
+
+   // The screen itself (the middle third of the context) is read at viewport priority, the
+   // lines around it are speculative and wait for all other work. Both are clamped to the
+   // lines available so far.
+   const qint64 lineCount = getLineCount();
+   const qint64 startLine = qMax(1LL, centerLine - (contextLines / 2));
+   const qint64 endLine = qMin(startLine + contextLines - 1, lineCount);
+   if (endLine < startLine) {
+       return;
+   }
+   const qint64 screenStart = qBound(startLine, centerLine - (contextLines / 6), endLine);
+   const qint64 screenEnd = qBound(screenStart, centerLine + (contextLines / 6), endLine);
+
+   // Byte ranges are resolved here, so the tasks don't touch members the GUI thread may replace
+   std::shared_ptr<const MappedFile> mappedFile = mapped_file_;
+   const CancellationToken cancel = view_cancel_;
+   auto byteRange = [this, &mappedFile](qint64 first, qint64 last) {
+       return std::make_pair(line_index_->at(first - 1), line_index_->lineEnd(last - 1, mappedFile->size()));
+   };
+   const auto screen = byteRange(screenStart, screenEnd);
+   const auto context = byteRange(startLine, endLine);
+
+   viewport_watcher_.setFuture(TaskScheduler::instance().run(TaskClass::Viewport, cancel,
+                                                             [mappedFile, screen, cancel]() {
+       populateCacheInBackground(*mappedFile, screen.first, screen.second, cancel);
+   }));
+   cache_watcher_.setFuture(TaskScheduler::instance().run(TaskClass::Prefetch, cancel,
+                                                          [mappedFile, context, cancel]() {
+       populateCacheInBackground(*mappedFile, context.first, context.second, cancel);
+   }));
 }
 
 
-// Runs in a background thread to populate the line cache
-void Logfile::populateCacheInBackground(qint64 startLine, int count)
+// Runs in a background thread: faults in the pages around the viewport, so the getLine()
+// calls that follow on the GUI thread don't block on disk. The decoded-line cache itself is
+// left to the GUI thread.
+void Logfile::populateCacheInBackground(const MappedFile& mappedFile, qint64 begin, qint64 end,
+                                        const CancellationToken& cancel)
 {
-    // Ensure the file is open and initialized (basic checks)
-    // Note: This runs in a background thread, avoid GUI interactions.
-    if (!initialized_ || !file_.isOpen() || count <= 0) {
-        return;
-    }
-
-    // Create a thread-local file object to avoid concurrent access issues
-    // with the main thread's file_ object if getLine is called simultaneously.
-    QFile localFile(filename_);
-    if (!localFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        qWarning("Cache thread: Failed to open file %s", qPrintable(filename_));
-        return;
-    }
-
-    qint64 endLine = qMin(startLine + count - 1, getLineCount()); // Clamp to actual line count
-    startLine = qMax(1LL, startLine); // Ensure startLine is at least 1
-
-    // Iterate through the requested range
-    for (qint64 currentLineNum = startLine; currentLineNum <= endLine; ++currentLineNum) {
-        // Check if the line is already in the cache (thread-safe check)
-        if (line_cache_.contains(currentLineNum)) {
-            continue; // Skip if already cached
-        }
-
-        // Check for cancellation request (if cache_watcher_ is used for cancellation)
-        // if (cache_watcher_.isCanceled()) {
-        //     qDebug() << "Cache population cancelled.";
-        //     localFile.close();
-        //     return;
-        // }
-
-        // Get the starting position from the index
-        if (currentLineNum - 1 >= line_index_.size()) {
-            qWarning("Cache thread: Line number %lld out of index bounds.", currentLineNum);
-            continue; // Should not happen if endLine is clamped correctly
-        }
-        qint64 start_pos = line_index_[currentLineNum - 1];
-
-        // Seek and read the line using the thread-local file object
-        if (!localFile.seek(start_pos)) {
-            qWarning("Cache thread: Failed to seek to position %lld for line %lld", start_pos, currentLineNum);
-            continue; // Skip this line on seek error
-        }
-
-        QByteArray line_data = localFile.readLine();
-        if (line_data.isNull()) {
-            // Read error or unexpected EOF
-            qWarning("Cache thread: Failed to read line %lld.", currentLineNum);
-            continue; // Skip this line
-        }
-
-        // Convert and trim the line
-        QString line_text = QString::fromUtf8(line_data).trimmed();
-
-        // Insert into cache (thread-safe operation)
-        // Check again before inserting in case another thread cached it between the check and now
-        if (!line_cache_.contains(currentLineNum)) {
-             // QCache takes ownership of the new QString
-             line_cache_.insert(currentLineNum, new QString(line_text), 1);
+    mappedFile.advise(begin, end, MappedFile::Access::WillNeed);
+
+    // Touch one byte per page in case the hint is ignored
+    if (mappedFile.isMapped()) {
+        const char* data = mappedFile.data();
+        volatile char sink = 0;
+        int pages = 0;
+        for (qint64 pos = begin; pos < end; pos += 4096) {
+            if ((++pages & 255) == 0) {
+                if (cancel.isCancelled()) {
+                    break; // Checked every MiB; each page touched may wait on the disk
+                }
+                TaskScheduler::yieldToUrgentWork();
+            }
+            sink = data[pos];
         }
+        Q_UNUSED(sink);
     }
-
-    localFile.close();
-    // qDebug() << "Cache population task finished for lines" << startLine << "to" << endLine;
 }
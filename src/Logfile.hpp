@@ -2,6 +2,7 @@
 #define LOGFILE_HPP
 
 #include <memory>
+#include <vector>
 
 #include <QFile>
 #include <QMessageBox>
@@ -11,12 +12,18 @@
 #include <QCache> // Added for line caching
 #include <QtConcurrent/QtConcurrent> // Added for background tasks
 #include <QFutureWatcher> // Added to monitor background tasks
+#include <QTimer>
 
 #include "BookmarksModel.hpp"
+#include "CancellationToken.hpp"
 #include "GrepNode.hpp"
+#include "LineIndex.hpp"
+#include "MappedFile.hpp"
+#include "TaskScheduler.hpp"
 
 // Forward declarations
 namespace serializer { class Logfile; }
+class QFileSystemWatcher;
 class QProgressDialog;
 
 struct Line
@@ -34,7 +41,7 @@ class Logfile : public QObject
 public:
     // Constructor now takes parent, filename is set via initialize
     explicit Logfile(QObject* parent = nullptr);
-    ~Logfile(); // Destructor might need to wait for pending operations
+    ~Logfile(); // Cancels and waits for the background work on this file
 
     // Asynchronous initialization
     void initialize(const QString& filename);
@@ -42,9 +49,16 @@ public:
 
     // Accessors
     const QString& getFileName() const;
-    qint64 getLineCount() const; // Returns current count, might be 0 during indexing
+    qint64 getLineCount() const; // Lines indexed so far; grows while indexing runs
     Line getLine(qint64 line_number) const; // Line numbers typically 1-based
-    QVector<qint64> getLineIndexCopy() const; // Added getter for line index
+    QByteArray getLineBytes(qint64 line_number) const; // Zero-copy view of the raw line, including its '\n'
+    std::shared_ptr<const MappedFile> getMappedFile() const; // Shared read path for background readers
+    std::shared_ptr<const LineIndex> getLineIndex() const; // Shared, no copy; empty until initialized
+
+    // Follow mode: lines appended to the file are indexed and announced with linesIndexed().
+    // Truncation and replacement (log rotation) are picked up whether following or not.
+    void setFollowing(bool following);
+    bool isFollowing() const;
 
     // Models
     BookmarksModel* getBookmarksModel();
@@ -56,26 +70,63 @@ public:
 
 private:
     QString filename_;
-    QFile file_; // Keep the file open
-    QVector<qint64> line_index_; // Stores start position of each line
+    std::shared_ptr<MappedFile> mapped_file_; // Mapped file shared with all readers
+    std::shared_ptr<LineIndex> line_index_; // Stores start position of each line
     mutable QCache<qint64, QString> line_cache_; // Added cache (line number -> line text)
     bool initialized_ = false; // Flag to track completion
+    bool index_needs_save_ = false; // Set by the indexing task when the sidecar cache is out of date
+    qint64 visible_lines_ = 0; // Lines announced after indexing; trails line_index_ while it's extended
+
+    // Fingerprint of the bytes just before the start of a line, taken every
+    // LineIndex::kChunkLines lines. They tell how much of the index still holds when the
+    // file is rewritten under us.
+    struct IndexCheckpoint
+    {
+        qint64 line;
+        qint64 offset;
+        quint64 hash;
+    };
+    std::vector<IndexCheckpoint> checkpoints_; // Ascending
+    quint64 end_fingerprint_ = 0; // Fingerprint of the bytes before the end of mapped_file_
+    qint64 checked_mtime_ = 0; // mtime (ms since epoch) of the file when checkForChanges() last compared it
+
+    // Change detection and follow mode
+    QFileSystemWatcher* file_watcher_ = nullptr; // inotify & co., exists while a file is open
+    QTimer change_timer_; // Coalesces bursts of change notifications into one check
+    QFutureWatcher<bool> extend_watcher_; // Background indexing of appended or rewritten bytes
+    std::shared_ptr<MappedFile> extend_file_; // Mapping of the changed file used by that task
+    std::shared_ptr<LineIndex> extend_index_; // Index it appends to
+    bool following_ = false;
+    bool change_recheck_ = false; // The file changed again while extending
+    bool reindexing_ = false; // Full rescan of a rewritten file; models and views are kept
     QFutureWatcher<bool> index_watcher_; // To monitor the background indexing task
+    QFutureWatcher<void> viewport_watcher_; // Pages of the lines on screen
     QFutureWatcher<void> cache_watcher_; // To monitor background cache population tasks
+    CancellationToken cancel_token_; // Shared by all background work on the current file
+    CancellationToken view_cancel_; // Page reads of the last requestCachePopulation()
 
     // bool initialize(); // Original private helper removed
-    bool buildIndexInternal(); // Renamed internal blocking index builder
+    // Internal blocking index builder, fills lineIndex from the start of mappedFile
+    bool buildIndexInternal(std::shared_ptr<MappedFile> mappedFile, std::shared_ptr<LineIndex> lineIndex,
+                            CancellationToken cancel);
     void connect_events();
-    void populateCacheInBackground(qint64 startLine, int count); // Background cache population task
+    void watchFile();
+    void updateCheckpoints();
+    void reindexChangedFile(std::shared_ptr<MappedFile> current);
+    static void populateCacheInBackground(const MappedFile& mappedFile, qint64 begin, qint64 end,
+                                          const CancellationToken& cancel); // Background page prefetch task
 
     friend class serializer::Logfile;
 
 public slots: // Make this public so LogViewer/CustomLogView can trigger it
-    // Slot to request background population of the cache around a center line
+    // Slot to request background prefetch of the file pages around a center line: the middle
+    // third (the screen) at viewport priority, the rest speculatively. Replaces the last request.
     void requestCachePopulation(qint64 centerLine, int contextLines);
 
 private slots:
     void handleIndexFinished(); // Slot to react when background indexing is done
+    void checkForChanges(); // Indexes appended data when following, handles truncation and rotation
+    void handleExtendFinished();
     // Optional: Add a slot to handle cache watcher finished if needed
 
 protected slots:
@@ -85,8 +136,11 @@ protected slots:
 signals:
     void changed();
     void indexingProgress(int percent); // Signal for progress updates
+    void linesIndexed(qint64 lineCount); // More lines are available (emitted from the indexing thread); 0 on reset
+    void linesRemoved(qint64 firstLine); // Lines from firstLine (0-based) on changed on disk and are gone until reindexed
     void indexingFinished(bool success); // Signal when indexing is complete (success/failure)
     void initializedChanged(); // Signal when initialization state changes
+    void followingChanged(bool following);
 };
 
 #endif // LOGFILE_HPP
@@ -4,15 +4,21 @@
 #include <QFont> // Include QFont for setting monospace font
 #include <QDebug> // For potential debugging
 
+#include <limits>
+
 LogfileModel::LogfileModel(Logfile* logfile, QObject* parent)
     : QAbstractListModel(parent), logfile_(logfile)
 {
     if (!logfile_) {
         qWarning("LogfileModel created with a null Logfile pointer!");
         // Consider throwing an exception or handling this error appropriately
+        return;
     }
-    // Optional: Connect signals from logfile_ if it can change dynamically
-    // connect(logfile_, &Logfile::dataChangedSignal, this, &LogfileModel::handleDataChange);
+    // Rows appear while the file is still being indexed. The signal is queued from the
+    // indexing thread, so several batches may collapse into a single insert.
+    connect(logfile_, &Logfile::linesIndexed, this, &LogfileModel::handleLinesIndexed);
+    connect(logfile_, &Logfile::linesRemoved, this, &LogfileModel::handleLinesRemoved);
+    row_count_ = static_cast<int>(qMin<qint64>(logfile_->getLineCount(), std::numeric_limits<int>::max()));
 }
 
 int LogfileModel::rowCount(const QModelIndex &parent) const
@@ -23,8 +29,8 @@ int LogfileModel::rowCount(const QModelIndex &parent) const
         return 0;
     }
 
-    // Return the total number of lines in the log file
-    return static_cast<int>(logfile_->getLineCount()); // Cast qint64 to int
+    // Return the number of lines announced so far (rows are ints, the index is clamped)
+    return row_count_;
 }
 
 // --- New/Modified for TableView ---
@@ -69,7 +75,7 @@ QVariant LogfileModel::data(const QModelIndex &index, int role) const
     qint64 line_number = static_cast<qint64>(index.row()) + 1;
 
     // Check if the line number is within the valid range
-    if (line_number < 1 || line_number > logfile_->getLineCount()) {
+    if (line_number < 1 || line_number > row_count_) {
         return QVariant();
     }
 
@@ -129,9 +135,40 @@ void LogfileModel::resetModel()
 {
     // Call the protected methods to notify views about a major change
     beginResetModel();
+    row_count_ = logfile_ ? static_cast<int>(qMin<qint64>(logfile_->getLineCount(), std::numeric_limits<int>::max())) : 0;
     endResetModel();
 }
 
+void LogfileModel::handleLinesIndexed()
+{
+    // The signal's count may be stale by the time it's delivered; ask for the current one
+    const int lines = static_cast<int>(qMin<qint64>(logfile_->getLineCount(), std::numeric_limits<int>::max()));
+    if (lines >= row_count_ && row_count_ > 0) {
+        // When following a file, the last line may have been written only partially
+        const QModelIndex lastRow = index(row_count_ - 1, Column::MessageColumn);
+        emit dataChanged(lastRow, lastRow, {Qt::DisplayRole});
+    }
+    if (lines > row_count_) {
+        beginInsertRows(QModelIndex(), row_count_, lines - 1);
+        row_count_ = lines;
+        endInsertRows();
+    } else if (lines < row_count_) {
+        resetModel(); // A new file (or a failed one) replaces everything
+    }
+}
+
+void LogfileModel::handleLinesRemoved(qint64 firstLine)
+{
+    // Rows before firstLine are unchanged, so views keep their scroll position and selection
+    if (firstLine >= row_count_) {
+        return;
+    }
+    const int first = static_cast<int>(firstLine);
+    beginRemoveRows(QModelIndex(), first, row_count_ - 1);
+    row_count_ = first;
+    endRemoveRows();
+}
+
 // Optional: Implement handleDataChange if Logfile can be modified externally
 // void LogfileModel::handleDataChange() {
 //     beginResetModel(); // Or more specific signals like dataChanged, rowsInserted, etc.
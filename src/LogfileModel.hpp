@@ -36,8 +36,15 @@ public:
     // Public method to trigger a full model reset
     void resetModel();
 
+private slots:
+    // Picks up lines indexed since the last call with one batched rowsInserted
+    void handleLinesIndexed();
+    // Drops the rows of lines that changed on disk; they come back through handleLinesIndexed()
+    void handleLinesRemoved(qint64 firstLine);
+
 private:
     Logfile* logfile_; // Pointer to the actual log file data (non-owning)
+    int row_count_ = 0; // Rows announced to views so far; trails the Logfile while it indexes
 };
 
 #endif // LOGFILEMODEL_HPP
@@ -54,6 +54,7 @@ void MainWindow::closeFileTab(const int index)
 void MainWindow::connect_signals()
 {
     connect(ui->fileView, &QTabWidget::tabCloseRequested, this, &MainWindow::closeFileTab);
+    connect(ui->fileView, &QTabWidget::currentChanged, this, [this]() { updateMenus(); });
 }
 
 void MainWindow::newProject()
@@ -275,6 +276,27 @@ void MainWindow::on_actionSave_project_triggered()
 void MainWindow::updateMenus()
 {
     ui->actionSave_project->setEnabled(!pm_->project_name().isEmpty() && pm_->has_changed());
+
+    // Follow state belongs to the file of the current tab
+    FileViewer* viewer = get_active_viewer_widget();
+    ui->actionFollow_file->setEnabled(viewer && viewer->logfile_);
+    ui->actionFollow_file->setChecked(viewer && viewer->logfile_ && viewer->logfile_->isFollowing());
+
+    // Track changes made elsewhere (a file reloaded stops following) until the tab changes
+    disconnect(followConnection_);
+    if (viewer && viewer->logfile_) {
+        followConnection_ = connect(viewer->logfile_, &Logfile::followingChanged,
+                                    ui->actionFollow_file, &QAction::setChecked);
+    }
+}
+
+void MainWindow::on_actionFollow_file_triggered(bool checked)
+{
+    FileViewer* viewer = get_active_viewer_widget();
+    if (!viewer || !viewer->logfile_) {
+        return;
+    }
+    viewer->logfile_->setFollowing(checked);
 }
 
 void MainWindow::updateUi()
@@ -40,6 +40,7 @@ private slots:
     void on_actionSave_project_triggered();
     void on_actionLoad_project_triggered();
     void on_actionCustomHighlighting_triggered(); // Added slot for custom highlighting
+    void on_actionFollow_file_triggered(bool checked);
 
 private:
     void project_changed();
@@ -62,6 +63,7 @@ private:
     std::unique_ptr<ProjectUiManager> pm_{};
     Ui::MainWindow *ui{nullptr};
     QList<HighlightRule> m_highlightRules; // Added to store custom highlight rules
+    QMetaObject::Connection followConnection_; // Follow action <- following state of the current tab's file
 };
 
 #endif // MAINWINDOW_HPP
@@ -0,0 +1,293 @@
+#include "MappedFile.hpp"
+
+#include <QMutexLocker>
+
+#if defined(Q_OS_UNIX)
+#include <atomic>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#elif defined(Q_OS_WIN)
+#include <QDir>
+#include <windows.h>
+#endif
+
+namespace
+{
+
+#if defined(Q_OS_UNIX)
+
+// Mappings the SIGBUS handler may repair. Slots are claimed and released under
+// guardMutex(); the handler only reads them, end first, so a slot being filled in or
+// released never matches.
+const int kMaxGuardedMappings = 1024;
+
+struct GuardedRange
+{
+    std::atomic<quintptr> begin{0};
+    std::atomic<quintptr> end{0}; // 0 while the slot is free
+};
+
+GuardedRange guardedRanges[kMaxGuardedMappings];
+quintptr guardPageSize = 4096;
+struct sigaction previousBusAction;
+
+QMutex& guardMutex()
+{
+    static QMutex mutex;
+    return mutex;
+}
+
+// Reads of mapped pages past the end of a truncated file land here. The page is replaced by
+// an anonymous zero page and the faulting read is retried on return. mmap() isn't on the
+// POSIX list of async-signal-safe functions, but on the systems we run on it's a plain
+// system call that is safe to make here.
+void handleBusError(int signalNumber, siginfo_t* info, void* context)
+{
+    const quintptr address = reinterpret_cast<quintptr>(info->si_addr);
+    for (const GuardedRange& range : guardedRanges) {
+        const quintptr end = range.end.load(std::memory_order_acquire);
+        if (address < end && address >= range.begin.load(std::memory_order_relaxed)) {
+            void* page = reinterpret_cast<void*>(address & ~(guardPageSize - 1));
+            if (mmap(page, guardPageSize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != MAP_FAILED) {
+                return;
+            }
+            break;
+        }
+    }
+
+    // Not one of ours: whatever would have happened without this handler
+    if (previousBusAction.sa_flags & SA_SIGINFO) {
+        previousBusAction.sa_sigaction(signalNumber, info, context);
+    } else if (previousBusAction.sa_handler != SIG_DFL && previousBusAction.sa_handler != SIG_IGN) {
+        previousBusAction.sa_handler(signalNumber);
+    } else {
+        signal(SIGBUS, SIG_DFL); // The fault repeats on return and terminates as usual
+    }
+}
+
+// Registers [data, data + size) with the SIGBUS handler, installing it on first use.
+// False if there's no free slot (or the handler can't be installed).
+bool guardMapping(const char* data, qint64 size)
+{
+    QMutexLocker locker(&guardMutex());
+    static bool installed = false;
+    if (!installed) {
+        guardPageSize = static_cast<quintptr>(sysconf(_SC_PAGESIZE));
+        struct sigaction action = {};
+        action.sa_sigaction = handleBusError;
+        action.sa_flags = SA_SIGINFO;
+        sigemptyset(&action.sa_mask);
+        if (sigaction(SIGBUS, &action, &previousBusAction) != 0) {
+            return false;
+        }
+        installed = true;
+    }
+    for (GuardedRange& range : guardedRanges) {
+        if (range.end.load(std::memory_order_relaxed) == 0) {
+            range.begin.store(reinterpret_cast<quintptr>(data), std::memory_order_relaxed);
+            range.end.store(reinterpret_cast<quintptr>(data) + static_cast<quintptr>(size), std::memory_order_release);
+            return true;
+        }
+    }
+    return false;
+}
+
+void unguardMapping(const char* data)
+{
+    QMutexLocker locker(&guardMutex());
+    for (GuardedRange& range : guardedRanges) {
+        if (range.end.load(std::memory_order_relaxed) != 0
+            && range.begin.load(std::memory_order_relaxed) == reinterpret_cast<quintptr>(data)) {
+            range.end.store(0, std::memory_order_release);
+            range.begin.store(0, std::memory_order_relaxed);
+            return;
+        }
+    }
+}
+
+#elif defined(Q_OS_WIN)
+
+// True if another process has the file open for writing: asking for a handle that shares
+// reading only fails then
+bool isOpenForWriting(const QString& filename)
+{
+    const QString nativeName = QDir::toNativeSeparators(filename);
+    HANDLE handle = CreateFileW(reinterpret_cast<const wchar_t*>(nativeName.utf16()), GENERIC_READ,
+                                FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return GetLastError() == ERROR_SHARING_VIOLATION;
+    }
+    CloseHandle(handle);
+    return false;
+}
+
+#endif
+
+}  // namespace
+
+MappedFile::~MappedFile()
+{
+    if (data_) {
+#if defined(Q_OS_UNIX)
+        unguardMapping(data_); // Before the address range can be handed out again
+#endif
+        file_.unmap(reinterpret_cast<uchar*>(const_cast<char*>(data_)));
+    }
+    file_.close();
+}
+
+std::shared_ptr<MappedFile> MappedFile::open(const QString& filename, QString* errorString)
+{
+    std::shared_ptr<MappedFile> mapped(new MappedFile());
+    mapped->filename_ = filename;
+    mapped->file_.setFileName(filename);
+    if (!mapped->file_.open(QIODevice::ReadOnly)) {
+        if (errorString) *errorString = mapped->file_.errorString();
+        return nullptr;
+    }
+
+    mapped->size_ = mapped->file_.size();
+    mapped->fileId_ = fileIdOf(filename);
+    bool mappable = mapped->size_ > 0;
+#if defined(Q_OS_WIN)
+    if (mappable && isOpenForWriting(filename)) {
+        mappable = false; // Our mapping would keep the writer from truncating it
+        qInfo("'%s' is being written to, reading it without a mapping.", qPrintable(filename));
+    }
+#endif
+    if (mappable) {
+        uchar* map = mapped->file_.map(0, mapped->size_);
+#if defined(Q_OS_UNIX)
+        if (map && !guardMapping(reinterpret_cast<const char*>(map), mapped->size_)) {
+            // A truncation could crash readers of an unguarded mapping
+            qWarning("Unable to guard the mapping of '%s', falling back to buffered reads.", qPrintable(filename));
+            mapped->file_.unmap(map);
+            map = nullptr;
+        } else
+#endif
+        if (map) {
+            mapped->data_ = reinterpret_cast<const char*>(map);
+            // Default to viewport access; scans switch their range to sequential themselves
+            mapped->advise(0, mapped->size_, Access::Random);
+        } else {
+            qWarning("Unable to map '%s' (%s), falling back to buffered reads.",
+                     qPrintable(filename), qPrintable(mapped->file_.errorString()));
+        }
+    }
+    return mapped;
+}
+
+const QString& MappedFile::fileName() const
+{
+    return filename_;
+}
+
+qint64 MappedFile::size() const
+{
+    return size_;
+}
+
+quint64 MappedFile::fileId() const
+{
+    return fileId_;
+}
+
+quint64 MappedFile::fileIdOf(const QString& filename)
+{
+#if defined(Q_OS_UNIX)
+    struct stat info;
+    if (::stat(QFile::encodeName(filename).constData(), &info) != 0) {
+        return 0;
+    }
+    return (static_cast<quint64>(info.st_dev) << 32) ^ static_cast<quint64>(info.st_ino);
+#elif defined(Q_OS_WIN)
+    // Opened without any access rights, so this works while a writer holds the file
+    const QString nativeName = QDir::toNativeSeparators(filename);
+    HANDLE handle = CreateFileW(reinterpret_cast<const wchar_t*>(nativeName.utf16()), 0,
+                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+    BY_HANDLE_FILE_INFORMATION info;
+    const bool ok = GetFileInformationByHandle(handle, &info);
+    CloseHandle(handle);
+    if (!ok) {
+        return 0;
+    }
+    return (static_cast<quint64>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+#else
+    Q_UNUSED(filename);
+    return 0;
+#endif
+}
+
+bool MappedFile::isMapped() const
+{
+    return data_ != nullptr;
+}
+
+const char* MappedFile::data() const
+{
+    return data_;
+}
+
+QByteArray MappedFile::bytes(qint64 begin, qint64 end) const
+{
+    begin = qBound<qint64>(0, begin, size_);
+    end = qBound<qint64>(begin, end, size_);
+    if (data_) {
+        return QByteArray::fromRawData(data_ + begin, static_cast<int>(end - begin));
+    }
+
+    QMutexLocker locker(&fallbackMutex_);
+    if (!file_.seek(begin)) {
+        qWarning("Failed to seek to position %lld in %s", begin, qPrintable(filename_));
+        return QByteArray();
+    }
+    return file_.read(end - begin);
+}
+
+void MappedFile::advise(qint64 begin, qint64 end, Access access) const
+{
+#if defined(Q_OS_UNIX)
+    if (!data_) return;
+    begin = qBound<qint64>(0, begin, size_);
+    end = qBound<qint64>(begin, end, size_);
+    if (begin == end) return;
+
+    // madvise wants a page aligned start address
+    static const qint64 pageSize = sysconf(_SC_PAGESIZE);
+    const qint64 alignedBegin = begin - (begin % pageSize);
+    int advice = POSIX_MADV_RANDOM;
+    switch (access) {
+    case Access::Random:
+        advice = POSIX_MADV_RANDOM;
+        break;
+    case Access::Sequential:
+        advice = POSIX_MADV_SEQUENTIAL;
+        break;
+    case Access::WillNeed:
+        advice = POSIX_MADV_WILLNEED;
+        break;
+    }
+    posix_madvise(const_cast<char*>(data_) + alignedBegin, static_cast<size_t>(end - alignedBegin), advice);
+#else
+    Q_UNUSED(begin);
+    Q_UNUSED(end);
+    Q_UNUSED(access);
+#endif
+}
+
+quint64 MappedFile::fingerprint(qint64 begin, qint64 end) const
+{
+    const QByteArray data = bytes(begin, end);
+    quint64 hash = 14695981039346656037ULL;
+    for (const char c : data) {
+        hash ^= static_cast<uchar>(c);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
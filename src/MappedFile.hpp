@@ -0,0 +1,76 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <memory>
+
+#include <QByteArray>
+#include <QFile>
+#include <QMutex>
+#include <QString>
+
+// Read-only, memory-mapped view of a log file, shared by every reader of a Logfile
+// (viewport, cache prefetch, indexing and filter tasks). Reading mapped memory needs no
+// locking and no seek/read syscalls, so concurrent readers never contend.
+//
+// If the file can't be mapped (e.g. a file larger than the address space of a 32-bit build)
+// reads fall back to a single QFile guarded by a mutex.
+//
+// Truncation: log rotation may cut the file while readers still hold the mapping (a
+// filter task, a prefetch, the paint path before the Logfile has noticed). Touching a
+// mapped page past the new end of the file raises SIGBUS. On Unix every mapping is
+// registered with a SIGBUS handler that backs the faulting page with zeros, so the read
+// goes on and sees NUL bytes instead of killing the process. The results of that read are
+// garbage, but only until the Logfile's change check sees the truncation and reindexes.
+// Mappings that can't be registered aren't made: those files use the fallback reader.
+// On Windows a mapped file can't be truncated at all, the writer would fail. Files another
+// process has open for writing when they're opened (live logs) are therefore not mapped
+// there and use the fallback reader too.
+class MappedFile
+{
+public:
+    // Kernel paging hints, applied per byte range (no-ops where unsupported)
+    enum class Access {
+        Random,     // Viewport: jumping around, read-ahead would be wasted
+        Sequential, // Scans: aggressive read-ahead, pages can be dropped behind
+        WillNeed    // Prefetch: start reading the range in now
+    };
+
+    ~MappedFile();
+
+    // Opens and maps filename. Returns nullptr and fills errorString on failure.
+    static std::shared_ptr<MappedFile> open(const QString& filename, QString* errorString = nullptr);
+
+    const QString& fileName() const;
+    qint64 size() const;
+    bool isMapped() const;
+
+    // Identity of the file this snapshot was opened from (inode/file index), 0 if unknown.
+    // A different value for the same path means the file was replaced, e.g. by log rotation.
+    quint64 fileId() const;
+    static quint64 fileIdOf(const QString& filename);
+
+    // Start of the mapping, or nullptr when the fallback reader is used
+    const char* data() const;
+
+    // Bytes [begin, end) of the file. When mapped this is a zero-copy view
+    // (QByteArray::fromRawData) that stays valid as long as this MappedFile lives.
+    QByteArray bytes(qint64 begin, qint64 end) const;
+
+    void advise(qint64 begin, qint64 end, Access access) const;
+
+    // FNV-1a hash of bytes [begin, end), clamped to the file. Cheap content check used to
+    // tell whether cached data still describes the file.
+    quint64 fingerprint(qint64 begin, qint64 end) const;
+
+private:
+    MappedFile() = default;
+
+    QString filename_;
+    qint64 size_ = 0;
+    quint64 fileId_ = 0;
+    const char* data_ = nullptr;
+    mutable QFile file_;
+    mutable QMutex fallbackMutex_; // Serialises seek+read when not mapped
+};
+
+#endif // MAPPED_FILE_HPP
@@ -0,0 +1,381 @@
+#include "MatchSet.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+namespace
+{
+
+const int kChunkRows = 65536;
+
+// Sets bits [begin, end) of words
+void setRange(quint64* words, int begin, int end)
+{
+    while (begin < end) {
+        const int bit = begin & 63;
+        const int span = qMin(64 - bit, end - begin);
+        words[begin >> 6] |= (span == 64 ? ~quint64(0) : ((quint64(1) << span) - 1)) << bit;
+        begin += span;
+    }
+}
+
+// First set (resp. clear) bit at or after pos in a chunk of wordCount words, or wordCount * 64
+int nextBit(const quint64* words, int wordCount, int pos, bool set)
+{
+    for (int w = pos >> 6; w < wordCount; ++w) {
+        quint64 word = set ? words[w] : ~words[w];
+        if (w == (pos >> 6)) {
+            word &= ~quint64(0) << (pos & 63);
+        }
+        if (word) {
+            return w * 64 + int(qCountTrailingZeroBits(word));
+        }
+    }
+    return wordCount * 64;
+}
+
+}  // namespace
+
+MatchSet::MatchSet(int rows)
+    : rows_(rows)
+{
+}
+
+MatchSet MatchSet::filled(int rows)
+{
+    MatchSet set(rows);
+    for (int base = 0; base < rows; base += kChunkRows) {
+        Container container;
+        container.key = static_cast<quint16>(base >> 16);
+        container.kind = Kind::Runs;
+        container.count = qMin(kChunkRows, rows - base);
+        container.values = { 0, static_cast<quint16>(container.count - 1) };
+        set.containers_.push_back(std::move(container));
+    }
+    set.count_ = rows;
+    return set;
+}
+
+MatchSet MatchSet::fromWords(const quint64* words, int rows)
+{
+    MatchSet set(rows);
+    const int wordCount = (rows + 63) / 64;
+    std::vector<quint64> chunk(kChunkWords);
+    for (int first = 0; first < wordCount; first += kChunkWords) {
+        const int last = qMin(first + kChunkWords, wordCount);
+        bool empty = true;
+        for (int w = first; w < last && empty; ++w) {
+            empty = words[w] == 0;
+        }
+        if (empty) {
+            continue; // Nothing matched in these 65536 rows, the common case of a sparse result
+        }
+        std::fill(std::copy(words + first, words + last, chunk.begin()), chunk.end(), 0);
+        if (last == wordCount && (rows & 63)) {
+            chunk[last - first - 1] &= (quint64(1) << (rows & 63)) - 1;
+        }
+        Container container = encode(static_cast<quint16>(first / kChunkWords), chunk.data());
+        if (container.count > 0) {
+            set.count_ += container.count;
+            set.containers_.push_back(std::move(container));
+        }
+    }
+    return set;
+}
+
+int MatchSet::rows() const
+{
+    return rows_;
+}
+
+int MatchSet::count() const
+{
+    return count_;
+}
+
+bool MatchSet::contains(int row) const
+{
+    if (row < 0 || row >= rows_) {
+        return false;
+    }
+    const Container* container = find(static_cast<quint16>(row >> 16));
+    if (!container) {
+        return false;
+    }
+    return containerContains(*container, static_cast<quint16>(row));
+}
+
+qint64 MatchSet::byteSize() const
+{
+    qint64 size = sizeof(MatchSet) + static_cast<qint64>(containers_.capacity() * sizeof(Container));
+    for (const Container& container : containers_) {
+        size += static_cast<qint64>(container.values.capacity() * sizeof(quint16)
+                                    + container.bitmap.capacity() * sizeof(quint64));
+    }
+    return size;
+}
+
+void MatchSet::append(int row)
+{
+    Q_ASSERT(row >= 0 && row < rows_);
+    const quint16 key = static_cast<quint16>(row >> 16);
+    const quint16 low = static_cast<quint16>(row);
+    if (containers_.empty() || containers_.back().key != key) {
+        Container container;
+        container.key = key;
+        containers_.push_back(std::move(container));
+    }
+    Container& container = containers_.back();
+    switch (container.kind) {
+    case Kind::Array:
+        Q_ASSERT(container.values.empty() || container.values.back() < low);
+        container.values.push_back(low);
+        if (static_cast<int>(container.values.size()) > kMaxArrayCount) {
+            container.bitmap.assign(kChunkWords, 0);
+            for (quint16 value : container.values) {
+                container.bitmap[value >> 6] |= quint64(1) << (value & 63);
+            }
+            std::vector<quint16>().swap(container.values);
+            container.kind = Kind::Bitmap;
+        }
+        break;
+    case Kind::Bitmap:
+        container.bitmap[low >> 6] |= quint64(1) << (low & 63);
+        break;
+    case Kind::Runs: {
+        const size_t last = container.values.size() - 2;
+        if (container.values[last] + container.values[last + 1] + 1 == low) {
+            ++container.values[last + 1];
+        } else {
+            container.values.push_back(low);
+            container.values.push_back(0);
+        }
+        break;
+    }
+    }
+    ++container.count;
+    ++count_;
+}
+
+void MatchSet::optimize()
+{
+    std::vector<quint64> chunk(kChunkWords);
+    for (Container& container : containers_) {
+        std::fill(chunk.begin(), chunk.end(), 0);
+        decode(container, chunk.data());
+        container = encode(container.key, chunk.data());
+    }
+}
+
+void MatchSet::truncate(int rows)
+{
+    if (rows >= rows_) {
+        return;
+    }
+    rows_ = rows;
+    // Containers starting at or past rows go, the one holding rows is cut
+    while (!containers_.empty() && (int(containers_.back().key) << 16) >= rows) {
+        count_ -= containers_.back().count;
+        containers_.pop_back();
+    }
+    if (!containers_.empty() && (int(containers_.back().key) << 16) + kChunkRows > rows) {
+        Container& container = containers_.back();
+        std::vector<quint64> chunk(kChunkWords, 0);
+        decode(container, chunk.data());
+        const int keep = rows - (int(container.key) << 16);
+        std::fill(chunk.begin() + (keep + 63) / 64, chunk.end(), 0);
+        if (keep & 63) {
+            chunk[keep / 64] &= (quint64(1) << (keep & 63)) - 1;
+        }
+        count_ -= container.count;
+        container = encode(container.key, chunk.data());
+        count_ += container.count;
+        if (container.count == 0) {
+            containers_.pop_back();
+        }
+    }
+}
+
+MatchSet MatchSet::unite(const MatchSet& a, const MatchSet& b)
+{
+    MatchSet result(qMax(a.rows_, b.rows_));
+    std::vector<quint64> chunk(kChunkWords);
+    auto i = a.containers_.begin();
+    auto j = b.containers_.begin();
+    while (i != a.containers_.end() || j != b.containers_.end()) {
+        if (j == b.containers_.end() || (i != a.containers_.end() && i->key < j->key)) {
+            result.containers_.push_back(*i++);
+        } else if (i == a.containers_.end() || j->key < i->key) {
+            result.containers_.push_back(*j++);
+        } else {
+            Container merged;
+            if (i->kind == Kind::Array && j->kind == Kind::Array
+                && i->count + j->count <= kMaxArrayCount) {
+                merged.key = i->key;
+                std::set_union(i->values.begin(), i->values.end(), j->values.begin(), j->values.end(),
+                               std::back_inserter(merged.values));
+                merged.count = static_cast<int>(merged.values.size());
+            } else {
+                std::fill(chunk.begin(), chunk.end(), 0);
+                decode(*i, chunk.data());
+                decode(*j, chunk.data());
+                merged = encode(i->key, chunk.data());
+            }
+            result.containers_.push_back(std::move(merged));
+            ++i;
+            ++j;
+        }
+        result.count_ += result.containers_.back().count;
+    }
+    return result;
+}
+
+MatchSet MatchSet::intersect(const MatchSet& a, const MatchSet& b)
+{
+    MatchSet result(qMin(a.rows_, b.rows_));
+    std::vector<quint64> chunk(kChunkWords);
+    std::vector<quint64> other(kChunkWords);
+    auto i = a.containers_.begin();
+    auto j = b.containers_.begin();
+    while (i != a.containers_.end() && j != b.containers_.end()) {
+        if (i->key < j->key) {
+            ++i;
+            continue;
+        }
+        if (j->key < i->key) {
+            ++j;
+            continue;
+        }
+        Container common;
+        common.key = i->key;
+        if (i->kind == Kind::Array || j->kind == Kind::Array) {
+            // At most the array's rows: each is looked up in the other container
+            const Container& array = i->kind == Kind::Array ? *i : *j;
+            const Container& lookup = i->kind == Kind::Array ? *j : *i;
+            for (quint16 value : array.values) {
+                if (containerContains(lookup, value)) {
+                    common.values.push_back(value);
+                }
+            }
+            common.count = static_cast<int>(common.values.size());
+        } else {
+            std::fill(chunk.begin(), chunk.end(), 0);
+            std::fill(other.begin(), other.end(), 0);
+            decode(*i, chunk.data());
+            decode(*j, other.data());
+            for (int w = 0; w < kChunkWords; ++w) {
+                chunk[w] &= other[w];
+            }
+            common = encode(i->key, chunk.data());
+        }
+        if (common.count > 0) {
+            result.count_ += common.count;
+            result.containers_.push_back(std::move(common));
+        }
+        ++i;
+        ++j;
+    }
+    return result;
+}
+
+std::vector<quint64> MatchSet::toWords() const
+{
+    const size_t wordCount = (static_cast<size_t>(rows_) + 63) / 64;
+    std::vector<quint64> words;
+    if (!containers_.empty()) {
+        // Room for the whole last chunk while decoding; its words past rows_ are clear
+        words.resize(qMax(wordCount, (static_cast<size_t>(containers_.back().key) + 1) * kChunkWords), 0);
+        for (const Container& container : containers_) {
+            decode(container, words.data() + static_cast<size_t>(container.key) * kChunkWords);
+        }
+    }
+    words.resize(wordCount, 0);
+    return words;
+}
+
+MatchSet::Container MatchSet::encode(quint16 key, const quint64* chunk)
+{
+    // Sizes of the forms: 2 bytes per row, 8 KiB, 4 bytes per run
+    Container container;
+    container.key = key;
+    int runs = 0;
+    quint64 carry = 0; // Top bit of the previous word
+    for (int w = 0; w < kChunkWords; ++w) {
+        container.count += qPopulationCount(chunk[w]);
+        runs += qPopulationCount(chunk[w] & ~((chunk[w] << 1) | carry)); // Bits starting a run
+        carry = chunk[w] >> 63;
+    }
+
+    if (runs * 4 < qMin(container.count * 2, kChunkWords * 8)) {
+        container.kind = Kind::Runs;
+        container.values.reserve(runs * 2);
+        for (int start = nextBit(chunk, kChunkWords, 0, true); start < kChunkRows;) {
+            const int end = nextBit(chunk, kChunkWords, start, false);
+            container.values.push_back(static_cast<quint16>(start));
+            container.values.push_back(static_cast<quint16>(end - start - 1));
+            start = end < kChunkRows ? nextBit(chunk, kChunkWords, end, true) : kChunkRows;
+        }
+    } else if (container.count <= kMaxArrayCount) {
+        container.kind = Kind::Array;
+        container.values.reserve(container.count);
+        for (int w = 0; w < kChunkWords; ++w) {
+            for (quint64 word = chunk[w]; word; word &= word - 1) {
+                container.values.push_back(static_cast<quint16>(w * 64 + int(qCountTrailingZeroBits(word))));
+            }
+        }
+    } else {
+        container.kind = Kind::Bitmap;
+        container.bitmap.assign(chunk, chunk + kChunkWords);
+    }
+    return container;
+}
+
+void MatchSet::decode(const Container& container, quint64* chunk)
+{
+    switch (container.kind) {
+    case Kind::Array:
+        for (quint16 value : container.values) {
+            chunk[value >> 6] |= quint64(1) << (value & 63);
+        }
+        break;
+    case Kind::Bitmap:
+        for (int w = 0; w < kChunkWords; ++w) {
+            chunk[w] |= container.bitmap[w];
+        }
+        break;
+    case Kind::Runs:
+        for (size_t r = 0; r < container.values.size(); r += 2) {
+            setRange(chunk, container.values[r], container.values[r] + container.values[r + 1] + 1);
+        }
+        break;
+    }
+}
+
+bool MatchSet::containerContains(const Container& container, quint16 low)
+{
+    switch (container.kind) {
+    case Kind::Array:
+        return std::binary_search(container.values.begin(), container.values.end(), low);
+    case Kind::Bitmap:
+        return (container.bitmap[low >> 6] >> (low & 63)) & 1;
+    case Kind::Runs: {
+        // Last run starting at or before low
+        int lowRun = 0;
+        int highRun = static_cast<int>(container.values.size() / 2);
+        while (highRun - lowRun > 1) {
+            const int middle = (lowRun + highRun) / 2;
+            (container.values[middle * 2] <= low ? lowRun : highRun) = middle;
+        }
+        const int start = container.values[lowRun * 2];
+        return low >= start && low <= start + container.values[lowRun * 2 + 1];
+    }
+    }
+    return false;
+}
+
+const MatchSet::Container* MatchSet::find(quint16 key) const
+{
+    auto it = std::lower_bound(containers_.begin(), containers_.end(), key,
+                               [](const Container& container, quint16 k) { return container.key < k; });
+    return it != containers_.end() && it->key == key ? &*it : nullptr;
+}
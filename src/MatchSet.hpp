@@ -0,0 +1,103 @@
+#ifndef MATCH_SET_HPP
+#define MATCH_SET_HPP
+
+#include <vector>
+
+#include <QtAlgorithms>
+#include <QtGlobal>
+
+// Compressed set of the source rows a filter matched, for keeping results around.
+//
+// Roaring-style: rows are split into chunks of 65536 and every chunk holding a match gets a
+// container in whichever form is smallest for its contents: a sorted array of the low 16
+// bits (sparse matches), a 65536-bit bitmap (dense, scattered matches) or a list of runs
+// (blocks of consecutive rows, e.g. all rows but a few). A filter matching a dozen rows of a
+// huge file costs a few dozen bytes, one matching nearly everything about as little.
+//
+// rows() is the number of leading source rows the set describes: rows past it weren't
+// evaluated, they're not known to be unmatched.
+class MatchSet
+{
+public:
+    MatchSet() = default;
+    explicit MatchSet(int rows); // No row matched out of rows
+    static MatchSet filled(int rows); // All rows matched
+    static MatchSet fromWords(const quint64* words, int rows); // Bit i of words[i / 64]; bits from rows on are ignored
+
+    int rows() const;       // Leading source rows the set describes
+    int count() const;      // Matched rows among them
+    bool contains(int row) const;
+    qint64 byteSize() const; // Memory held
+
+    // Builds a set row by row: row must be above every row added before, and below rows()
+    void append(int row);
+    void optimize(); // Stores every container in its smallest form, after append()
+
+    void truncate(int rows); // Forgets rows from rows on
+
+    // Calls onRow(int row) for every matched row in ascending order; onRow returns false to stop
+    template <typename Callback>
+    void forEach(Callback onRow) const;
+
+    // Over the larger resp. smaller of the two rows()
+    static MatchSet unite(const MatchSet& a, const MatchSet& b);
+    static MatchSet intersect(const MatchSet& a, const MatchSet& b);
+
+    std::vector<quint64> toWords() const; // (rows() + 63) / 64 words, bits past rows() clear
+
+private:
+    enum class Kind : quint8 { Array, Bitmap, Runs };
+
+    struct Container
+    {
+        quint16 key = 0;              // Row >> 16
+        Kind kind = Kind::Array;
+        int count = 0;                // Rows in the container
+        std::vector<quint16> values;  // Array: sorted low bits; Runs: (start, length - 1) pairs
+        std::vector<quint64> bitmap;  // Bitmap: kChunkWords words
+    };
+
+    static constexpr int kChunkWords = 1024; // 65536 rows
+    static constexpr int kMaxArrayCount = 4096; // Above this an array is larger than a bitmap
+
+    static Container encode(quint16 key, const quint64* chunk); // Smallest form, chunk of kChunkWords words
+    static void decode(const Container& container, quint64* chunk); // ORs the rows into chunk
+    static bool containerContains(const Container& container, quint16 low);
+    const Container* find(quint16 key) const;
+
+    std::vector<Container> containers_; // Ascending keys, none empty
+    int rows_ = 0;
+    int count_ = 0;
+};
+
+template <typename Callback>
+void MatchSet::forEach(Callback onRow) const
+{
+    for (const Container& container : containers_) {
+        const int base = int(container.key) << 16;
+        switch (container.kind) {
+        case Kind::Array:
+            for (quint16 value : container.values) {
+                if (!onRow(base + value)) return;
+            }
+            break;
+        case Kind::Bitmap:
+            for (int w = 0; w < kChunkWords; ++w) {
+                for (quint64 word = container.bitmap[w]; word; word &= word - 1) {
+                    if (!onRow(base + w * 64 + int(qCountTrailingZeroBits(word)))) return;
+                }
+            }
+            break;
+        case Kind::Runs:
+            for (size_t r = 0; r < container.values.size(); r += 2) {
+                const int first = base + container.values[r];
+                for (int row = first; row <= first + container.values[r + 1]; ++row) {
+                    if (!onRow(row)) return;
+                }
+            }
+            break;
+        }
+    }
+}
+
+#endif // MATCH_SET_HPP
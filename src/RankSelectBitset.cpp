@@ -0,0 +1,276 @@
+#include "RankSelectBitset.hpp"
+
+#include <algorithm>
+
+#include <QtAlgorithms>
+
+namespace
+{
+
+const int kBlockWords = 16; // 1024 bits per counted block
+const int kBlockBits = kBlockWords * 64;
+const quint32 kSelectSample = 256;            // Set bits per select group
+const quint32 kDenseSpan = 256 * 64;          // Groups spanning more bits spill their positions
+const quint32 kSpilled = quint32(1) << 31;    // Marks a select group entry as an offset in selectSpill_
+
+// Index of the n-th set bit of word, which has more than n
+int selectInWord(quint64 word, int n)
+{
+    int shift = 0;
+    for (;; shift += 8) {
+        const int byteCount = static_cast<int>(qPopulationCount(static_cast<quint8>(word >> shift)));
+        if (n < byteCount) {
+            break;
+        }
+        n -= byteCount;
+    }
+    quint64 byte = (word >> shift) & 0xFF;
+    for (; n > 0; --n) {
+        byte &= byte - 1;
+    }
+    return shift + static_cast<int>(qCountTrailingZeroBits(byte));
+}
+
+}  // namespace
+
+RankSelectBitset::RankSelectBitset(int size, bool value)
+    : words_((static_cast<size_t>(size) + 63) / 64, value ? ~quint64(0) : 0),
+      size_(size)
+{
+    if (value && (size & 63)) {
+        words_.back() &= (quint64(1) << (size & 63)) - 1;
+    }
+    updateCounts(0);
+}
+
+RankSelectBitset::RankSelectBitset(std::vector<quint64> words, int size)
+    : words_(std::move(words)),
+      size_(size)
+{
+    words_.resize((static_cast<size_t>(size) + 63) / 64, 0);
+    if (size & 63) {
+        words_.back() &= (quint64(1) << (size & 63)) - 1;
+    }
+    updateCounts(0);
+}
+
+int RankSelectBitset::size() const
+{
+    return size_;
+}
+
+bool RankSelectBitset::isEmpty() const
+{
+    return size_ == 0;
+}
+
+int RankSelectBitset::count() const
+{
+    return blockRank_.empty() ? 0 : static_cast<int>(blockRank_.back());
+}
+
+bool RankSelectBitset::testBit(int i) const
+{
+    Q_ASSERT(i >= 0 && i < size_);
+    return (words_[i >> 6] >> (i & 63)) & 1;
+}
+
+int RankSelectBitset::rank(int i) const
+{
+    Q_ASSERT(i >= 0 && i <= size_);
+    const int word = i >> 6;
+    int result = static_cast<int>(blockRank_[i / kBlockBits]);
+    for (int w = (i / kBlockBits) * kBlockWords; w < word; ++w) {
+        result += qPopulationCount(words_[w]);
+    }
+    if (i & 63) {
+        result += qPopulationCount(words_[word] & ((quint64(1) << (i & 63)) - 1));
+    }
+    return result;
+}
+
+int RankSelectBitset::select(int n) const
+{
+    Q_ASSERT(n >= 0 && n < count());
+    const quint32 entry = selectGroup_[static_cast<quint32>(n) / kSelectSample];
+    if (entry & kSpilled) {
+        return static_cast<int>(selectSpill_[(entry & ~kSpilled) + static_cast<quint32>(n) % kSelectSample]);
+    }
+
+    // Dense group: the n-th set bit is at most kDenseSpan bits after the group's first
+    int block = static_cast<int>(entry);
+    while (blockRank_[block + 1] <= static_cast<quint32>(n)) {
+        ++block;
+    }
+    int remaining = n - static_cast<int>(blockRank_[block]);
+    for (int w = block * kBlockWords;; ++w) {
+        const int wordCount = static_cast<int>(qPopulationCount(words_[w]));
+        if (remaining < wordCount) {
+            return w * 64 + selectInWord(words_[w], remaining);
+        }
+        remaining -= wordCount;
+    }
+}
+
+void RankSelectBitset::clear()
+{
+    *this = RankSelectBitset();
+}
+
+void RankSelectBitset::resize(int size)
+{
+    const int firstChanged = qMin(size, size_);
+    words_.resize((static_cast<size_t>(size) + 63) / 64, 0);
+    if (size < size_ && (size & 63)) {
+        words_.back() &= (quint64(1) << (size & 63)) - 1; // Cut bits past the new end
+    }
+    size_ = size;
+    updateCounts(firstChanged / kBlockBits);
+}
+
+void RankSelectBitset::appendWords(const quint64* words, int size)
+{
+    Q_ASSERT(size >= size_);
+    const int first = size_;
+    words_.resize((static_cast<size_t>(size) + 63) / 64, 0);
+    for (int w = first >> 6; w < static_cast<int>(words_.size()); ++w) {
+        quint64 word = words[w];
+        if (w == (first >> 6)) {
+            word &= ~quint64(0) << (first & 63); // Bits before first are already there
+        }
+        words_[w] |= word;
+    }
+    if (size & 63) {
+        words_.back() &= (quint64(1) << (size & 63)) - 1;
+    }
+    size_ = size;
+    updateCounts(first / kBlockBits);
+}
+
+void RankSelectBitset::appendBits(int size, const int* indexes, int indexCount)
+{
+    Q_ASSERT(size >= size_);
+    const int first = size_;
+    words_.resize((static_cast<size_t>(size) + 63) / 64, 0);
+    for (int i = 0; i < indexCount; ++i) {
+        Q_ASSERT(indexes[i] >= first && indexes[i] < size);
+        words_[indexes[i] >> 6] |= quint64(1) << (indexes[i] & 63);
+    }
+    size_ = size;
+    updateCounts(first / kBlockBits);
+}
+
+qint64 RankSelectBitset::byteSize() const
+{
+    return static_cast<qint64>(words_.capacity() * sizeof(quint64)
+                               + (blockRank_.capacity() + selectGroup_.capacity() + selectSpill_.capacity())
+                                     * sizeof(quint32));
+}
+
+int RankSelectBitset::countBits(const quint64* words, int begin, int end)
+{
+    int result = 0;
+    for (int w = begin >> 6; w * 64 < end; ++w) {
+        quint64 word = words[w];
+        if (w == (begin >> 6)) {
+            word &= ~quint64(0) << (begin & 63);
+        }
+        if ((w + 1) * 64 > end) {
+            word &= (quint64(1) << (end & 63)) - 1;
+        }
+        result += qPopulationCount(word);
+    }
+    return result;
+}
+
+void RankSelectBitset::updateCounts(int fromBlock)
+{
+    const int blockCount = static_cast<int>((words_.size() + kBlockWords - 1) / kBlockWords);
+    fromBlock = qMin(fromBlock, blockCount);
+    blockRank_.resize(blockCount + 1, 0);
+    blockRank_[0] = 0;
+    for (int block = fromBlock; block < blockCount; ++block) {
+        quint32 blockEnd = blockRank_[block];
+        const size_t lastWord = qMin(words_.size(), static_cast<size_t>(block + 1) * kBlockWords);
+        for (size_t w = static_cast<size_t>(block) * kBlockWords; w < lastWord; ++w) {
+            blockEnd += qPopulationCount(words_[w]);
+        }
+        blockRank_[block + 1] = blockEnd;
+    }
+    updateSelect(fromBlock);
+}
+
+void RankSelectBitset::updateSelect(int fromBlock)
+{
+    // A group is final once the next one starts before the changed blocks: its bits and its
+    // span are known. The group holding the last unchanged bit and the ones after it are
+    // built again, along with the positions spilled for them.
+    const quint32 total = blockRank_.back();
+    const quint32 unchanged = blockRank_[fromBlock];
+    const size_t kept = qMin(selectGroup_.size(), static_cast<size_t>(unchanged > 0 ? (unchanged - 1) / kSelectSample : 0));
+    for (size_t g = kept; g < selectGroup_.size(); ++g) {
+        if (selectGroup_[g] & kSpilled) {
+            selectSpill_.resize(selectGroup_[g] & ~kSpilled);
+            break;
+        }
+    }
+    selectGroup_.resize(kept);
+
+    const size_t groupCount = (total + kSelectSample - 1) / kSelectSample;
+    if (kept == groupCount) {
+        return;
+    }
+
+    // First set bit of each group, counting words from the block holding the first of them
+    // and stepping over whole blocks that end before the next
+    std::vector<quint32> starts;
+    starts.reserve(groupCount - kept);
+    quint32 target = static_cast<quint32>(kept) * kSelectSample;
+    int block = static_cast<int>(std::upper_bound(blockRank_.begin(), blockRank_.end(), target) - blockRank_.begin()) - 1;
+    size_t word = static_cast<size_t>(block) * kBlockWords;
+    quint32 before = blockRank_[block];
+    for (size_t g = kept; g < groupCount; ++g, target += kSelectSample) {
+        if (blockRank_[block + 1] <= target) {
+            while (blockRank_[block + 1] <= target) {
+                ++block;
+            }
+            word = static_cast<size_t>(block) * kBlockWords;
+            before = blockRank_[block];
+        }
+        for (quint32 wordCount = qPopulationCount(words_[word]); before + wordCount <= target;
+             wordCount = qPopulationCount(words_[word])) {
+            before += wordCount;
+            ++word;
+        }
+        starts.push_back(static_cast<quint32>(word * 64 + selectInWord(words_[word], static_cast<int>(target - before))));
+    }
+
+    for (size_t i = 0; i < starts.size(); ++i) {
+        const quint32 start = starts[i];
+        const quint32 end = i + 1 < starts.size() ? starts[i + 1] : static_cast<quint32>(size_);
+        if (end - start <= kDenseSpan) {
+            selectGroup_.push_back(start / kBlockBits);
+            continue;
+        }
+        selectGroup_.push_back(kSpilled | static_cast<quint32>(selectSpill_.size()));
+        const quint32 bits = qMin(kSelectSample, total - static_cast<quint32>(kept + i) * kSelectSample);
+        size_t w = start >> 6;
+        quint64 bitsLeft = words_[w] & (~quint64(0) << (start & 63));
+        for (quint32 found = 0; found < bits;) {
+            if (bitsLeft == 0) {
+                ++w;
+                if (w % kBlockWords == 0) {
+                    // Empty blocks are common in a sparse group, there are more bits after them
+                    while (blockRank_[w / kBlockWords + 1] == blockRank_[w / kBlockWords]) {
+                        w += kBlockWords;
+                    }
+                }
+                bitsLeft = words_[w];
+                continue;
+            }
+            selectSpill_.push_back(static_cast<quint32>(w * 64 + qCountTrailingZeroBits(bitsLeft)));
+            bitsLeft &= bitsLeft - 1;
+            ++found;
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef RANK_SELECT_BITSET_HPP
+#define RANK_SELECT_BITSET_HPP
+
+#include <vector>
+
+#include <QtGlobal>
+
+// Bitset answering "how many bits are set before i" (rank) and "where is the n-th set bit"
+// (select) in constant time, for mapping between source rows and the filtered rows shown.
+//
+// Next to the bits it keeps the number of set bits before every block of 1024 bits (3% on
+// top of the bits). rank() adds the popcounts of at most 16 words to a block's count.
+//
+// For select the set bits are grouped by 256. A dense group, spanning at most 256 words,
+// stores the block of its first bit: the n-th bit is then found stepping over at most 17
+// block counts and popcounting at most 16 words. A sparse group, the usual case for a
+// selective filter, stores the positions of all its bits, which costs at most half of the
+// words it spans. Either way select() takes a bounded number of steps, however far apart
+// the matches are.
+//
+// Only growing and shrinking at the end keep the counts up to date incrementally, which is
+// how filter results are published: appended rows, rows cut off when a file is rewritten.
+class RankSelectBitset
+{
+public:
+    RankSelectBitset() = default;
+    explicit RankSelectBitset(int size, bool value = false);
+    RankSelectBitset(std::vector<quint64> words, int size); // Bit i in words[i / 64], bits from size on ignored
+
+    int size() const;
+    bool isEmpty() const;
+    int count() const; // Set bits
+    bool testBit(int i) const;
+
+    int rank(int i) const;   // Set bits before i, i in [0, size()]
+    int select(int n) const; // Index of the n-th set bit (counting from 0), n < count()
+
+    void clear();
+    void resize(int size); // New bits are clear
+
+    // Grow to size bits. appendWords() copies the bits [size(), size) of words (same layout as
+    // the constructor's), appendBits() sets the ascending indexes given, all >= size().
+    void appendWords(const quint64* words, int size);
+    void appendBits(int size, const int* indexes, int indexCount);
+
+    qint64 byteSize() const; // Memory held
+
+    // Set bits in [begin, end) of words (bit i in words[i / 64])
+    static int countBits(const quint64* words, int begin, int end);
+
+private:
+    void updateCounts(int fromBlock); // Counts of the blocks from fromBlock on, after they changed
+    void updateSelect(int fromBlock); // Select groups of the bits from fromBlock on, after updateCounts()
+
+    std::vector<quint64> words_;
+    std::vector<quint32> blockRank_;   // Set bits before block b; one more entry than blocks
+    std::vector<quint32> selectGroup_; // Per 256 set bits: block of the first, or kSpilled | offset in selectSpill_
+    std::vector<quint32> selectSpill_; // Positions of every set bit of the sparse groups
+    int size_ = 0;
+};
+
+#endif // RANK_SELECT_BITSET_HPP
@@ -0,0 +1,237 @@
+#include "TaskScheduler.hpp"
+
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThread>
+
+namespace
+{
+
+// Class of the scheduler task running on this thread; kClassCount when there's none
+thread_local int currentTaskClass = TaskScheduler::kClassCount;
+
+}  // namespace
+
+// Takes tasks from the queues until none may start
+class TaskScheduler::Worker : public QRunnable
+{
+public:
+    explicit Worker(TaskScheduler* scheduler) : scheduler_(scheduler) { setAutoDelete(true); }
+    void run() override { scheduler_->workerLoop(); }
+
+private:
+    TaskScheduler* scheduler_;
+};
+
+TaskScheduler& TaskScheduler::instance()
+{
+    static TaskScheduler scheduler;
+    return scheduler;
+}
+
+TaskScheduler::TaskScheduler()
+{
+    setThreadCount(0);
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    // Owners wait for their tasks when they go away; what's left at exit is dropped. Workers
+    // may still be taking tasks, so the queues are emptied under the lock.
+    std::vector<Task> dropped;
+    {
+        QMutexLocker locker(&mutex_);
+        for (std::deque<Task>& queue : queues_) {
+            for (Task& task : queue) {
+                dropped.push_back(std::move(task));
+            }
+            queue.clear();
+        }
+    }
+    for (Task& task : dropped) {
+        task.run(true);
+    }
+    pool_.waitForDone();
+}
+
+int TaskScheduler::threadCount() const
+{
+    QMutexLocker locker(&mutex_);
+    return threadCount_;
+}
+
+void TaskScheduler::setThreadCount(int threadCount)
+{
+    {
+        QMutexLocker locker(&mutex_);
+        threadCount_ = threadCount > 0 ? threadCount : qMax(1, QThread::idealThreadCount());
+        pool_.setMaxThreadCount(threadCount_);
+    }
+    startWorkers(); // If there are more threads now
+}
+
+int TaskScheduler::concurrencyLimit(TaskClass taskClass) const
+{
+    QMutexLocker locker(&mutex_);
+    return limitLocked(static_cast<int>(taskClass));
+}
+
+void TaskScheduler::setConcurrencyLimit(TaskClass taskClass, int limit)
+{
+    {
+        QMutexLocker locker(&mutex_);
+        limits_[static_cast<int>(taskClass)] = qMax(0, limit);
+    }
+    startWorkers();
+}
+
+void TaskScheduler::discardCancelled()
+{
+    std::vector<Task> dropped;
+    {
+        QMutexLocker locker(&mutex_);
+        Task unused;
+        takeNextLocked(0, &unused, &dropped); // No class may start, it only sweeps
+    }
+    for (Task& task : dropped) {
+        task.run(true);
+    }
+}
+
+void TaskScheduler::yieldToUrgentWork()
+{
+    const int yieldingClass = currentTaskClass;
+    if (yieldingClass == 0 || yieldingClass >= kClassCount) {
+        return; // Nothing is more urgent, or not called from a scheduler task
+    }
+    TaskScheduler& scheduler = instance();
+    for (;;) {
+        Task task;
+        std::vector<Task> dropped;
+        bool found = false;
+        {
+            QMutexLocker locker(&scheduler.mutex_);
+            // A thread that's free or may still be started takes the urgent task itself,
+            // this one only steps in when all of them are busy
+            found = scheduler.takeNextLocked(scheduler.workers_ < scheduler.threadCount_ ? 0 : yieldingClass,
+                                             &task, &dropped);
+        }
+        for (Task& droppedTask : dropped) {
+            droppedTask.run(true);
+        }
+        if (!found) {
+            return;
+        }
+        scheduler.runTask(task); // May yield again, but only to even more urgent tasks
+    }
+}
+
+void TaskScheduler::enqueue(Task task)
+{
+    {
+        QMutexLocker locker(&mutex_);
+        queues_[static_cast<int>(task.taskClass)].push_back(std::move(task));
+    }
+    startWorkers();
+}
+
+void TaskScheduler::workerLoop()
+{
+    for (;;) {
+        Task task;
+        std::vector<Task> dropped;
+        bool found = false;
+        {
+            QMutexLocker locker(&mutex_);
+            found = takeNextLocked(kClassCount, &task, &dropped);
+            if (!found) {
+                --workers_; // Started again by the next task that may start
+            }
+        }
+        for (Task& droppedTask : dropped) {
+            droppedTask.run(true);
+        }
+        if (!found) {
+            return;
+        }
+        runTask(task);
+    }
+}
+
+void TaskScheduler::runTask(Task& task)
+{
+    const int taskClass = static_cast<int>(task.taskClass);
+    const int outerClass = currentTaskClass; // Set if this runs while another task yields
+    currentTaskClass = taskClass;
+    task.run(task.cancel.isCancelled());
+    currentTaskClass = outerClass;
+    {
+        QMutexLocker locker(&mutex_);
+        --running_[taskClass];
+    }
+    // A task of this class that had to wait for the limit may start now. The worker that ran
+    // this one may be busy with another class next, or (after a yield) with the yielding task.
+    startWorkers();
+}
+
+void TaskScheduler::startWorkers()
+{
+    int starting = 0;
+    {
+        QMutexLocker locker(&mutex_);
+        int startable = 0;
+        for (int taskClass = 0; taskClass < kClassCount; ++taskClass) {
+            const int free = limitLocked(taskClass) - running_[taskClass];
+            startable += qMax(0, qMin(static_cast<int>(queues_[taskClass].size()), free));
+        }
+        starting = qMax(0, qMin(startable, threadCount_ - workers_));
+        workers_ += starting;
+    }
+    for (int i = 0; i < starting; ++i) {
+        pool_.start(new Worker(this));
+    }
+}
+
+bool TaskScheduler::takeNextLocked(int endClass, Task* task, std::vector<Task>* dropped)
+{
+    // Cancelled tasks go first, whatever their class: their owners may be waiting for them
+    for (std::deque<Task>& queue : queues_) {
+        for (auto it = queue.begin(); it != queue.end();) {
+            if (it->cancel.isCancelled()) {
+                dropped->push_back(std::move(*it));
+                it = queue.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    for (int taskClass = 0; taskClass < endClass; ++taskClass) {
+        if (!queues_[taskClass].empty() && running_[taskClass] < limitLocked(taskClass)) {
+            *task = std::move(queues_[taskClass].front());
+            queues_[taskClass].pop_front();
+            ++running_[taskClass];
+            return true;
+        }
+    }
+    return false;
+}
+
+int TaskScheduler::limitLocked(int taskClass) const
+{
+    if (limits_[taskClass] > 0) {
+        return limits_[taskClass];
+    }
+    // Urgent classes may use every thread; the later ones leave some for them
+    switch (static_cast<TaskClass>(taskClass)) {
+    case TaskClass::Viewport:
+    case TaskClass::ActiveFilter:
+        return threadCount_;
+    case TaskClass::Indexing:
+        return qMax(1, threadCount_ * 3 / 4);
+    case TaskClass::BackgroundFilter:
+        return qMax(1, threadCount_ / 2);
+    case TaskClass::Prefetch:
+        return qMax(1, threadCount_ / 4);
+    }
+    return threadCount_;
+}
@@ -0,0 +1,143 @@
+#ifndef TASK_SCHEDULER_HPP
+#define TASK_SCHEDULER_HPP
+
+#include <deque>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+#include <QFuture>
+#include <QFutureInterface>
+#include <QMutex>
+#include <QThreadPool>
+#include <QtGlobal>
+
+#include "CancellationToken.hpp"
+
+// What background work is for, most urgent first
+enum class TaskClass
+{
+    Viewport,         // Pages of the lines on screen
+    ActiveFilter,     // Filtering for the tab being looked at
+    Indexing,         // Line starts of opened, growing and rewritten files
+    BackgroundFilter, // Filtering for tabs in the background
+    Prefetch          // Speculative: pages around the screen, index sidecars
+};
+
+// Process-wide scheduler for the background work of all open files, so that work for one
+// tab can't hold up what another one shows.
+//
+// Queued tasks start in class order on a fixed set of threads, and every class may only
+// occupy so many of them at once (setConcurrencyLimit()): speculative work never takes all
+// threads, so more urgent work finds one free most of the time. When it doesn't, long tasks
+// give way at their chunk boundaries: yieldToUrgentWork() runs the queued tasks of more
+// urgent classes on the calling thread before the chunk loop goes on.
+//
+// Results come back as a QFuture, to be watched or waited for like a QtConcurrent one.
+// Waiting for a task from a scheduler thread is not allowed: it could wait for itself.
+class TaskScheduler
+{
+public:
+    static constexpr int kClassCount = 5;
+
+    static TaskScheduler& instance();
+
+    int threadCount() const;
+    void setThreadCount(int threadCount); // 0 (the default) for one per core
+    int concurrencyLimit(TaskClass taskClass) const;
+    void setConcurrencyLimit(TaskClass taskClass, int limit); // 0 for the default share of the threads
+
+    // Queues function (returning a value or not) to run on a scheduler thread. A task whose
+    // token is cancelled before it starts is dropped instead: its future reports a
+    // default-constructed result, which is what the tasks return once they see the cancel.
+    template <typename Function>
+    auto run(TaskClass taskClass, const CancellationToken& cancel, Function function)
+        -> QFuture<decltype(function())>;
+    template <typename Function>
+    auto run(TaskClass taskClass, Function function) -> QFuture<decltype(function())>;
+
+    // Finishes the futures of queued tasks whose token is cancelled right away, rather than
+    // when a thread comes around to them. For owners about to wait for their tasks.
+    void discardCancelled();
+
+    // Called by long tasks between chunks of work: runs queued tasks of more urgent classes
+    // on this thread first, if no thread is free for them. Does nothing outside scheduler tasks.
+    static void yieldToUrgentWork();
+
+private:
+    struct Task
+    {
+        TaskClass taskClass = TaskClass::Prefetch;
+        CancellationToken cancel;
+        std::function<void(bool skip)> run; // Reports the result (a default one if skipped)
+    };
+    class Worker;
+
+    TaskScheduler();
+    ~TaskScheduler();
+
+    template <typename Result, typename Function>
+    static void report(QFutureInterface<Result>& promise, Function& function, bool skip, std::false_type);
+    template <typename Result, typename Function>
+    static void report(QFutureInterface<Result>& promise, Function& function, bool skip, std::true_type);
+
+    void enqueue(Task task);
+    void workerLoop();
+    void runTask(Task& task);
+    void startWorkers(); // As many as there are queued tasks that may start
+    // Takes the first queued task that may start, of a class before endClass; the mutex is held
+    bool takeNextLocked(int endClass, Task* task, std::vector<Task>* dropped);
+    int limitLocked(int taskClass) const;
+
+    mutable QMutex mutex_;
+    std::deque<Task> queues_[kClassCount];
+    int running_[kClassCount] = {}; // Tasks of the class started and not finished, yielding ones too
+    int limits_[kClassCount] = {};  // 0: default
+    int threadCount_ = 0;
+    int workers_ = 0;               // Worker loops started on pool_
+    QThreadPool pool_;
+};
+
+template <typename Result, typename Function>
+void TaskScheduler::report(QFutureInterface<Result>& promise, Function& function, bool skip, std::false_type)
+{
+    const Result result = skip ? Result() : function();
+    promise.reportResult(result);
+    promise.reportFinished();
+}
+
+template <typename Result, typename Function>
+void TaskScheduler::report(QFutureInterface<Result>& promise, Function& function, bool skip, std::true_type)
+{
+    if (!skip) {
+        function();
+    }
+    promise.reportFinished();
+}
+
+template <typename Function>
+auto TaskScheduler::run(TaskClass taskClass, const CancellationToken& cancel, Function function)
+    -> QFuture<decltype(function())>
+{
+    using Result = decltype(function());
+    QFutureInterface<Result> promise;
+    promise.reportStarted();
+    const QFuture<Result> future = promise.future();
+
+    Task task;
+    task.taskClass = taskClass;
+    task.cancel = cancel;
+    task.run = [promise, function](bool skip) mutable {
+        report(promise, function, skip, std::is_void<Result>());
+    };
+    enqueue(std::move(task));
+    return future;
+}
+
+template <typename Function>
+auto TaskScheduler::run(TaskClass taskClass, Function function) -> QFuture<decltype(function())>
+{
+    return run(taskClass, CancellationToken(), std::move(function));
+}
+
+#endif // TASK_SCHEDULER_HPP
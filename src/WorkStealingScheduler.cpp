@@ -0,0 +1,86 @@
+#include "WorkStealingScheduler.hpp"
+
+#include <QMutexLocker>
+
+WorkStealingScheduler::WorkStealingScheduler(int chunkCount, int workerCount)
+    : shares_(new Share[qMax(1, workerCount)]),
+      workerCount_(qMax(1, workerCount))
+{
+    for (int worker = 0; worker < workerCount_; ++worker) {
+        shares_[worker].begin = static_cast<int>(qint64(chunkCount) * worker / workerCount_);
+        shares_[worker].end = static_cast<int>(qint64(chunkCount) * (worker + 1) / workerCount_);
+    }
+}
+
+int WorkStealingScheduler::workerCount() const
+{
+    return workerCount_;
+}
+
+int WorkStealingScheduler::next(int worker)
+{
+    Share& own = shares_[worker];
+    for (;;) {
+        {
+            QMutexLocker locker(&own.mutex);
+            if (own.begin < own.end) {
+                ++own.stats.chunks;
+                return own.begin++;
+            }
+        }
+        if (!steal(worker)) {
+            return -1;
+        }
+    }
+}
+
+WorkStealingScheduler::WorkerStats& WorkStealingScheduler::stats(int worker)
+{
+    return shares_[worker].stats;
+}
+
+bool WorkStealingScheduler::steal(int worker)
+{
+    // Only one mutex is held at a time, so workers stealing from each other can't deadlock.
+    // The largest share may shrink between finding it and taking from it: then look again,
+    // there's less work left every time around.
+    for (;;) {
+        int victim = -1;
+        int largest = 0;
+        for (int other = 0; other < workerCount_; ++other) {
+            if (other == worker) {
+                continue;
+            }
+            QMutexLocker locker(&shares_[other].mutex);
+            if (shares_[other].end - shares_[other].begin > largest) {
+                largest = shares_[other].end - shares_[other].begin;
+                victim = other;
+            }
+        }
+        if (victim < 0) {
+            return false;
+        }
+
+        int first;
+        int end;
+        {
+            QMutexLocker locker(&shares_[victim].mutex);
+            const int left = shares_[victim].end - shares_[victim].begin;
+            if (left <= 0) {
+                continue;
+            }
+            end = shares_[victim].end;
+            first = end - (left + 1) / 2; // The back half: the victim keeps working in order
+            shares_[victim].end = first;
+        }
+        {
+            // Empty until now, so nobody took from it meanwhile
+            QMutexLocker locker(&shares_[worker].mutex);
+            shares_[worker].begin = first;
+            shares_[worker].end = end;
+            ++shares_[worker].stats.steals;
+            shares_[worker].stats.stolenChunks += end - first;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef WORK_STEALING_SCHEDULER_HPP
+#define WORK_STEALING_SCHEDULER_HPP
+
+#include <memory>
+
+#include <QMutex>
+#include <QtGlobal>
+
+// Hands out numbered chunks of work (0 .. chunkCount - 1) to a fixed set of workers.
+//
+// Every worker starts with a contiguous share of the chunks and takes them from its front,
+// in order. A worker whose share is used up steals the back half of the largest share left,
+// so chunks that turn out expensive (long lines, costly patterns) keep all workers busy
+// until the very end instead of one worker finishing its static range alone. Halving keeps
+// the number of steals small, and taking from the front keeps each worker's chunks in file
+// order, which lets the leading chunks complete first.
+//
+// A share's bounds are guarded by their own mutex, held only to move them; chunks are far
+// too large for the locking to show.
+class WorkStealingScheduler
+{
+public:
+    // What a worker did; written by that worker only, read once all workers are done
+    struct WorkerStats
+    {
+        int chunks = 0;       // Chunks handed to the worker
+        int steals = 0;       // Times it took over part of another worker's share
+        int stolenChunks = 0; // Chunks it took over that way
+        qint64 rows = 0;      // Rows and bytes of the chunks it finished (filled in by the worker)
+        qint64 bytes = 0;
+        qint64 busyMs = 0;    // Time from its first chunk to running out of chunks (idem)
+    };
+
+    WorkStealingScheduler(int chunkCount, int workerCount);
+
+    int workerCount() const;
+    int next(int worker); // Next chunk for worker, -1 once every chunk is handed out
+    WorkerStats& stats(int worker);
+
+private:
+    struct alignas(64) Share // A cache line each, workers update theirs all the time
+    {
+        QMutex mutex;
+        int begin = 0; // Chunks [begin, end) are left to hand out
+        int end = 0;
+        WorkerStats stats;
+    };
+
+    bool steal(int worker); // Moves half of the largest other share to worker's; false if all are empty
+
+    std::unique_ptr<Share[]> shares_;
+    int workerCount_;
+};
+
+#endif // WORK_STEALING_SCHEDULER_HPP
@@ -50,8 +50,8 @@ void LogfileLoader::load(QTabWidget *target_tab_widget, ::Logfile* logfile_data,
     int tab_index = target_tab_widget->addTab(viewer, short_filename);
     target_tab_widget->setTabToolTip(tab_index, logfile_data->getFileName()); // Tooltip can show full path
 
-    // Initially disable the viewer until loading is complete
-    viewer->setEnabled(false);
+    // The viewer stays usable while indexing: rows are inserted as they are indexed.
+    // Filters and bookmarks become available once indexing has finished.
 
     // --- Connect to Logfile signals ---
     // Use QPointer for safety in lambdas, although viewer should outlive logfile_data here
@@ -65,26 +65,14 @@ void LogfileLoader::load(QTabWidget *target_tab_widget, ::Logfile* logfile_data,
         if (!viewer_ptr || !tab_widget_ptr || !logfile_ptr) return; // Check pointers
 
         if (success) {
-            qInfo() << "Indexing finished for" << logfile_ptr->getFileName() << ", resetting model.";
-            // Reset the model now that data is available
-            // Access the model via FileViewer -> LogViewer -> LogfileModel
-            if (viewer_ptr->getLogViewer()) { // Check if LogViewer exists
-                if (auto* model = viewer_ptr->getLogViewer()->getBaseSourceModel()) {
-                    // Call the public reset method
-                    model->resetModel();
-                } else {
-                    qWarning("Could not get baseSourceModel from LogViewer to reset.");
-                }
-            } else {
-                 qWarning("Could not get LogfileModel from FileViewer to reset.");
-            }
+            qInfo() << "Indexing finished for" << logfile_ptr->getFileName();
+            // No model reset: LogfileModel has been inserting rows as they were indexed, and
+            // a reset would throw away the user's scroll position and selection
 
             // Update tab title and tooltip now that filename is definitely set
             QString final_filename = logfile_ptr->getFileName();
             tab_widget_ptr->setTabText(tab_index, QFileInfo(final_filename).fileName());
             tab_widget_ptr->setTabToolTip(tab_index, final_filename);
-            // Optionally re-enable UI elements in the viewer if they were disabled during loading
-            viewer_ptr->setEnabled(true); // Example: Re-enable the whole viewer widget
 
         } else {
             qWarning() << "Indexing failed for" << logfile_ptr->getFileName();
@@ -14,6 +14,7 @@ void GrepNode::serialize(const ::GrepNode &gp, QJsonObject &json)
     json["is_regex"] = gp.is_regex_;
     json["is_case_insensitive"] = gp.is_case_insensitive_;
     json["is_inverted"] = gp.is_inverted_;
+    json["is_query"] = gp.is_query_;
 
     QJsonArray array;
     for (const auto& child : gp.children_)
@@ -31,6 +32,7 @@ void GrepNode::deserialize(::GrepNode &gp, const QJsonObject &json)
     gp.is_regex_ = json["is_regex"].toBool();
     gp.is_case_insensitive_= json["is_case_insensitive"].toBool();
     gp.is_inverted_= json["is_inverted"].toBool();
+    gp.is_query_ = json["is_query"].toBool(); // Missing in projects saved before queries: false
 
     QJsonArray children = json["children"].toArray(); // Fixed typo
     for (const QJsonValue child : children)
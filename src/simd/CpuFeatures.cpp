@@ -0,0 +1,57 @@
+#include "CpuFeatures.hpp"
+
+#if defined(Q_PROCESSOR_X86) && defined(_MSC_VER)
+#include <immintrin.h>
+#endif
+
+namespace simd
+{
+
+namespace
+{
+
+CpuFeatures detect()
+{
+    CpuFeatures features;
+#if defined(Q_PROCESSOR_X86) && (defined(__GNUC__) || defined(__clang__))
+    // libgcc/compiler-rt also check XGETBV, so these already account for OS support
+    __builtin_cpu_init();
+    features.sse2 = __builtin_cpu_supports("sse2");
+    features.avx2 = __builtin_cpu_supports("avx2");
+    features.avx512bw = __builtin_cpu_supports("avx512bw");
+#elif defined(Q_PROCESSOR_X86) && defined(_MSC_VER)
+    int regs[4] = {};
+    __cpuid(regs, 0);
+    const int maxLeaf = regs[0];
+
+    __cpuid(regs, 1);
+    features.sse2 = (regs[3] & (1 << 26)) != 0;
+    const bool osxsave = (regs[2] & (1 << 27)) != 0;
+    const bool avx = (regs[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || maxLeaf < 7) {
+        return features;
+    }
+
+    // The OS has to save YMM (bits 1-2) and, for AVX-512, opmask/ZMM state (bits 5-7)
+    const unsigned long long xcr0 = _xgetbv(0);
+    const bool ymmEnabled = (xcr0 & 0x6) == 0x6;
+    const bool zmmEnabled = (xcr0 & 0xe6) == 0xe6;
+
+    __cpuidex(regs, 7, 0);
+    features.avx2 = ymmEnabled && (regs[1] & (1 << 5)) != 0;
+    const bool avx512f = (regs[1] & (1 << 16)) != 0;
+    const bool avx512bw = (regs[1] & (1 << 30)) != 0;
+    features.avx512bw = zmmEnabled && avx512f && avx512bw;
+#endif
+    return features;
+}
+
+}  // namespace
+
+const CpuFeatures& CpuFeatures::get()
+{
+    static const CpuFeatures features = detect();
+    return features;
+}
+
+}  // namespace simd
@@ -0,0 +1,53 @@
+#ifndef SIMD_CPU_FEATURES_HPP
+#define SIMD_CPU_FEATURES_HPP
+
+#include <QtGlobal>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Compiler glue for functions that use instruction sets above the build baseline.
+// GCC and Clang need a per-function target attribute; MSVC accepts the intrinsics as-is.
+#if defined(Q_PROCESSOR_X86) && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SIMD_TARGET(isa)
+#endif
+
+namespace simd
+{
+
+// Instruction set extensions usable by the current process (CPU *and* OS support).
+// Detected once on first use; all members are false on non-x86 builds.
+struct CpuFeatures
+{
+    bool sse2 = false;
+    bool avx2 = false;
+    bool avx512bw = false;
+
+    static const CpuFeatures& get();
+};
+
+// Index of the lowest set bit; mask must be non-zero.
+inline int countTrailingZeros(quint64 mask)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(mask);
+#elif defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return static_cast<int>(index);
+#else
+    unsigned long index;
+    if (_BitScanForward(&index, static_cast<unsigned long>(mask))) {
+        return static_cast<int>(index);
+    }
+    _BitScanForward(&index, static_cast<unsigned long>(mask >> 32));
+    return static_cast<int>(index) + 32;
+#endif
+}
+
+}  // namespace simd
+
+#endif // SIMD_CPU_FEATURES_HPP
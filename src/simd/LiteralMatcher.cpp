@@ -0,0 +1,231 @@
+#include "LiteralMatcher.hpp"
+#include "CpuFeatures.hpp"
+
+#include <cstring>
+
+#if defined(Q_PROCESSOR_X86)
+#include <immintrin.h>
+#endif
+
+namespace simd
+{
+
+namespace
+{
+
+inline char foldAscii(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+inline bool isAsciiLetter(char c)
+{
+    const char lower = static_cast<char>(c | 0x20);
+    return lower >= 'a' && lower <= 'z';
+}
+
+// needle is already folded if caseInsensitive
+inline bool equalAt(const char* data, const char* needle, qint64 length, bool caseInsensitive)
+{
+    if (!caseInsensitive) {
+        return std::memcmp(data, needle, static_cast<size_t>(length)) == 0;
+    }
+    for (qint64 i = 0; i < length; ++i) {
+        if (foldAscii(data[i]) != needle[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Searches for occurrences starting at from or later
+qint64 searchScalar(const char* data, qint64 length, const QByteArray& needle, bool caseInsensitive, qint64 from)
+{
+    const qint64 needleLength = needle.size();
+    const char first = needle.at(0);
+    if (!caseInsensitive || !isAsciiLetter(first)) {
+        // memchr is vectorised by the C library, let it find the first byte
+        for (qint64 pos = from; pos + needleLength <= length; ++pos) {
+            const void* hit = std::memchr(data + pos, first, static_cast<size_t>(length - needleLength + 1 - pos));
+            if (!hit) {
+                return -1;
+            }
+            pos = static_cast<const char*>(hit) - data;
+            if (equalAt(data + pos + 1, needle.constData() + 1, needleLength - 1, caseInsensitive)) {
+                return pos;
+            }
+        }
+        return -1;
+    }
+    for (qint64 pos = from; pos + needleLength <= length; ++pos) {
+        if (equalAt(data + pos, needle.constData(), needleLength, true)) {
+            return pos;
+        }
+    }
+    return -1;
+}
+
+#if defined(Q_PROCESSOR_X86)
+
+// For a letter, both sides are compared with bit 5 set, which maps 'A'..'Z' onto 'a'..'z'
+// and leaves every other byte distinct from a lowercase letter.
+inline char foldMask(char c, bool caseInsensitive)
+{
+    return (caseInsensitive && isAsciiLetter(c)) ? 0x20 : 0;
+}
+
+SIMD_TARGET("sse2")
+qint64 searchSse2(const char* data, qint64 length, const QByteArray& needle, bool caseInsensitive)
+{
+    const qint64 last = needle.size() - 1;
+    const char* middle = needle.constData() + 1;
+    const __m128i firstByte = _mm_set1_epi8(needle.at(0));
+    const __m128i lastByte = _mm_set1_epi8(needle.at(last));
+    const __m128i firstFold = _mm_set1_epi8(foldMask(needle.at(0), caseInsensitive));
+    const __m128i lastFold = _mm_set1_epi8(foldMask(needle.at(last), caseInsensitive));
+
+    qint64 pos = 0;
+    for (; pos + last + 16 <= length; pos += 16) {
+        const __m128i atFirst = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos)), firstFold);
+        const __m128i atLast = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos + last)), lastFold);
+        quint64 mask = static_cast<quint32>(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(atFirst, firstByte), _mm_cmpeq_epi8(atLast, lastByte))));
+        while (mask) {
+            const qint64 candidate = pos + countTrailingZeros(mask);
+            if (last < 2 || equalAt(data + candidate + 1, middle, last - 1, caseInsensitive)) {
+                return candidate;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return searchScalar(data, length, needle, caseInsensitive, pos);
+}
+
+SIMD_TARGET("avx2")
+qint64 searchAvx2(const char* data, qint64 length, const QByteArray& needle, bool caseInsensitive)
+{
+    const qint64 last = needle.size() - 1;
+    const char* middle = needle.constData() + 1;
+    const __m256i firstByte = _mm256_set1_epi8(needle.at(0));
+    const __m256i lastByte = _mm256_set1_epi8(needle.at(last));
+    const __m256i firstFold = _mm256_set1_epi8(foldMask(needle.at(0), caseInsensitive));
+    const __m256i lastFold = _mm256_set1_epi8(foldMask(needle.at(last), caseInsensitive));
+
+    qint64 pos = 0;
+    for (; pos + last + 32 <= length; pos += 32) {
+        const __m256i atFirst = _mm256_or_si256(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos)), firstFold);
+        const __m256i atLast = _mm256_or_si256(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos + last)), lastFold);
+        quint64 mask = static_cast<quint32>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(atFirst, firstByte), _mm256_cmpeq_epi8(atLast, lastByte))));
+        while (mask) {
+            const qint64 candidate = pos + countTrailingZeros(mask);
+            if (last < 2 || equalAt(data + candidate + 1, middle, last - 1, caseInsensitive)) {
+                return candidate;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return searchScalar(data, length, needle, caseInsensitive, pos);
+}
+
+#endif // Q_PROCESSOR_X86
+
+bool isSupported(LiteralMatcher::Kernel kernel)
+{
+    const CpuFeatures& cpu = CpuFeatures::get();
+    switch (kernel) {
+    case LiteralMatcher::Kernel::Avx2:
+        return cpu.avx2;
+    case LiteralMatcher::Kernel::Sse2:
+        return cpu.sse2;
+    case LiteralMatcher::Kernel::Scalar:
+        return true;
+    }
+    return false;
+}
+
+}  // namespace
+
+LiteralMatcher::LiteralMatcher(const QByteArray& needle, bool caseInsensitive)
+    : needle_(needle),
+      caseInsensitive_(caseInsensitive)
+{
+    if (caseInsensitive_) {
+        for (char& c : needle_) {
+            c = foldAscii(c);
+        }
+    }
+}
+
+const QByteArray& LiteralMatcher::needle() const
+{
+    return needle_;
+}
+
+bool LiteralMatcher::isCaseInsensitive() const
+{
+    return caseInsensitive_;
+}
+
+qint64 LiteralMatcher::indexIn(const char* data, qint64 length) const
+{
+    return indexInWith(activeKernel(), data, length);
+}
+
+qint64 LiteralMatcher::indexInWith(Kernel kernel, const char* data, qint64 length) const
+{
+    if (needle_.isEmpty()) {
+        return 0;
+    }
+    if (needle_.size() > length) {
+        return -1;
+    }
+    if (!isSupported(kernel)) {
+        kernel = Kernel::Scalar;
+    }
+    switch (kernel) {
+#if defined(Q_PROCESSOR_X86)
+    case Kernel::Avx2:
+        return searchAvx2(data, length, needle_, caseInsensitive_);
+    case Kernel::Sse2:
+        return searchSse2(data, length, needle_, caseInsensitive_);
+#endif
+    default:
+        return searchScalar(data, length, needle_, caseInsensitive_, 0);
+    }
+}
+
+bool LiteralMatcher::isAscii(const QByteArray& bytes)
+{
+    for (const char c : bytes) {
+        if (static_cast<uchar>(c) >= 0x80) {
+            return false;
+        }
+    }
+    return true;
+}
+
+LiteralMatcher::Kernel LiteralMatcher::activeKernel()
+{
+    static const Kernel kernel = CpuFeatures::get().avx2 ? Kernel::Avx2
+                               : CpuFeatures::get().sse2 ? Kernel::Sse2
+                                                         : Kernel::Scalar;
+    return kernel;
+}
+
+const char* LiteralMatcher::kernelName(Kernel kernel)
+{
+    switch (kernel) {
+    case Kernel::Avx2:
+        return "AVX2";
+    case Kernel::Sse2:
+        return "SSE2";
+    case Kernel::Scalar:
+        return "scalar";
+    }
+    return "unknown";
+}
+
+}  // namespace simd
@@ -0,0 +1,43 @@
+#ifndef SIMD_LITERAL_MATCHER_HPP
+#define SIMD_LITERAL_MATCHER_HPP
+
+#include <QByteArray>
+
+namespace simd
+{
+
+// Substring search on raw (UTF-8) bytes, without decoding to QString.
+//
+// Candidate positions are found by comparing the needle's first and last byte against 16
+// (SSE2) or 32 (AVX2) haystack positions at once; only positions where both agree get
+// the bytes in between compared. Case-insensitive search folds ASCII letters only, so it
+// is meant for ASCII needles; non-ASCII needles need Unicode case folding (QString).
+class LiteralMatcher
+{
+public:
+    enum class Kernel { Scalar, Sse2, Avx2 };
+
+    LiteralMatcher() = default;
+    LiteralMatcher(const QByteArray& needle, bool caseInsensitive);
+
+    const QByteArray& needle() const; // Lowercased if case-insensitive
+    bool isCaseInsensitive() const;
+
+    // Offset of the first occurrence in data, or -1. An empty needle is found at 0.
+    qint64 indexIn(const char* data, qint64 length) const;
+    // Same, forcing a kernel; kernels the CPU can't run fall back to Scalar
+    qint64 indexInWith(Kernel kernel, const char* data, qint64 length) const;
+
+    static bool isAscii(const QByteArray& bytes);
+
+    static Kernel activeKernel();
+    static const char* kernelName(Kernel kernel);
+
+private:
+    QByteArray needle_;
+    bool caseInsensitive_ = false;
+};
+
+}  // namespace simd
+
+#endif // SIMD_LITERAL_MATCHER_HPP
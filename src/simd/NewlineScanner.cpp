@@ -0,0 +1,263 @@
+#include "NewlineScanner.hpp"
+#include "CpuFeatures.hpp"
+
+#include <cstring>
+#include <initializer_list>
+
+#if defined(Q_PROCESSOR_X86)
+#include <immintrin.h>
+#endif
+
+namespace simd
+{
+
+namespace
+{
+
+// Emits one offset per set bit of mask; bit n stands for data[pos + n].
+inline qint64 emitMask(quint64 mask, qint64 pos, qint64 baseOffset, qint64* out, qint64 count)
+{
+    while (mask) {
+        out[count++] = baseOffset + pos + countTrailingZeros(mask) + 1;
+        mask &= mask - 1;
+    }
+    return count;
+}
+
+qint64 scanScalar(const char* data, qint64 length, qint64 baseOffset,
+                  qint64* out, qint64 capacity, qint64* written)
+{
+    qint64 count = 0;
+    qint64 pos = 0;
+    while (pos < length && count < capacity) {
+        const void* hit = std::memchr(data + pos, '\n', static_cast<size_t>(length - pos));
+        if (!hit) {
+            pos = length;
+            break;
+        }
+        pos = static_cast<const char*>(hit) - data;
+        out[count++] = baseOffset + pos + 1;
+        ++pos;
+    }
+    *written = count;
+    return pos;
+}
+
+qint64 countScalar(const char* data, qint64 length)
+{
+    qint64 count = 0;
+    const char* end = data + length;
+    while (data < end) {
+        const void* hit = std::memchr(data, '\n', static_cast<size_t>(end - data));
+        if (!hit) break;
+        ++count;
+        data = static_cast<const char*>(hit) + 1;
+    }
+    return count;
+}
+
+#if defined(Q_PROCESSOR_X86)
+
+// The vector kernels only enter a block while at least a block's worth of output space is
+// left, so a block never has to be split; the tail is finished by the scalar loop.
+
+SIMD_TARGET("sse2")
+qint64 scanSse2(const char* data, qint64 length, qint64 baseOffset,
+                qint64* out, qint64 capacity, qint64* written)
+{
+    const __m128i newline = _mm_set1_epi8('\n');
+    qint64 count = 0;
+    qint64 pos = 0;
+    for (; pos + 16 <= length && count + 16 <= capacity; pos += 16) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        const quint64 mask = static_cast<quint32>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline)));
+        count = emitMask(mask, pos, baseOffset, out, count);
+    }
+    qint64 tail = 0;
+    pos += scanScalar(data + pos, length - pos, baseOffset + pos, out + count, capacity - count, &tail);
+    *written = count + tail;
+    return pos;
+}
+
+SIMD_TARGET("avx2")
+qint64 scanAvx2(const char* data, qint64 length, qint64 baseOffset,
+                qint64* out, qint64 capacity, qint64* written)
+{
+    const __m256i newline = _mm256_set1_epi8('\n');
+    qint64 count = 0;
+    qint64 pos = 0;
+    // Two vectors per iteration; lines are usually much longer than 64 bytes, so most
+    // iterations end after a single OR test.
+    for (; pos + 64 <= length && count + 64 <= capacity; pos += 64) {
+        const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+        const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos + 32));
+        const __m256i eqLo = _mm256_cmpeq_epi8(lo, newline);
+        const __m256i eqHi = _mm256_cmpeq_epi8(hi, newline);
+        if (_mm256_testz_si256(_mm256_or_si256(eqLo, eqHi), _mm256_or_si256(eqLo, eqHi))) {
+            continue;
+        }
+        const quint64 mask = static_cast<quint32>(_mm256_movemask_epi8(eqLo))
+                           | (static_cast<quint64>(static_cast<quint32>(_mm256_movemask_epi8(eqHi))) << 32);
+        count = emitMask(mask, pos, baseOffset, out, count);
+    }
+    qint64 tail = 0;
+    pos += scanScalar(data + pos, length - pos, baseOffset + pos, out + count, capacity - count, &tail);
+    *written = count + tail;
+    return pos;
+}
+
+SIMD_TARGET("avx512f,avx512bw")
+qint64 scanAvx512(const char* data, qint64 length, qint64 baseOffset,
+                  qint64* out, qint64 capacity, qint64* written)
+{
+    const __m512i newline = _mm512_set1_epi8('\n');
+    qint64 count = 0;
+    qint64 pos = 0;
+    for (; pos + 64 <= length && count + 64 <= capacity; pos += 64) {
+        const __m512i block = _mm512_loadu_si512(reinterpret_cast<const void*>(data + pos));
+        const quint64 mask = _mm512_cmpeq_epi8_mask(block, newline);
+        count = emitMask(mask, pos, baseOffset, out, count);
+    }
+    qint64 tail = 0;
+    pos += scanScalar(data + pos, length - pos, baseOffset + pos, out + count, capacity - count, &tail);
+    *written = count + tail;
+    return pos;
+}
+
+// Counting keeps per-byte counters: a compare yields -1 for every '\n', which is subtracted.
+// They're summed into 64-bit lanes with SAD before they can overflow (255 rounds).
+
+SIMD_TARGET("sse2")
+qint64 countSse2(const char* data, qint64 length)
+{
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i zero = _mm_setzero_si128();
+    __m128i total = zero;
+    qint64 pos = 0;
+    while (pos + 16 <= length) {
+        __m128i counters = zero;
+        for (int round = 0; round < 255 && pos + 16 <= length; ++round, pos += 16) {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+            counters = _mm_sub_epi8(counters, _mm_cmpeq_epi8(block, newline));
+        }
+        total = _mm_add_epi64(total, _mm_sad_epu8(counters, zero));
+    }
+    qint64 lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), total);
+    return lanes[0] + lanes[1] + countScalar(data + pos, length - pos);
+}
+
+SIMD_TARGET("avx2")
+qint64 countAvx2(const char* data, qint64 length)
+{
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i total = zero;
+    qint64 pos = 0;
+    while (pos + 32 <= length) {
+        __m256i counters = zero;
+        for (int round = 0; round < 255 && pos + 32 <= length; ++round, pos += 32) {
+            const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+            counters = _mm256_sub_epi8(counters, _mm256_cmpeq_epi8(block, newline));
+        }
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(counters, zero));
+    }
+    qint64 lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), total);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + countScalar(data + pos, length - pos);
+}
+
+#endif // Q_PROCESSOR_X86
+
+bool isSupported(NewlineScanner::Kernel kernel)
+{
+    const CpuFeatures& cpu = CpuFeatures::get();
+    switch (kernel) {
+    case NewlineScanner::Kernel::Avx512:
+        return cpu.avx512bw;
+    case NewlineScanner::Kernel::Avx2:
+        return cpu.avx2;
+    case NewlineScanner::Kernel::Sse2:
+        return cpu.sse2;
+    case NewlineScanner::Kernel::Scalar:
+        return true;
+    }
+    return false;
+}
+
+NewlineScanner::Kernel detectKernel()
+{
+    for (auto kernel : {NewlineScanner::Kernel::Avx512, NewlineScanner::Kernel::Avx2,
+                        NewlineScanner::Kernel::Sse2}) {
+        if (isSupported(kernel)) {
+            return kernel;
+        }
+    }
+    return NewlineScanner::Kernel::Scalar;
+}
+
+}  // namespace
+
+qint64 NewlineScanner::scan(const char* data, qint64 length, qint64 baseOffset,
+                            qint64* out, qint64 capacity, qint64* written)
+{
+    return scanWith(activeKernel(), data, length, baseOffset, out, capacity, written);
+}
+
+qint64 NewlineScanner::scanWith(Kernel kernel, const char* data, qint64 length, qint64 baseOffset,
+                                qint64* out, qint64 capacity, qint64* written)
+{
+    if (!isSupported(kernel)) {
+        kernel = Kernel::Scalar;
+    }
+    switch (kernel) {
+#if defined(Q_PROCESSOR_X86)
+    case Kernel::Avx512:
+        return scanAvx512(data, length, baseOffset, out, capacity, written);
+    case Kernel::Avx2:
+        return scanAvx2(data, length, baseOffset, out, capacity, written);
+    case Kernel::Sse2:
+        return scanSse2(data, length, baseOffset, out, capacity, written);
+#endif
+    default:
+        return scanScalar(data, length, baseOffset, out, capacity, written);
+    }
+}
+
+qint64 NewlineScanner::count(const char* data, qint64 length)
+{
+    switch (activeKernel()) {
+#if defined(Q_PROCESSOR_X86)
+    case Kernel::Avx512: // Bandwidth bound already, AVX2 does
+    case Kernel::Avx2:
+        return countAvx2(data, length);
+    case Kernel::Sse2:
+        return countSse2(data, length);
+#endif
+    default:
+        return countScalar(data, length);
+    }
+}
+
+NewlineScanner::Kernel NewlineScanner::activeKernel()
+{
+    static const Kernel kernel = detectKernel();
+    return kernel;
+}
+
+const char* NewlineScanner::kernelName(Kernel kernel)
+{
+    switch (kernel) {
+    case Kernel::Avx512:
+        return "AVX-512";
+    case Kernel::Avx2:
+        return "AVX2";
+    case Kernel::Sse2:
+        return "SSE2";
+    case Kernel::Scalar:
+        return "scalar";
+    }
+    return "unknown";
+}
+
+}  // namespace simd
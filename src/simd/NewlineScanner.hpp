@@ -0,0 +1,37 @@
+#ifndef SIMD_NEWLINE_SCANNER_HPP
+#define SIMD_NEWLINE_SCANNER_HPP
+
+#include <QtGlobal>
+
+namespace simd
+{
+
+// Finds '\n' bytes in a buffer and reports the offsets of the lines that follow them.
+// The kernel is chosen once at runtime from the CPU features (AVX-512BW, AVX2, SSE2),
+// falling back to a memchr loop on other architectures.
+class NewlineScanner
+{
+public:
+    enum class Kernel { Scalar, Sse2, Avx2, Avx512 };
+
+    // For every '\n' at data[i], writes baseOffset + i + 1 into out.
+    // Stops once capacity offsets were written; *written receives the number stored.
+    // Returns how many bytes of data were consumed, so a caller with a small output
+    // batch can flush it and continue from there.
+    static qint64 scan(const char* data, qint64 length, qint64 baseOffset,
+                       qint64* out, qint64 capacity, qint64* written);
+
+    // Same as scan(), but forcing a given kernel. Kernels the CPU can't run fall back to Scalar.
+    static qint64 scanWith(Kernel kernel, const char* data, qint64 length, qint64 baseOffset,
+                           qint64* out, qint64 capacity, qint64* written);
+
+    // Number of '\n' bytes in data
+    static qint64 count(const char* data, qint64 length);
+
+    static Kernel activeKernel();
+    static const char* kernelName(Kernel kernel);
+};
+
+}  // namespace simd
+
+#endif // SIMD_NEWLINE_SCANNER_HPP
@@ -0,0 +1,104 @@
+// Regex filtering on raw bytes against QRegularExpression on the decoded line, the way
+// filters matched before the DFA. Lines mix valid UTF-8 with what mixed-encoding logs
+// contain: Latin-1 bytes, stray continuation bytes, truncated and overlong sequences,
+// surrogates and bytes that never appear in UTF-8. QString::fromUtf8() decodes each such
+// byte as U+FFFD, which '.' and negated classes match.
+//
+//     ByteRegexCheck
+//
+// Prints the mismatches and fails if there are any.
+
+#include <cstdio>
+
+#include <QByteArray>
+#include <QList>
+#include <QRegularExpression>
+#include <QString>
+
+#include "ByteRegex.hpp"
+#include "FilterParams.hpp"
+#include "FilterPlan.hpp"
+
+namespace
+{
+
+const char* const kPatterns[] = {
+    "ERROR.*timeout", "a.b", "^.$", "^..$", "^...$", "[^x]+$", "^[^a]", "a[^b]c", "\\w.\\d", ".{3}",
+    "\\S\\s\\W", "x.*y", "^.{2}e", "\\D\\D", "a\\W+b", "^[^0-9]*$", "b.?.?c", "(?:a|.)z", "\\Sz$", "e[^a-z]+e",
+};
+
+const char* const kPieces[] = {
+    "a", "b", "c", "e", "x", "y", "z", "1", " ", "ERROR", "timeout",
+    "\xC3\xA9",         // é
+    "\xE9",             // é in Latin-1
+    "\x80", "\xBF",     // Stray continuation bytes
+    "\xC0\xAF", "\xC1", "\xF5", "\xFF", // Never in UTF-8
+    "\xE2\x82",         // Truncated €
+    "\xE2\x82\xAC",     // €
+    "\xE0\x80\x80",     // Overlong
+    "\xED\xA0\x80",     // Surrogate
+    "\xF0\x9F\x98\x80", // Outside the BMP
+    "\xF4\x90\x80\x80", // Past U+10FFFF
+};
+
+// Every sequence of up to three pieces
+QList<QByteArray> makeLines()
+{
+    QList<QByteArray> lines{QByteArray()};
+    for (int length = 1, begin = 0; length <= 3; ++length) {
+        const int end = lines.size();
+        for (int i = begin; i < end; ++i) {
+            for (const char* piece : kPieces) {
+                lines.append(lines.at(i) + piece);
+            }
+        }
+        begin = end;
+    }
+    return lines;
+}
+
+}  // namespace
+
+int main()
+{
+    const QList<QByteArray> lines = makeLines();
+    int checks = 0;
+    int invalidLines = 0;
+    int mismatches = 0;
+    for (const QByteArray& line : lines) {
+        invalidLines += ByteRegex::isValidUtf8(line.constData(), line.size()) ? 0 : 1;
+    }
+
+    for (const char* pattern : kPatterns) {
+        for (const Qt::CaseSensitivity cs : {Qt::CaseSensitive, Qt::CaseInsensitive}) {
+            FilterParams params;
+            params.pattern = QString::fromUtf8(pattern);
+            params.isRegex = true;
+            params.cs = cs;
+            params.regex = QRegularExpression(params.pattern, cs == Qt::CaseInsensitive
+                                                                  ? QRegularExpression::CaseInsensitiveOption
+                                                                  : QRegularExpression::NoPatternOption);
+            if (!ByteRegex(params.pattern, cs == Qt::CaseInsensitive).isValid()) {
+                std::printf("'%s' doesn't compile to a DFA, nothing to compare\n", pattern);
+                ++mismatches;
+                continue;
+            }
+            const FilterPlan plan({params});
+            for (const QByteArray& line : lines) {
+                const bool expected = params.regex.match(QString::fromUtf8(line).trimmed()).hasMatch();
+                ++checks;
+                if (plan.matches(line.constData(), line.size()) != expected) {
+                    if (++mismatches <= 20) {
+                        std::printf("'%s'%s on '%s' (%s): expected %s\n", pattern,
+                                    cs == Qt::CaseInsensitive ? " (case-insensitive)" : "",
+                                    line.constData(), line.toHex().constData(), expected ? "match" : "no match");
+                    }
+                }
+            }
+        }
+    }
+
+    std::printf("%d checks on %d lines (%d not valid UTF-8), %d mismatches\n", checks, lines.size(), invalidLines,
+                mismatches);
+    return mismatches == 0 ? 0 : 1;
+}